@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _CHARSCAN_H_
+#define _CHARSCAN_H_
+
+#include "commondefs.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAVE_SSE2_SCAN
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/**
+ * Character scanning primitives for the line readers and tokenizers.
+ * They process 16 bytes at a time with SSE2 (32 with AVX2 if the compiler
+ * targets it), and fall back to plain loops on other platforms.
+ */
+//@{
+
+/**
+ * Returns the index of the lowest set bit. The mask must be nonzero.
+ */
+inline int opp_lowestbit(unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+/**
+ * Returns a pointer to the first CR or LF in the [s,end) range,
+ * or end if there is none.
+ */
+inline const char *opp_findlineend(const char *s, const char *end)
+{
+#ifdef __AVX2__
+    const __m256i cr32 = _mm256_set1_epi8('\r');
+    const __m256i lf32 = _mm256_set1_epi8('\n');
+    for (; end - s >= 32; s += 32)
+    {
+        __m256i c = _mm256_loadu_si256((const __m256i *)s);
+        unsigned int mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(c, cr32), _mm256_cmpeq_epi8(c, lf32)));
+        if (mask)
+            return s + opp_lowestbit(mask);
+    }
+#endif
+#ifdef HAVE_SSE2_SCAN
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    for (; end - s >= 16; s += 16)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i *)s);
+        unsigned int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(c, cr), _mm_cmpeq_epi8(c, lf)));
+        if (mask)
+            return s + opp_lowestbit(mask);
+    }
+#endif
+    while (s < end && *s != '\r' && *s != '\n')
+        s++;
+    return s;
+}
+
+/**
+ * Classifies the 16 bytes starting at s (all of them must be readable):
+ * bit i of sepMask is set if s[i] is sep1 or sep2, and bit i of specialMask
+ * is set if s[i] is a quote, a backslash or a NUL character. SSE2 only;
+ * without it, callers should use a byte-by-byte loop instead.
+ */
+#ifdef HAVE_SSE2_SCAN
+inline void opp_scanchunk16(const char *s, char sep1, char sep2, unsigned int& sepMask, unsigned int& specialMask)
+{
+    __m128i c = _mm_loadu_si128((const __m128i *)s);
+    sepMask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(sep1)), _mm_cmpeq_epi8(c, _mm_set1_epi8(sep2))));
+    __m128i special = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('"')), _mm_cmpeq_epi8(c, _mm_set1_epi8('\\')));
+    specialMask = _mm_movemask_epi8(_mm_or_si128(special, _mm_cmpeq_epi8(c, _mm_setzero_si128())));
+}
+#endif
+//@}
+
+#endif
@@ -0,0 +1,477 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <locale.h>
+#include "intxtypes.h"
+#include "doubleformat.h"
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#define HAVE_USELOCALE
+#include <pthread.h>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+#endif
+
+USING_NAMESPACE
+
+struct DiyFp
+{
+    uint64_t f;
+    int e;
+};
+
+struct CachedPower
+{
+    uint64_t f;
+    short e;            // binary exponent
+    short k;            // decimal exponent
+};
+
+// normalized 64-bit approximations of 10^k, for k = -348, -340, ..., 340
+static const CachedPower cachedPowers[] = {
+{ 0xfa8fd5a0081c0288ULL, -1220, -348 },
+    { 0xbaaee17fa23ebf76ULL, -1193, -340 },
+    { 0x8b16fb203055ac76ULL, -1166, -332 },
+    { 0xcf42894a5dce35eaULL, -1140, -324 },
+    { 0x9a6bb0aa55653b2dULL, -1113, -316 },
+    { 0xe61acf033d1a45dfULL, -1087, -308 },
+    { 0xab70fe17c79ac6caULL, -1060, -300 },
+    { 0xff77b1fcbebcdc4fULL, -1034, -292 },
+    { 0xbe5691ef416bd60cULL, -1007, -284 },
+    { 0x8dd01fad907ffc3cULL,  -980, -276 },
+    { 0xd3515c2831559a83ULL,  -954, -268 },
+    { 0x9d71ac8fada6c9b5ULL,  -927, -260 },
+    { 0xea9c227723ee8bcbULL,  -901, -252 },
+    { 0xaecc49914078536dULL,  -874, -244 },
+    { 0x823c12795db6ce57ULL,  -847, -236 },
+    { 0xc21094364dfb5637ULL,  -821, -228 },
+    { 0x9096ea6f3848984fULL,  -794, -220 },
+    { 0xd77485cb25823ac7ULL,  -768, -212 },
+    { 0xa086cfcd97bf97f4ULL,  -741, -204 },
+    { 0xef340a98172aace5ULL,  -715, -196 },
+    { 0xb23867fb2a35b28eULL,  -688, -188 },
+    { 0x84c8d4dfd2c63f3bULL,  -661, -180 },
+    { 0xc5dd44271ad3cdbaULL,  -635, -172 },
+    { 0x936b9fcebb25c996ULL,  -608, -164 },
+    { 0xdbac6c247d62a584ULL,  -582, -156 },
+    { 0xa3ab66580d5fdaf6ULL,  -555, -148 },
+    { 0xf3e2f893dec3f126ULL,  -529, -140 },
+    { 0xb5b5ada8aaff80b8ULL,  -502, -132 },
+    { 0x87625f056c7c4a8bULL,  -475, -124 },
+    { 0xc9bcff6034c13053ULL,  -449, -116 },
+    { 0x964e858c91ba2655ULL,  -422, -108 },
+    { 0xdff9772470297ebdULL,  -396, -100 },
+    { 0xa6dfbd9fb8e5b88fULL,  -369,  -92 },
+    { 0xf8a95fcf88747d94ULL,  -343,  -84 },
+    { 0xb94470938fa89bcfULL,  -316,  -76 },
+    { 0x8a08f0f8bf0f156bULL,  -289,  -68 },
+    { 0xcdb02555653131b6ULL,  -263,  -60 },
+    { 0x993fe2c6d07b7facULL,  -236,  -52 },
+    { 0xe45c10c42a2b3b06ULL,  -210,  -44 },
+    { 0xaa242499697392d3ULL,  -183,  -36 },
+    { 0xfd87b5f28300ca0eULL,  -157,  -28 },
+    { 0xbce5086492111aebULL,  -130,  -20 },
+    { 0x8cbccc096f5088ccULL,  -103,  -12 },
+    { 0xd1b71758e219652cULL,   -77,   -4 },
+    { 0x9c40000000000000ULL,   -50,    4 },
+    { 0xe8d4a51000000000ULL,   -24,   12 },
+    { 0xad78ebc5ac620000ULL,     3,   20 },
+    { 0x813f3978f8940984ULL,    30,   28 },
+    { 0xc097ce7bc90715b3ULL,    56,   36 },
+    { 0x8f7e32ce7bea5c70ULL,    83,   44 },
+    { 0xd5d238a4abe98068ULL,   109,   52 },
+    { 0x9f4f2726179a2245ULL,   136,   60 },
+    { 0xed63a231d4c4fb27ULL,   162,   68 },
+    { 0xb0de65388cc8ada8ULL,   189,   76 },
+    { 0x83c7088e1aab65dbULL,   216,   84 },
+    { 0xc45d1df942711d9aULL,   242,   92 },
+    { 0x924d692ca61be758ULL,   269,  100 },
+    { 0xda01ee641a708deaULL,   295,  108 },
+    { 0xa26da3999aef774aULL,   322,  116 },
+    { 0xf209787bb47d6b85ULL,   348,  124 },
+    { 0xb454e4a179dd1877ULL,   375,  132 },
+    { 0x865b86925b9bc5c2ULL,   402,  140 },
+    { 0xc83553c5c8965d3dULL,   428,  148 },
+    { 0x952ab45cfa97a0b3ULL,   455,  156 },
+    { 0xde469fbd99a05fe3ULL,   481,  164 },
+    { 0xa59bc234db398c25ULL,   508,  172 },
+    { 0xf6c69a72a3989f5cULL,   534,  180 },
+    { 0xb7dcbf5354e9beceULL,   561,  188 },
+    { 0x88fcf317f22241e2ULL,   588,  196 },
+    { 0xcc20ce9bd35c78a5ULL,   614,  204 },
+    { 0x98165af37b2153dfULL,   641,  212 },
+    { 0xe2a0b5dc971f303aULL,   667,  220 },
+    { 0xa8d9d1535ce3b396ULL,   694,  228 },
+    { 0xfb9b7cd9a4a7443cULL,   720,  236 },
+    { 0xbb764c4ca7a44410ULL,   747,  244 },
+    { 0x8bab8eefb6409c1aULL,   774,  252 },
+    { 0xd01fef10a657842cULL,   800,  260 },
+    { 0x9b10a4e5e9913129ULL,   827,  268 },
+    { 0xe7109bfba19c0c9dULL,   853,  276 },
+    { 0xac2820d9623bf429ULL,   880,  284 },
+    { 0x80444b5e7aa7cf85ULL,   907,  292 },
+    { 0xbf21e44003acdd2dULL,   933,  300 },
+    { 0x8e679c2f5e44ff8fULL,   960,  308 },
+    { 0xd433179d9c8cb841ULL,   986,  316 },
+    { 0x9e19db92b4e31ba9ULL,  1013,  324 },
+    { 0xeb96bf6ebadf77d9ULL,  1039,  332 },
+    { 0xaf87023b9bf0ee6bULL,  1066,  340 },
+};
+
+static const uint32_t smallPowersOfTen[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+static DiyFp multiply(const DiyFp& x, const DiyFp& y)
+{
+    // 64x64->128 bit multiplication, keeping the rounded upper half
+    const uint64_t M32 = 0xFFFFFFFFULL;
+    uint64_t a = x.f >> 32, b = x.f & M32;
+    uint64_t c = y.f >> 32, d = y.f & M32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32) + (1ULL << 31);
+    DiyFp r;
+    r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+    r.e = x.e + y.e + 64;
+    return r;
+}
+
+static DiyFp normalize(DiyFp x)
+{
+    while (!(x.f & 0xFFC0000000000000ULL))
+    {
+        x.f <<= 10;
+        x.e -= 10;
+    }
+    while (!(x.f & 0x8000000000000000ULL))
+    {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+static bool roundWeed(char *buffer, int length, uint64_t distanceTooHighW, uint64_t unsafeInterval,
+                      uint64_t rest, uint64_t tenKappa, uint64_t unit)
+{
+    uint64_t smallDistance = distanceTooHighW - unit;
+    uint64_t bigDistance = distanceTooHighW + unit;
+
+    // move the last digit down while it gets closer to w (and stays in the safe interval)
+    while (rest < smallDistance && unsafeInterval - rest >= tenKappa &&
+           (rest + tenKappa < smallDistance || smallDistance - rest >= rest + tenKappa - smallDistance))
+    {
+        buffer[length - 1]--;
+        rest += tenKappa;
+    }
+
+    // if another candidate is closer to w's upper approximation, the result is ambiguous
+    if (rest < bigDistance && unsafeInterval - rest >= tenKappa &&
+        (rest + tenKappa < bigDistance || bigDistance - rest > rest + tenKappa - bigDistance))
+        return false;
+
+    return 2 * unit <= rest && rest <= unsafeInterval - 4 * unit;
+}
+
+static bool digitGen(const DiyFp& low, const DiyFp& w, const DiyFp& high, char *buffer, int& length, int& kappa)
+{
+    uint64_t unit = 1;
+    DiyFp tooLow = { low.f - unit, low.e };
+    DiyFp tooHigh = { high.f + unit, high.e };
+    uint64_t unsafeInterval = tooHigh.f - tooLow.f;
+    int shift = -w.e;
+    uint64_t one = 1ULL << shift;
+    uint32_t integrals = (uint32_t)(tooHigh.f >> shift);
+    uint64_t fractionals = tooHigh.f & (one - 1);
+
+    int numDigits = 1;
+    while (numDigits < 10 && integrals >= smallPowersOfTen[numDigits])
+        numDigits++;
+    uint32_t divisor = smallPowersOfTen[numDigits - 1];
+    kappa = numDigits;
+    length = 0;
+
+    while (kappa > 0)
+    {
+        buffer[length++] = (char)('0' + integrals / divisor);
+        integrals %= divisor;
+        kappa--;
+        uint64_t rest = ((uint64_t)integrals << shift) + fractionals;
+        if (rest < unsafeInterval)
+            return roundWeed(buffer, length, tooHigh.f - w.f, unsafeInterval, rest, (uint64_t)divisor << shift, unit);
+        divisor /= 10;
+    }
+
+    for (;;)
+    {
+        fractionals *= 10;
+        unit *= 10;
+        unsafeInterval *= 10;
+        buffer[length++] = (char)('0' + (int)(fractionals >> shift));
+        fractionals &= one - 1;
+        kappa--;
+        if (fractionals < unsafeInterval)
+            return roundWeed(buffer, length, (tooHigh.f - w.f) * unit, unsafeInterval, fractionals, one, unit);
+    }
+}
+
+/*
+ * Produces the shortest digit string of a positive finite double; the value
+ * is digits * 10^decimalExponent. Returns false in the rare cases Grisu3
+ * cannot decide, see Loitsch: "Printing Floating-Point Numbers Quickly and
+ * Accurately with Integers", PLDI 2010.
+ */
+static bool grisu3(double d, char *buffer, int& length, int& decimalExponent)
+{
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    uint64_t fraction = bits & 0x000FFFFFFFFFFFFFULL;
+    int biasedExponent = (int)((bits >> 52) & 0x7FF);
+
+    DiyFp v;
+    if (biasedExponent != 0)
+    {
+        v.f = fraction | 0x0010000000000000ULL;
+        v.e = biasedExponent - 1075;
+    }
+    else
+    {
+        v.f = fraction;
+        v.e = -1074;
+    }
+
+    // boundaries: halfway to the neighbouring doubles
+    DiyFp plus = { (v.f << 1) + 1, v.e - 1 };
+    plus = normalize(plus);
+    DiyFp minus;
+    if (fraction == 0 && biasedExponent > 1)
+    {
+        minus.f = (v.f << 2) - 1;  // the lower neighbour is closer
+        minus.e = v.e - 2;
+    }
+    else
+    {
+        minus.f = (v.f << 1) - 1;
+        minus.e = v.e - 1;
+    }
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+    DiyFp w = normalize(v);
+
+    // choose a cached power that brings the exponent into [-60,-32]
+    int minExponent = -60 - (w.e + 64);
+    int k = (int)ceil((minExponent + 63) * 0.30102999566398114);
+    const CachedPower& cachedPower = cachedPowers[(348 + k - 1) / 8 + 1];
+    DiyFp tenMk = { cachedPower.f, cachedPower.e };
+
+    DiyFp scaledW = multiply(w, tenMk);
+    DiyFp scaledMinus = multiply(minus, tenMk);
+    DiyFp scaledPlus = multiply(plus, tenMk);
+
+    int kappa;
+    if (!digitGen(scaledMinus, scaledW, scaledPlus, buffer, length, kappa))
+        return false;
+    decimalExponent = kappa - cachedPower.k;
+    return true;
+}
+
+/*
+ * Slow but exact fallback: tries 15, 16 and 17 significant digits with printf.
+ * Only the digits and the exponent are used, so the locale does not matter.
+ */
+static void printfShortest(double d, char *buffer, int& length, int& decimalExponent)
+{
+    char tmp[40];
+    for (int prec = 15; prec <= 17; prec++)
+    {
+        sprintf(tmp, "%.*e", prec - 1, d);
+        if (prec == 17 || strtod(tmp, NULL) == d)
+            break;
+    }
+
+    // collect mantissa digits, and parse the exponent
+    length = 0;
+    const char *s = tmp;
+    for (; *s && *s != 'e'; s++)
+        if (*s >= '0' && *s <= '9')
+            buffer[length++] = *s;
+    int exponent = *s ? atoi(s + 1) : 0;
+    while (length > 1 && buffer[length - 1] == '0')
+        length--;
+    decimalExponent = exponent - length + 1;
+}
+
+static char *formatExponent(char *p, int exponent)
+{
+    *p++ = 'e';
+    if (exponent < 0)
+    {
+        *p++ = '-';
+        exponent = -exponent;
+    }
+    else
+        *p++ = '+';
+    if (exponent >= 100)
+    {
+        *p++ = (char)('0' + exponent / 100);
+        exponent %= 100;
+    }
+    *p++ = (char)('0' + exponent / 10);
+    *p++ = (char)('0' + exponent % 10);
+    return p;
+}
+
+#ifdef HAVE_USELOCALE
+static locale_t cLocale = (locale_t)0;
+static pthread_once_t cLocaleOnce = PTHREAD_ONCE_INIT;
+
+static void createCLocale()
+{
+    cLocale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+}
+#endif
+
+/*
+ * printf("%.*g") with '.' as decimal point, whatever the LC_NUMERIC setting
+ * of the process is. Returns the length of the output.
+ */
+static int printfInCLocale(char *buf, int prec, double d)
+{
+#ifdef HAVE_USELOCALE
+    // uselocale() only affects the calling thread
+    pthread_once(&cLocaleOnce, createCLocale);
+    if (cLocale)
+    {
+        locale_t oldLocale = uselocale(cLocale);
+        int length = sprintf(buf, "%.*g", prec, d);
+        uselocale(oldLocale);
+        return length;
+    }
+#endif
+    int length = sprintf(buf, "%.*g", prec, d);
+    const char *decimalPoint = localeconv()->decimal_point;
+    if (decimalPoint[0] == '.' && decimalPoint[1] == '\0')
+        return length;
+    char *p = strstr(buf, decimalPoint);
+    if (p)
+    {
+        int decimalPointLength = strlen(decimalPoint);
+        *p = '.';
+        memmove(p + 1, p + decimalPointLength, buf + length - (p + decimalPointLength) + 1);
+        length -= decimalPointLength - 1;
+    }
+    return length;
+}
+
+char *opp_formatdouble(char *buf, double d, int prec, char *&endp)
+{
+    if (prec > 0)
+    {
+        endp = buf + printfInCLocale(buf, prec, d);
+        return buf;
+    }
+
+    char *p = buf;
+    if (d != d)
+    {
+        strcpy(p, "nan");
+        endp = p + 3;
+        return buf;
+    }
+    if (d < 0 || (d == 0 && 1 / d < 0))
+    {
+        *p++ = '-';
+        d = -d;
+    }
+    if (d == 0)
+    {
+        strcpy(p, "0");
+        endp = p + 1;
+        return buf;
+    }
+    if (d > DBL_MAX)
+    {
+        strcpy(p, "inf");
+        endp = p + 3;
+        return buf;
+    }
+
+    char digits[20];
+    int length, exponent;
+    if (!grisu3(d, digits, length, exponent))
+        printfShortest(d, digits, length, exponent);
+
+    // like %g: plain notation for moderate exponents, scientific otherwise
+    int point = length + exponent;  // position of the decimal point after the first digit
+    if (point > -4 && point <= 15)
+    {
+        if (point <= 0)
+        {
+            *p++ = '0';
+            *p++ = '.';
+            for (int i = point; i < 0; i++)
+                *p++ = '0';
+            memcpy(p, digits, length);
+            p += length;
+        }
+        else if (point >= length)
+        {
+            memcpy(p, digits, length);
+            p += length;
+            for (int i = length; i < point; i++)
+                *p++ = '0';
+        }
+        else
+        {
+            memcpy(p, digits, point);
+            p += point;
+            *p++ = '.';
+            memcpy(p, digits + point, length - point);
+            p += length - point;
+        }
+    }
+    else
+    {
+        *p++ = digits[0];
+        if (length > 1)
+        {
+            *p++ = '.';
+            memcpy(p, digits + 1, length - 1);
+            p += length - 1;
+        }
+        p = formatExponent(p, point - 1);
+    }
+    *p = '\0';
+    endp = p;
+    return buf;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _DOUBLEFORMAT_H_
+#define _DOUBLEFORMAT_H_
+
+#include "commondefs.h"
+
+NAMESPACE_BEGIN
+
+/**
+ * Precision value that makes opp_formatdouble() produce the shortest exact
+ * representation.
+ */
+#define SHORTEST_PRECISION  0
+
+/**
+ * Buffer size needed by opp_formatdouble().
+ */
+#define FORMATDOUBLE_BUFSIZE  32
+
+/**
+ * Writes d into buf, and returns buf; endp is set to the terminating zero.
+ * With SHORTEST_PRECISION, it writes the shortest decimal representation
+ * that reads back as exactly d, in %g-like notation (this is locale
+ * independent, and several times faster than printf); otherwise it is
+ * equivalent to printf's "%.*g" with the given precision in the "C" locale.
+ */
+COMMON_API char *opp_formatdouble(char *buf, double d, int prec, char *&endp);
+
+NAMESPACE_END
+
+
+#endif
@@ -29,8 +29,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 #include "platmisc.h"
 #include "commonutil.h"
+#include "charscan.h"
 #include "filereader.h"
 #include "exception.h"
 
@@ -41,14 +45,19 @@ USING_NAMESPACE
 #define PRINT_DEBUG_MESSAGES false
 
 FileReader::FileReader(const char *fileName, size_t bufferSize)
-   : fileName(fileName), bufferSize(bufferSize),
-     bufferBegin(new char[bufferSize]), bufferEnd(bufferBegin + bufferSize),
+   : fileName(fileName), buffer(new char[bufferSize]), bufferSize(bufferSize),
+     bufferBegin(buffer), bufferEnd(bufferBegin + bufferSize),
      maxLineSize(bufferSize / 2)
 {
     f = NULL;
     checkFileChanged = true;
     synchronizeWhenAppended = true;
 
+    memoryMapped = false;
+    accessPattern = SEQUENTIAL;
+    mapped = false;
+    mappingSize = 0;
+
     numReadLines = 0;
     numReadBytes = 0;
 
@@ -71,10 +80,21 @@ FileReader::FileReader(const char *fileName, size_t bufferSize)
 
 FileReader::~FileReader()
 {
-    delete [] bufferBegin;
+    unmapFile();
+    delete [] buffer;
     ensureFileClosed();
 }
 
+void FileReader::setMemoryMapped(bool value, AccessPattern pattern)
+{
+    if (f || mapped)
+        throw opp_runtime_error("FileReader: cannot change the access method of an open file `%s'", fileName.c_str());
+#ifndef _WIN32
+    memoryMapped = value;
+    accessPattern = pattern;
+#endif
+}
+
 void FileReader::ensureFileOpenInternal()
 {
     if (!f) {
@@ -84,11 +104,84 @@ void FileReader::ensureFileOpenInternal()
         if (!f)
             throw opp_runtime_error("Cannot open file `%s'", fileName.c_str());
 
+        if (memoryMapped && !mapped)
+            mapFile();
+
         if (bufferFileOffset == -1)
             seekTo(0);
     }
 }
 
+void FileReader::mapFile()
+{
+#ifndef _WIN32
+    Assert(f && !storedDataPointer);
+    file_offset_t currentOffset = currentDataPointer ? currentDataPointer - bufferBegin : 0;
+    bool remapping = mapped;
+    unmapFile();
+
+    struct opp_stat_t s;
+    opp_fstat(fileno(f), &s);
+    int64 size = s.st_size;
+
+    if (size > 0) {
+        void *p = mmap(NULL, size, PROT_READ, MAP_SHARED, fileno(f), 0);
+        if (p == MAP_FAILED) {
+            if (remapping)
+                throw opp_runtime_error("Cannot map file `%s' into memory", fileName.c_str());
+            memoryMapped = false;  // e.g. not a regular file, read it through the buffer
+            return;
+        }
+        madvise(p, size, accessPattern == RANDOM ? MADV_RANDOM : MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+        madvise(p, size, MADV_HUGEPAGE);  // only a hint, fails where the file system does not support it
+#endif
+        bufferBegin = (const char *)p;
+    }
+    else
+        bufferBegin = "";  // mmap() does not accept zero length
+
+    mapped = true;
+    mappingSize = size;
+    bufferSize = size;
+    bufferEnd = bufferBegin + size;
+    maxLineSize = size;
+    bufferFileOffset = 0;
+    dataBegin = (char *)bufferBegin;
+    dataEnd = (char *)bufferEnd;
+    currentDataPointer = (char *)bufferBegin + std::min(currentOffset, (file_offset_t)size);
+#endif
+}
+
+void FileReader::unmapFile()
+{
+#ifndef _WIN32
+    if (mapped) {
+        if (mappingSize > 0)
+            munmap((void *)bufferBegin, mappingSize);
+        mapped = false;
+        mappingSize = 0;
+        bufferBegin = bufferEnd = buffer;
+        bufferSize = 0;
+        dataBegin = dataEnd = currentDataPointer = NULL;
+    }
+#endif
+}
+
+void FileReader::prefetch(file_offset_t offset, int64 length)
+{
+#ifndef _WIN32
+    ensureFileOpen();
+    if (mapped && offset >= 0 && offset < (file_offset_t)mappingSize) {
+        // madvise() needs a page aligned address
+        static const long pageSize = sysconf(_SC_PAGESIZE);
+        file_offset_t begin = offset - offset % pageSize;
+        file_offset_t end = std::min(offset + length, (file_offset_t)mappingSize);
+        madvise((void *)(bufferBegin + begin), end - begin, MADV_WILLNEED);
+    }
+#endif
+}
+
 void FileReader::ensureFileOpen()
 {
     if (!f) {
@@ -117,7 +210,8 @@ void FileReader::restorePosition()
     Assert(storedBufferFileOffset != -1 && storedDataPointer);
     bufferFileOffset = storedBufferFileOffset;
     setCurrentDataPointer(storedDataPointer);
-    dataBegin = dataEnd = NULL;
+    if (!mapped)
+        dataBegin = dataEnd = NULL;
     storedBufferFileOffset = -1;
     storedDataPointer = NULL;
 }
@@ -164,7 +258,10 @@ void FileReader::synchronize()
 
     if (newFileSize != fileSize || lastLineOffset == -1) {
         fileSize = newFileSize;
-        dataBegin = dataEnd = NULL;
+        if (!mapped)
+            dataBegin = dataEnd = NULL;
+        else if ((int64)mappingSize != newFileSize)
+            mapFile();
 
         // read in the last line from the file
         storePosition();
@@ -235,6 +332,13 @@ void FileReader::fillBuffer(bool forward)
     checkConsistence();
 #endif
 
+    if (mapped) {
+        // the whole file is in memory, only look for appended content when reading the last line
+        if (forward && checkFileChanged && pointerToFileOffset(currentDataPointer) >= lastLineOffset)
+            checkFileChangedAndSynchronize();
+        return;
+    }
+
     char *dataPointer;
     int dataLength;
 
@@ -350,8 +454,7 @@ char *FileReader::findNextLineStart(char *start, bool bufferFilled)
     char *s = start;
 
     // find next CR/LF (fast path)
-    while (s < dataEnd && *s != '\r' && *s!= '\n')
-        s++;
+    s = (char *)opp_findlineend(s, dataEnd);
 
     if (s < dataEnd && *s == '\r')
         s++;
@@ -586,6 +689,11 @@ void FileReader::seekTo(file_offset_t fileOffset, unsigned int ensureBufferSizeA
 
     ensureFileOpen();
 
+    if (mapped) {
+        setCurrentDataPointer(fileOffsetToPointer(fileOffset));
+        return;
+    }
+
     // check if requested offset is already in memory
     if (bufferFileOffset != -1 &&
         bufferFileOffset + ensureBufferSizeAround <= fileOffset &&
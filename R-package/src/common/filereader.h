@@ -48,10 +48,21 @@ NAMESPACE_BEGIN
  * the file in both directions from both ends. Automatically follows file
  * content when appended, but overwriting the file causes an exception to be thrown.
  *
+ * Optionally the whole file can be memory-mapped instead of being read into
+ * the buffer (see setMemoryMapped()). Lines are then returned directly from
+ * the mapping without copying, and there is no limit on the line length.
+ * A mapped file must not be truncated while it is being read.
+ *
  * All functions throw class opp_runtime_error on error.
  */
 class COMMON_API FileReader
 {
+  public:
+    enum AccessPattern {
+        SEQUENTIAL,
+        RANDOM
+    };
+
   private:
     // the file
     const std::string fileName;
@@ -59,11 +70,18 @@ class COMMON_API FileReader
     bool checkFileChanged;
     bool synchronizeWhenAppended;
 
-    // the buffer
-    const size_t bufferSize;
+    // the buffer; points into the mapping when the file is mapped
+    char *buffer;
+    size_t bufferSize;
     const char *bufferBegin;
     const char *bufferEnd; // = buffer + bufferSize
-    const size_t maxLineSize;
+    size_t maxLineSize;
+
+    // memory mapping of the whole file
+    bool memoryMapped; // requested by the user
+    AccessPattern accessPattern;
+    bool mapped; // the file is currently mapped
+    size_t mappingSize;
 
     // file positions and size
     file_offset_t bufferFileOffset;
@@ -110,6 +128,10 @@ class COMMON_API FileReader
 
     void ensureFileOpenInternal();
 
+    // (re)maps the file with its current size, or releases the mapping
+    void mapFile();
+    void unmapFile();
+
     // assert data structure consistence
     void checkConsistence(bool checkDataPointer = false) const;
     FileChangedState checkFileChangedAndSynchronize();
@@ -155,6 +177,24 @@ class COMMON_API FileReader
      */
     void setSynchronizeWhenAppended(bool value) { synchronizeWhenAppended = value; }
 
+    /**
+     * Controls whether the file is memory-mapped instead of being read through the buffer.
+     * The access pattern is passed to the operating system as a hint. It must be called
+     * before the file is opened. It has no effect on platforms without mmap().
+     */
+    void setMemoryMapped(bool value, AccessPattern pattern = SEQUENTIAL);
+
+    /**
+     * Returns true if the file is read through a memory mapping.
+     */
+    bool isMemoryMapped() const { return memoryMapped; }
+
+    /**
+     * Tells the operating system that the given region of a memory-mapped file
+     * will be read soon. Does nothing if the file is not mapped.
+     */
+    void prefetch(file_offset_t offset, int64 length);
+
     /**
      * This method is called automatically whenever the file is accessed through a public function.
      */
@@ -29,6 +29,7 @@
 #include <sstream>
 #include <string.h>
 #include "exception.h"
+#include "charscan.h"
 #include "linetokenizer.h"
 
 USING_NAMESPACE
@@ -44,7 +45,7 @@ LineTokenizer::LineTokenizer(int bufferSize, int maxTokenNum, char sep1, char se
     vec = new char *[vecsize];
 
     lineBufferSize = bufferSize;
-    lineBuffer = new char[lineBufferSize];
+    lineBuffer = new char[lineBufferSize + 16];  // padding for the vectorized scan
 }
 
 LineTokenizer::~LineTokenizer()
@@ -113,6 +114,48 @@ int LineTokenizer::tokenize(const char *line, int length)
     if (length >= lineBufferSize)
         throw opp_runtime_error("Cannot tokenize lines longer than %d", lineBufferSize - 1);
 
+#ifdef HAVE_SSE2_SCAN
+    // fast path: split the line in one pass, 16 bytes at a time;
+    // lines with quotes or backslashes are left to tokenizeScalar()
+    memcpy(lineBuffer, line, length);
+    int len = length;
+    while (len > 0 && (lineBuffer[len-1] == '\r' || lineBuffer[len-1] == '\n'))
+        len--;
+    lineBuffer[len] = '\0';
+
+    numtokens = 0;
+    unsigned int afterSeparator = 1;  // line start counts as a separator
+    for (int k = 0; k < len; k += 16)
+    {
+        unsigned int sepMask, specialMask;
+        opp_scanchunk16(lineBuffer + k, sep1, sep2, sepMask, specialMask);
+        unsigned int validMask = len - k >= 16 ? 0xffff : (1u << (len - k)) - 1;
+        if (specialMask & validMask)
+            return tokenizeScalar(line, length);
+        sepMask &= validMask;
+
+        // tokens start at non-separators that follow a separator
+        unsigned int startMask = ~sepMask & validMask & ((sepMask << 1) | afterSeparator);
+        afterSeparator = (sepMask >> 15) & 1;
+        for (; startMask; startMask &= startMask - 1)
+        {
+            if (numtokens==vecsize)
+                throw opp_runtime_error("Too many tokens on a line, max %d allowed", vecsize-1);
+            vec[numtokens++] = lineBuffer + k + opp_lowestbit(startMask);
+        }
+
+        // terminate tokens
+        for (; sepMask; sepMask &= sepMask - 1)
+            lineBuffer[k + opp_lowestbit(sepMask)] = '\0';
+    }
+    return numtokens;
+#else
+    return tokenizeScalar(line, length);
+#endif
+}
+
+int LineTokenizer::tokenizeScalar(const char *line, int length)
+{
     strncpy(lineBuffer, line, length);
     lineBuffer[length] = '\0'; // guard
 
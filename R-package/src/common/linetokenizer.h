@@ -56,6 +56,10 @@ class COMMON_API LineTokenizer
     int vecsize;
     int numtokens;
 
+    // byte-by-byte tokenizing; used for lines with quotes or backslashes,
+    // and on platforms without SSE2
+    int tokenizeScalar(const char *line, int length);
+
   public:
     /**
      * Constructor.
@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <float.h>
+#include <locale.h>
+#include <string>
+#include "platmisc.h"
+#include "numberparser.h"
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#define HAVE_STRTOD_L
+#include <pthread.h>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+#endif
+
+// The fast path of opp_parsedouble() relies on every double operation being
+// rounded once, which is not the case with the x87 FPU's extended precision.
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD != 0
+#define NO_EXACT_DOUBLE_FASTPATH
+#endif
+
+NAMESPACE_BEGIN
+
+static inline bool isDigit(char c)
+{
+    return (unsigned char)(c - '0') < 10;
+}
+
+// powers of ten that are exactly representable as double
+static const double exactPowersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define MAX_EXACT_POWER_OF_TEN  22
+#define MAX_EXACT_MANTISSA      (((uint64)1) << 53)
+
+#ifdef HAVE_STRTOD_L
+static locale_t cLocale = (locale_t)0;
+static pthread_once_t cLocaleOnce = PTHREAD_ONCE_INIT;
+
+static void createCLocale()
+{
+    cLocale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+}
+
+static locale_t getCLocale()
+{
+    // created once, on first use, by whichever thread gets here first
+    pthread_once(&cLocaleOnce, createCLocale);
+    return cLocale;
+}
+#endif
+
+double opp_strtod_c(const char *s, char **endptr)
+{
+#ifdef HAVE_STRTOD_L
+    locale_t cLocale = getCLocale();
+    if (cLocale)
+        return strtod_l(s, endptr, cLocale);
+#endif
+    const char *decimalPoint = localeconv()->decimal_point;
+    if (decimalPoint[0] == '.' && decimalPoint[1] == '\0')
+        return strtod(s, endptr);
+
+    // The locale uses a different decimal point: copy the part of the string
+    // that can belong to a number, replacing '.' with the locale's decimal point.
+    const char *p = s;
+    while (*p == ' ' || (*p >= '\t' && *p <= '\r'))
+        p++;
+    while (isalnum((unsigned char)*p) || *p == '.' || *p == '+' || *p == '-' || *p == '(' || *p == ')' || *p == '_')
+        p++;
+    std::string copy(s, p);
+    size_t dotPos = copy.find('.');
+    size_t decimalPointLength = strlen(decimalPoint);
+    if (dotPos != std::string::npos)
+        copy.replace(dotPos, 1, decimalPoint);
+
+    char *copyEnd;
+    double d = strtod(copy.c_str(), &copyEnd);
+    if (endptr)
+    {
+        size_t consumed = copyEnd - copy.c_str();
+        if (dotPos != std::string::npos && consumed > dotPos)
+            consumed -= decimalPointLength - 1;
+        *endptr = const_cast<char *>(s + consumed);
+    }
+    return d;
+}
+
+// Parses [+-]digits with at most maxDigits digits and nothing after them.
+// Returns false for anything else, including longer numbers.
+static inline bool parseSmallInteger(const char *s, const char *end, int maxDigits, int64& dest)
+{
+    const char *p = s;
+    bool negative = false;
+    if (p != end && *p == '-')
+    {
+        negative = true;
+        p++;
+    }
+    else if (p != end && *p == '+')
+        p++;
+
+    const char *digitsStart = p;
+    uint64 value = 0;
+    while (p != end && isDigit(*p))
+    {
+        if (p - digitsStart == maxDigits)
+            return false;
+        value = value * 10 + (*p++ - '0');
+    }
+    if (p == digitsStart || p != end)
+        return false;
+
+    dest = negative ? -(int64)value : (int64)value;
+    return true;
+}
+
+bool opp_parseint(const char *s, int& dest)
+{
+    int64 value;
+    if (parseSmallInteger(s, s + strlen(s), 9, value))
+    {
+        dest = (int)value;
+        return true;
+    }
+    char *e;
+    dest = (int)strtol(s, &e, 10);
+    return !*e;
+}
+
+bool opp_parselong(const char *s, long& dest)
+{
+    int64 value;
+    if (parseSmallInteger(s, s + strlen(s), 9, value))
+    {
+        dest = (long)value;
+        return true;
+    }
+    char *e;
+    dest = strtol(s, &e, 10);
+    return !*e;
+}
+
+bool opp_parseint64(const char *s, int64& dest)
+{
+    if (parseSmallInteger(s, s + strlen(s), 18, dest))
+        return true;
+    char *e;
+    dest = strtoll(s, &e, 10);
+    return !*e;
+}
+
+// Converts [+-]digits[.digits][(e|E)[+-]digits] exactly, if the significant
+// digits fit into 53 bits and the exponent is small enough that the result
+// is the correctly rounded product or quotient of two exact doubles
+// (Clinger's fast path). Returns false if the range is not handled.
+static bool parseDoubleFast(const char *s, const char *end, double& dest)
+{
+#ifdef NO_EXACT_DOUBLE_FASTPATH
+    return false;
+#else
+    const char *p = s;
+    bool negative = false;
+    if (p != end && *p == '-')
+    {
+        negative = true;
+        p++;
+    }
+    else if (p != end && *p == '+')
+        p++;
+
+    uint64 mantissa = 0;
+    int significantDigits = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+
+    for (; p != end && isDigit(*p); p++)
+    {
+        hasDigits = true;
+        if (mantissa != 0 || *p != '0')
+        {
+            if (++significantDigits > 19)
+                return false;
+            mantissa = mantissa * 10 + (*p - '0');
+        }
+    }
+    if (p != end && *p == '.')
+    {
+        for (p++; p != end && isDigit(*p); p++)
+        {
+            hasDigits = true;
+            exponent--;
+            if (mantissa != 0 || *p != '0')
+            {
+                if (++significantDigits > 19)
+                    return false;
+                mantissa = mantissa * 10 + (*p - '0');
+            }
+        }
+    }
+    if (!hasDigits)
+        return false;
+
+    if (p != end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool negativeExponent = false;
+        if (p != end && *p == '-')
+        {
+            negativeExponent = true;
+            p++;
+        }
+        else if (p != end && *p == '+')
+            p++;
+        if (p == end || !isDigit(*p))
+            return false;
+        int explicitExponent = 0;
+        for (; p != end && isDigit(*p); p++)
+        {
+            if (explicitExponent > 9999)
+                return false;
+            explicitExponent = explicitExponent * 10 + (*p - '0');
+        }
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+    if (p != end)
+        return false;
+
+    double value;
+    if (mantissa == 0)
+        value = 0.0;
+    else if (mantissa > MAX_EXACT_MANTISSA)
+        return false;
+    else if (exponent >= 0 && exponent <= MAX_EXACT_POWER_OF_TEN)
+        value = (double)mantissa * exactPowersOfTen[exponent];
+    else if (exponent < 0 && exponent >= -MAX_EXACT_POWER_OF_TEN)
+        value = (double)mantissa / exactPowersOfTen[-exponent];
+    else if (exponent > MAX_EXACT_POWER_OF_TEN && exponent <= MAX_EXACT_POWER_OF_TEN + 15)
+    {
+        // move the excess into the mantissa, if it stays exact
+        uint64 scaledMantissa = mantissa;
+        for (int i = MAX_EXACT_POWER_OF_TEN; i < exponent; i++)
+        {
+            scaledMantissa *= 10;
+            if (scaledMantissa > MAX_EXACT_MANTISSA)
+                return false;
+        }
+        value = (double)scaledMantissa * exactPowersOfTen[MAX_EXACT_POWER_OF_TEN];
+    }
+    else
+        return false;
+
+    dest = negative ? -value : value;
+    return true;
+#endif
+}
+
+bool opp_parsedouble(const char *s, double& dest)
+{
+    if (parseDoubleFast(s, s + strlen(s), dest))
+        return true;
+    char *e;
+    dest = opp_strtod_c(s, &e);
+    return !*e;
+}
+
+bool opp_parsedecimal(const char *s, const char *end, int64& mantissa, int& scale)
+{
+    const char *p = s;
+    bool negative = false;
+    if (p != end && *p == '-')
+    {
+        negative = true;
+        p++;
+    }
+    else if (p != end && *p == '+')
+        p++;
+
+    const char *digitsStart = p;
+    uint64 value = 0;
+    for (; p != end && isDigit(*p); p++)
+        value = value * 10 + (*p - '0');
+    int integerDigits = p - digitsStart;
+    int fractionDigits = 0;
+    if (p != end && *p == '.')
+    {
+        const char *fractionStart = ++p;
+        for (; p != end && isDigit(*p); p++)
+            value = value * 10 + (*p - '0');
+        fractionDigits = p - fractionStart;
+    }
+
+    // up to 18 digits always fit into an int64; longer numbers (even if
+    // they only have leading zeros) are left to the caller
+    int digits = integerDigits + fractionDigits;
+    if (p != end || digits == 0 || digits > 18)
+        return false;
+
+    mantissa = negative ? -(int64)value : (int64)value;
+    scale = -fractionDigits;
+    return true;
+}
+
+bool opp_parsedecimal(const char *s, int64& mantissa, int& scale)
+{
+    return opp_parsedecimal(s, s + strlen(s), mantissa, scale);
+}
+
+bool opp_parseint64(const char *s, const char *end, int64& dest)
+{
+    return parseSmallInteger(s, end, 18, dest);
+}
+
+bool opp_parsedouble(const char *s, const char *end, double& dest)
+{
+    return parseDoubleFast(s, end, dest);
+}
+
+NAMESPACE_END
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _NUMBERPARSER_H_
+#define _NUMBERPARSER_H_
+
+#include "commondefs.h"
+#include "intxtypes.h"
+
+NAMESPACE_BEGIN
+
+/**
+ * Number parsing for the result file readers. The functions below accept
+ * the same syntax as the C library functions they replace, but handle the
+ * common case (plain decimal numbers) directly, without calling into the C
+ * library. They never depend on or modify the global locale, so they are
+ * safe to call from several threads at once.
+ */
+//@{
+
+/**
+ * Like strtod(), but always uses '.' as decimal point, regardless of the
+ * LC_NUMERIC setting of the process.
+ */
+COMMON_API double opp_strtod_c(const char *s, char **endptr);
+
+/**
+ * Parses the whole string as a decimal integer, like strtol(s,&e,10) with
+ * a check for *e=='\0'. Returns false if there is trailing garbage.
+ */
+COMMON_API bool opp_parseint(const char *s, int& dest);
+
+/**
+ * Same as opp_parseint(), for long.
+ */
+COMMON_API bool opp_parselong(const char *s, long& dest);
+
+/**
+ * Same as opp_parseint(), for int64.
+ */
+COMMON_API bool opp_parseint64(const char *s, int64& dest);
+
+/**
+ * Parses the whole string as a floating point number, like opp_strtod_c()
+ * with a check for trailing garbage. Numbers with at most 19 significant
+ * digits and a small exponent are converted exactly without strtod().
+ */
+COMMON_API bool opp_parsedouble(const char *s, double& dest);
+
+/**
+ * Parses a fixed-point decimal number of the form [+-]digits[.digits] into
+ * an int64 mantissa and a decimal scale, so that the value is
+ * mantissa * 10^scale. Returns false if the string has a different syntax
+ * (exponent, special values, etc.) or the digits do not fit into an int64;
+ * callers should then fall back to a general parser.
+ */
+COMMON_API bool opp_parsedecimal(const char *s, int64& mantissa, int& scale);
+//@}
+
+/**
+ * Variants that parse the [s,end) range of a line buffer, which does not
+ * need to be zero-terminated. They only handle plain decimal numbers
+ * (the cases the above functions convert without the C library), and
+ * return false for anything else. The caller should then fall back to
+ * the zero-terminated variants.
+ */
+//@{
+COMMON_API bool opp_parseint64(const char *s, const char *end, int64& dest);
+COMMON_API bool opp_parsedouble(const char *s, const char *end, double& dest);
+COMMON_API bool opp_parsedecimal(const char *s, const char *end, int64& mantissa, int& scale);
+//@}
+
+NAMESPACE_END
+
+#endif
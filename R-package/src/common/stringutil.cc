@@ -37,6 +37,7 @@
 #include "opp_ctype.h"
 #include "stringutil.h"
 #include "stringtokenizer.h"
+#include "numberparser.h"
 
 USING_NAMESPACE
 
@@ -489,8 +490,7 @@ unsigned long opp_atoul(const char *s)
 
 double opp_strtod(const char *s, char **endptr)
 {
-    setlocale(LC_NUMERIC, "C");
-    double d = strtod(s, endptr);
+    double d = opp_strtod_c(s, endptr);
     if (d==-HUGE_VAL || d==HUGE_VAL)
         throw opp_runtime_error("overflow converting `%s' to double", s);
     return d;
@@ -499,7 +499,6 @@ double opp_strtod(const char *s, char **endptr)
 double opp_atof(const char *s)
 {
     char *endptr;
-    setlocale(LC_NUMERIC, "C");
     double d = opp_strtod(s, &endptr);
     while (opp_isspace(*endptr))
         endptr++;
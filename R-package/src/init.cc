@@ -31,6 +31,7 @@
 
 #include "loadDataset.h"
 #include "loadVectors.h"
+#include "loadSharedMemoryVectors.h"
 #include "generateIndexFiles.h"
 
 extern "C" {
@@ -45,6 +46,7 @@ R_CMethodDef cMethods[] = {
 R_CallMethodDef callMethods[] = {
         {"callLoadDataset", (DL_FUNC)&callLoadDataset, 2},
         {"callLoadVectors", (DL_FUNC)&callLoadVectors, 2},
+        {"callLoadSharedMemoryVectors", (DL_FUNC)&callLoadSharedMemoryVectors, 3},
         {"callGenerateIndexFiles", (DL_FUNC)&callGenerateIndexFiles, 2},
         {NULL, NULL, 0}
 };
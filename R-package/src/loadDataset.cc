@@ -65,13 +65,10 @@ static ResultFileList loadFiles(SEXP files, ResultFileManager &manager)
         throw opp_runtime_error("files is not a character vector");
 
     int numOfFiles = GET_LENGTH(files);
-    ResultFileList fileList;
+    std::vector<std::string> fileNames;
     for (int j = 0; j < numOfFiles; ++j)
-    {
-        const char *f = CHAR(STRING_ELT(files, j));
-        fileList.push_back(manager.loadFile(f));
-    }
-    return fileList;
+        fileNames.push_back(CHAR(STRING_ELT(files, j)));
+    return manager.loadFiles(fileNames);
 }
 
 static IDList selectIDs(int type, const char *pattern, const ResultFileManager &manager)
@@ -166,10 +163,10 @@ static void addResultItemAttributes(SEXP attributes, int &currentIndex, const ch
     for (int i = 0; i < ids.size(); ++i)
     {
         const ResultItem &resultItem = manager.getItem(ids.get(i));
-        for (StringMap::const_iterator it=resultItem.attributes.begin(); it != resultItem.attributes.end(); ++it)
+        for (AttributeSetRef::const_iterator it=resultItem.attributes.begin(); it != resultItem.attributes.end(); ++it)
         {
-            const char *nameStr = it->first.c_str();
-            const char *valueStr = it->second.c_str();
+            const char *nameStr = it->nameRef->c_str();
+            const char *valueStr = it->valueRef->c_str();
             SET_STRING_ELT(types, currentIndex, typeSEXP);
             INTEGER(keys)[currentIndex] = keyStart + i;
             SET_STRING_ELT(names, currentIndex, mkChar(nameStr));
@@ -265,10 +262,10 @@ SEXP exportDataset(ResultFileManager &manager, const IDList &idlist)
     {
         Run* run = runList->at(i);
         SEXP runidSexp = mkChar(run->runName.c_str());
-        for (StringMap::const_iterator it=run->attributes.begin(); it != run->attributes.end(); ++it)
+        for (AttributeSetRef::const_iterator it=run->attributes.begin(); it != run->attributes.end(); ++it)
         {
-            const char *nameStr = it->first.c_str();
-            const char *valueStr = it->second.c_str();
+            const char *nameStr = it->nameRef->c_str();
+            const char *valueStr = it->valueRef->c_str();
             SET_STRING_ELT(runid, index, runidSexp);
             SET_STRING_ELT(name, index, mkChar(nameStr));
             SET_STRING_ELT(value, index, mkChar(valueStr));
@@ -432,10 +429,10 @@ SEXP exportDataset(ResultFileManager &manager, const IDList &idlist)
     {
         Run* run = runList->at(i);
         SEXP runidSexp = mkChar(run->runName.c_str());
-        for (StringMap::const_iterator it=run->moduleParams.begin(); it != run->moduleParams.end(); ++it)
+        for (AttributeSetRef::const_iterator it=run->moduleParams.begin(); it != run->moduleParams.end(); ++it)
         {
-            const char *nameStr = it->first.c_str();
-            const char *valueStr = it->second.c_str();
+            const char *nameStr = it->nameRef->c_str();
+            const char *valueStr = it->valueRef->c_str();
             SET_STRING_ELT(runid, index, runidSexp);
             SET_STRING_ELT(name, index, mkChar(nameStr));
             SET_STRING_ELT(value, index, mkChar(valueStr));
@@ -463,10 +460,10 @@ SEXP exportDataset(ResultFileManager &manager, const IDList &idlist)
 
        Run* run = runList->at(i);
        SEXP runidSexp = mkChar(run->runName.c_str());
-       for (StringMap::const_iterator it=run->itervars.begin(); it != run->itervars.end(); ++it)
+       for (AttributeSetRef::const_iterator it=run->itervars.begin(); it != run->itervars.end(); ++it)
        {
-           const char *nameStr = it->first.c_str();
-           const char *valueStr = it->second.c_str();
+           const char *nameStr = it->nameRef->c_str();
+           const char *valueStr = it->valueRef->c_str();
            SET_STRING_ELT(runid, index, runidSexp);
            SET_STRING_ELT(name, index, mkChar(nameStr));
            SET_STRING_ELT(value, index, mkChar(valueStr));
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <vector>
+
+#include "xyarray.h"
+#include "nodetype.h"
+#include "nodetyperegistry.h"
+#include "dataflowmanager.h"
+#include "arraybuilder.h"
+#include "sharedmemoryreader.h"
+
+#include <R.h>
+#include <Rdefines.h>
+#include <Rinternals.h>
+#undef length
+
+#include "util.h"
+#include "loadSharedMemoryVectors.h"
+
+static const char* resultColumnNames[] = {"vectordata", "lostsamples"};
+static const int resultColumnsLength = sizeof(resultColumnNames) / sizeof(const char*);
+
+static const char* vectordataColumnNames[] = {"vectorid", "x", "y"};
+static const SEXPTYPE vectordataColumnTypes[] = {INTSXP, REALSXP, REALSXP};
+static const int vectordataColumnsLength = sizeof(vectordataColumnNames) / sizeof(const char*);
+
+extern "C" {
+
+SEXP callLoadSharedMemoryVectors(SEXP name, SEXP vectorIds, SEXP timeout)
+{
+    try
+    {
+        // build the network: one array builder per vector
+        DataflowManager manager;
+        NodeTypeRegistry *registry = NodeTypeRegistry::getInstance();
+        NodeType *readerType = registry->getNodeType("sharedmemoryreader");
+        NodeType *arrayBuilderType = registry->getNodeType("arraybuilder");
+        StringMap attrs;
+        attrs["name"] = CHAR(STRING_ELT(name, 0));
+        attrs["timeout"] = CHAR(STRING_ELT(AS_CHARACTER(timeout), 0));
+        SharedMemoryReaderNode *reader = (SharedMemoryReaderNode *)readerType->create(&manager, attrs);
+
+        int vectorCount = Rf_length(vectorIds);
+        std::vector<ArrayBuilderNode*> arrayBuilders;
+        for (int i = 0; i < vectorCount; ++i)
+        {
+            char portName[32];
+            sprintf(portName, "%d", INTEGER(vectorIds)[i]);
+            StringMap noAttrs;
+            Node *arrayBuilder = arrayBuilderType->create(&manager, noAttrs);
+            manager.connect(readerType->getPort(reader, portName), arrayBuilderType->getPort(arrayBuilder, "in"));
+            arrayBuilders.push_back((ArrayBuilderNode *)arrayBuilder);
+        }
+
+        // run! (until the writer finishes, or the timeout expires)
+        manager.execute();
+
+        std::vector<XYArray*> arrays;
+        int vectordataCount = 0;
+        for (int i = 0; i < vectorCount; ++i)
+        {
+            arrays.push_back(arrayBuilders[i]->getArray());
+            vectordataCount += arrays[i]->length();
+        }
+
+        SEXP result;
+        PROTECT(result = NEW_LIST(2));
+        setNames(result, resultColumnNames, resultColumnsLength);
+
+        SEXP vectordata = createDataFrame(vectordataColumnNames, vectordataColumnTypes, vectordataColumnsLength, vectordataCount);
+        SEXP vectorid = VECTOR_ELT(vectordata, 0);
+        SEXP x = VECTOR_ELT(vectordata, 1);
+        SEXP y = VECTOR_ELT(vectordata, 2);
+        SET_ELEMENT(result, 0, vectordata);
+        UNPROTECT(1); // vectordata
+        int currentIndex = 0;
+        for (int i = 0; i < vectorCount; ++i)
+        {
+            XYArray *array = arrays[i];
+            int arrayLen = array->length();
+            for (int j = 0; j < arrayLen; ++j)
+            {
+                INTEGER(vectorid)[currentIndex] = INTEGER(vectorIds)[i];
+                REAL(x)[currentIndex] = array->getX(j);
+                REAL(y)[currentIndex] = array->getY(j);
+                currentIndex++;
+            }
+            delete array;
+        }
+
+        SET_ELEMENT(result, 1, ScalarReal((double)reader->getNumLostSamples()));
+
+        UNPROTECT(1); // result
+        return result;
+    }
+    catch (opp_runtime_error &e)
+    {
+        error("Error in callLoadSharedMemoryVectors: %s\n", e.what());
+        return R_NilValue;
+    }
+}
+
+} // extern "C"
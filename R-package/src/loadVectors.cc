@@ -29,6 +29,7 @@
 
 #include <iostream>
 #include <map>
+#include <pthread.h>
 
 #include "xyarray.h"
 #include "resultfilemanager.h"
@@ -38,6 +39,7 @@
 #include "vectorfilereader.h"
 #include "arraybuilder.h"
 #include "dataflownetworkbuilder.h"
+#include "scaveutils.h"
 
 #include <R.h>
 #include <Rdefines.h>
@@ -124,6 +126,145 @@ static ProcessingOperationList parseProcessingOperations(SEXP commands)
     return operations;
 }
 
+// the vectors of one file, processed by a separate dataflow network
+struct FileNetwork
+{
+    std::vector<int> positions;  // of the vectors in the input
+    IDList idlist;
+    DataflowNetworkBuilder *builder;
+    std::string error;           // set if the execution failed
+
+    FileNetwork() : builder(NULL) {}
+    ~FileNetwork() { delete builder; }
+};
+
+typedef std::vector<FileNetwork*> FileNetworks;
+
+struct ParallelExecution
+{
+    FileNetworks networks;
+    size_t next;                 // the next network to be executed
+    pthread_mutex_t mutex;       // protects "next"
+};
+
+static void *executeNetworks(void *arg)
+{
+    ParallelExecution *execution = (ParallelExecution *)arg;
+    while (true)
+    {
+        pthread_mutex_lock(&execution->mutex);
+        size_t i = execution->next++;
+        pthread_mutex_unlock(&execution->mutex);
+        if (i >= execution->networks.size())
+            return NULL;
+
+        FileNetwork *network = execution->networks[i];
+        try
+        {
+            network->builder->getDataflowManager()->execute();
+        }
+        catch (std::exception &e)
+        {
+            network->error = e.what();
+        }
+    }
+}
+
+static void deleteNetworks(FileNetworks &networks)
+{
+    for (FileNetworks::iterator it = networks.begin(); it != networks.end(); ++it)
+        delete *it;
+    networks.clear();
+}
+
+// Unless there are "compute" operations, the vectors are processed independently,
+// so the vectors of each file (e.g. each shard of a run) can be read and processed
+// by a separate dataflow network, in parallel with the others.
+static Vectors executeInParallel(const IDList &idlist, const ProcessingOperationList &processing, ResultFileManager &manager)
+{
+    ParallelExecution execution;
+    execution.next = 0;
+
+    // group vectors by file
+    std::map<ResultFile*, FileNetwork*> networkOfFile;
+    int count = idlist.size();
+    for (int i = 0; i < count; i++)
+    {
+        ID id = idlist.get(i);
+        FileNetwork *&network = networkOfFile[manager.getVector(id).fileRunRef->fileRef];
+        if (!network)
+        {
+            network = new FileNetwork();
+            execution.networks.push_back(network);
+        }
+        network->positions.push_back(i);
+        network->idlist.add(id);
+    }
+
+    // building the networks accesses the manager, so it is done here
+    try
+    {
+        for (FileNetworks::iterator it = execution.networks.begin(); it != execution.networks.end(); ++it)
+        {
+            FileNetwork *network = *it;
+            network->builder = new DataflowNetworkBuilder(manager);
+            network->builder->build(network->idlist, processing);
+        }
+    }
+    catch (...)
+    {
+        deleteNetworks(execution.networks);
+        throw;
+    }
+
+    // run! (this thread is one of the workers)
+    int numThreads = getNumCPUs();
+    if (numThreads > (int)execution.networks.size())
+        numThreads = execution.networks.size();
+    pthread_mutex_init(&execution.mutex, NULL);
+    std::vector<pthread_t> threads;
+    for (int i = 1; i < numThreads; i++)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, executeNetworks, &execution) != 0)
+            break;  // make do with the threads we have
+        threads.push_back(thread);
+    }
+    executeNetworks(&execution);
+    for (size_t i = 0; i < threads.size(); i++)
+        pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&execution.mutex);
+
+    for (FileNetworks::iterator it = execution.networks.begin(); it != execution.networks.end(); ++it)
+    {
+        if (!(*it)->error.empty())
+        {
+            std::string error = (*it)->error;
+            deleteNetworks(execution.networks);
+            throw opp_runtime_error("%s", error.c_str());
+        }
+    }
+
+    // copy data from nodes, in the order of the input
+    Vectors vs(count);
+    for (FileNetworks::iterator it = execution.networks.begin(); it != execution.networks.end(); ++it)
+    {
+        FileNetwork *network = *it;
+        IDList outputIDs = network->builder->getOutputIDs();
+        ArrayBuilderNodes arrayBuilders = network->builder->getArrayBuilderNodes();
+        Assert(outputIDs.size() == (int)network->positions.size());
+        for (int j = 0; j < (int)network->positions.size(); j++)
+        {
+            IDAndArray &vectordata = vs[network->positions[j]];
+            vectordata.id = outputIDs.get(j);
+            vectordata.array = arrayBuilders[j]->getArray();
+        }
+    }
+    deleteNetworks(execution.networks);
+
+    return vs;
+}
+
 static Vectors loadVectors(SEXP vectors, SEXP commands, ResultFileManager &manager)
 {
     Vectors vs;
@@ -164,9 +305,19 @@ static Vectors loadVectors(SEXP vectors, SEXP commands, ResultFileManager &manag
         idlist.add(id);
     }
 
+    ProcessingOperationList processing = parseProcessingOperations(commands);
+    bool independent = true;
+    for (ProcessingOperationList::iterator it = processing.begin(); it != processing.end(); ++it)
+        if (it->type == Compute)
+            independent = false;
+    ResultFileList *files = manager.getUniqueFiles(idlist);
+    int numFiles = files->size();
+    delete files;
+    if (independent && numFiles > 1)
+        return executeInParallel(idlist, processing, manager);
+
     // build dataflow network
     DataflowNetworkBuilder builder(manager);
-    ProcessingOperationList processing = parseProcessingOperations(commands);
     builder.build(idlist, processing);
     IDList outputIDs = builder.getOutputIDs();
     ArrayBuilderNodes arrayBuilders = builder.getArrayBuilderNodes();
@@ -273,10 +424,10 @@ static SEXP exportVectors(const ResultFileManager &manager, const Vectors &vecs)
         const VectorResult &vector = manager.getVector(vecs[i].id);
         if (!vector.isComputed())
         {
-            for (StringMap::const_iterator it=vector.attributes.begin(); it != vector.attributes.end(); ++it)
+            for (AttributeSetRef::const_iterator it=vector.attributes.begin(); it != vector.attributes.end(); ++it)
             {
-                const char *nameStr = it->first.c_str();
-                const char *valueStr = it->second.c_str();
+                const char *nameStr = it->nameRef->c_str();
+                const char *valueStr = it->valueRef->c_str();
                 INTEGER(keys)[currentIndex] = i;
                 SET_STRING_ELT(names, currentIndex, mkChar(nameStr));
                 SET_STRING_ELT(values, currentIndex, mkChar(valueStr));
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include "attributeset.h"
+
+USING_NAMESPACE
+
+static const AttributeSet::Attributes emptyAttributes;
+
+// FNV-1a over the characters of the string and a terminating zero
+static size_t hashString(size_t hash, const std::string& str)
+{
+    for (const char *s = str.c_str(); ; s++)
+    {
+        hash = (hash ^ (unsigned char)*s) * 16777619;
+        if (!*s)
+            return hash;
+    }
+}
+
+static size_t hashOf(const AttributeSet::Attributes& attributes)
+{
+    size_t hash = 2166136261u;
+    for (AttributeSet::const_iterator it = attributes.begin(); it != attributes.end(); ++it)
+        hash = hashString(hashString(hash, *it->nameRef), *it->valueRef);
+    return hash;
+}
+
+static size_t hashOf(const StringMap& attributes)
+{
+    size_t hash = 2166136261u;
+    for (StringMap::const_iterator it = attributes.begin(); it != attributes.end(); ++it)
+        hash = hashString(hashString(hash, it->first), it->second);
+    return hash;
+}
+
+// names and values of the same pool are compared by address
+static bool equals(const AttributeSet::Attributes& a, const AttributeSet::Attributes& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (int i = 0; i < (int)a.size(); i++)
+        if (a[i].nameRef != b[i].nameRef || a[i].valueRef != b[i].valueRef)
+            return false;
+    return true;
+}
+
+static bool equals(const AttributeSet::Attributes& a, const StringMap& b)
+{
+    if (a.size() != b.size())
+        return false;
+    StringMap::const_iterator it = b.begin();
+    for (int i = 0; i < (int)a.size(); i++, ++it)
+        if (*a[i].nameRef != it->first || *a[i].valueRef != it->second)
+            return false;
+    return true;
+}
+
+const char *AttributeSet::get(const char *name) const
+{
+    int lo = 0, hi = attributes.size();
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp(attributes[mid].nameRef->c_str(), name);
+        if (cmp == 0)
+            return attributes[mid].valueRef->c_str();
+        else if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
+void AttributeSet::release()
+{
+    if (pool)
+        pool->remove(this);
+    delete this;
+}
+
+AttributeSetRef::const_iterator AttributeSetRef::begin() const
+{
+    return set ? set->begin() : emptyAttributes.begin();
+}
+
+AttributeSetRef::const_iterator AttributeSetRef::end() const
+{
+    return set ? set->end() : emptyAttributes.end();
+}
+
+StringMap AttributeSetRef::toStringMap() const
+{
+    StringMap result;
+    for (const_iterator it = begin(); it != end(); ++it)
+        result.insert(result.end(), std::make_pair(*it->nameRef, *it->valueRef));
+    return result;
+}
+
+AttributeSetPool::~AttributeSetPool()
+{
+    // sets still referenced (e.g. from copies of result items) are freed by their last reference
+    for (SetMap::iterator it = sets.begin(); it != sets.end(); ++it)
+        it->second->pool = NULL;
+}
+
+AttributeSetRef AttributeSetPool::intern(const AttributeSet::Attributes& attributes)
+{
+    if (attributes.empty())
+        return AttributeSetRef();
+
+    size_t hash = hashOf(attributes);
+    std::pair<SetMap::iterator, SetMap::iterator> range = sets.equal_range(hash);
+    for (SetMap::iterator it = range.first; it != range.second; ++it)
+        if (equals(it->second->attributes, attributes))
+            return AttributeSetRef(it->second);
+
+    AttributeSet *set = new AttributeSet(this, attributes, hash);
+    sets.insert(range.second, std::make_pair(hash, set));
+    return AttributeSetRef(set);
+}
+
+void AttributeSetPool::remove(AttributeSet *set)
+{
+    std::pair<SetMap::iterator, SetMap::iterator> range = sets.equal_range(set->hash);
+    for (SetMap::iterator it = range.first; it != range.second; ++it)
+    {
+        if (it->second == set)
+        {
+            sets.erase(it);
+            return;
+        }
+    }
+}
+
+AttributeSetRef AttributeSetPool::get(const StringMap& attributes)
+{
+    if (attributes.empty())
+        return AttributeSetRef();
+
+    size_t hash = hashOf(attributes);
+    std::pair<SetMap::iterator, SetMap::iterator> range = sets.equal_range(hash);
+    for (SetMap::iterator it = range.first; it != range.second; ++it)
+        if (equals(it->second->attributes, attributes))
+            return AttributeSetRef(it->second);
+
+    scratch.clear();
+    for (StringMap::const_iterator it = attributes.begin(); it != attributes.end(); ++it)
+    {
+        AttributeSet::Attribute attr;
+        attr.nameRef = strings.insert(it->first);
+        attr.valueRef = strings.insert(it->second);
+        scratch.push_back(attr);
+    }
+    AttributeSet *set = new AttributeSet(this, scratch, hash);
+    sets.insert(range.second, std::make_pair(hash, set));
+    return AttributeSetRef(set);
+}
+
+AttributeSetRef AttributeSetPool::get(const AttributeSetRef& set)
+{
+    if (set.empty() || set.getSet()->pool == this)
+        return set;
+
+    scratch.clear();
+    for (AttributeSetRef::const_iterator it = set.begin(); it != set.end(); ++it)
+    {
+        AttributeSet::Attribute attr;
+        attr.nameRef = strings.insert(*it->nameRef);
+        attr.valueRef = strings.insert(*it->valueRef);
+        scratch.push_back(attr);
+    }
+    return intern(scratch);
+}
+
+AttributeSetRef AttributeSetPool::merge(const AttributeSetRef& set, const StringMap& attributes)
+{
+    if (attributes.empty())
+        return get(set);
+    if (set.empty())
+        return get(attributes);
+
+    // both are sorted by name: merge them, values in "attributes" win
+    bool pooled = set.empty() || set.getSet()->pool == this;
+    scratch.clear();
+    AttributeSetRef::const_iterator it1 = set.begin(), end1 = set.end();
+    StringMap::const_iterator it2 = attributes.begin(), end2 = attributes.end();
+    while (it1 != end1 || it2 != end2)
+    {
+        AttributeSet::Attribute attr;
+        int cmp = it1 == end1 ? 1 : it2 == end2 ? -1 : it1->nameRef->compare(it2->first);
+        if (cmp < 0)
+        {
+            attr.nameRef = pooled ? it1->nameRef : strings.insert(*it1->nameRef);
+            attr.valueRef = pooled ? it1->valueRef : strings.insert(*it1->valueRef);
+            ++it1;
+        }
+        else
+        {
+            attr.nameRef = strings.insert(it2->first);
+            attr.valueRef = strings.insert(it2->second);
+            if (cmp == 0)
+                ++it1;
+            ++it2;
+        }
+        scratch.push_back(attr);
+    }
+    return intern(scratch);
+}
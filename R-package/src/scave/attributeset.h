@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ATTRIBUTESET_H_
+#define _ATTRIBUTESET_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include "scavedefs.h"
+#include "scaveutils.h"
+
+NAMESPACE_BEGIN
+
+class AttributeSetPool;
+
+typedef std::map<std::string, std::string> StringMap;
+
+/**
+ * An immutable set of name/value pairs: the attributes of a result item,
+ * or the attributes, iteration variables or module parameters of a run.
+ * Sets are interned by an AttributeSetPool, so equal sets are stored only
+ * once, and are shared by all result items and runs that have them.
+ * Names and values point into the string pool of the AttributeSetPool.
+ *
+ * Sets are only accessed via AttributeSetRef, which maintains the reference
+ * count of the set.
+ */
+class SCAVE_API AttributeSet
+{
+    friend class AttributeSetPool;
+    friend class AttributeSetRef;
+  public:
+    struct Attribute
+    {
+        const std::string *nameRef;
+        const std::string *valueRef;
+    };
+    typedef std::vector<Attribute> Attributes;
+    typedef Attributes::const_iterator const_iterator;
+
+  private:
+    AttributeSetPool *pool; // NULL after the pool has been deleted
+    int refCount;
+    size_t hash;
+    Attributes attributes; // sorted by name, like StringMap
+
+  private:
+    AttributeSet(AttributeSetPool *pool, const Attributes& attributes, size_t hash)
+        : pool(pool), refCount(0), hash(hash), attributes(attributes) {}
+    void release();
+
+  public:
+    const_iterator begin() const { return attributes.begin(); }
+    const_iterator end() const { return attributes.end(); }
+    int size() const { return attributes.size(); }
+    const char *get(const char *name) const;
+};
+
+/**
+ * Reference-counted pointer to an AttributeSet. The default-constructed
+ * reference stands for the empty set; otherwise it provides the (read-only)
+ * interface of the set. The set is freed when its last reference goes away.
+ *
+ * Reference counts are not atomic; like the rest of the result file manager's
+ * data, references must only be copied under its lock.
+ */
+class SCAVE_API AttributeSetRef
+{
+  private:
+    AttributeSet *set;
+
+  public:
+    typedef AttributeSet::const_iterator const_iterator;
+
+    AttributeSetRef() : set(NULL) {}
+    explicit AttributeSetRef(AttributeSet *set) : set(set) { if (set) set->refCount++; }
+    AttributeSetRef(const AttributeSetRef& other) : set(other.set) { if (set) set->refCount++; }
+    ~AttributeSetRef() { if (set && --set->refCount == 0) set->release(); }
+    AttributeSetRef& operator=(const AttributeSetRef& other);
+
+    /**
+     * Returns the set itself; it is NULL for the empty set. Equal sets of
+     * the same pool are the same object, so this identifies the contents.
+     */
+    const AttributeSet *getSet() const { return set; }
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    int size() const { return set ? set->size() : 0; }
+    bool empty() const { return set == NULL; }
+
+    /**
+     * Returns the value for the given name, or NULL if not present.
+     */
+    const char *get(const char *name) const { return set ? set->get(name) : NULL; }
+
+    StringMap toStringMap() const;
+};
+
+/**
+ * Interns attribute sets: returns the same AttributeSet for equal sets
+ * (hash-consing), and pools the strings of their names and values.
+ * Sets are hashed by content, so finding an existing set does not need
+ * the string pool. Sets that are no longer referenced are removed from
+ * the pool.
+ */
+class SCAVE_API AttributeSetPool
+{
+    friend class AttributeSet;
+  private:
+    typedef std::multimap<size_t, AttributeSet*> SetMap;
+    StringPool strings;
+    SetMap sets; // by hash
+    AttributeSet::Attributes scratch;
+
+  private:
+    AttributeSetRef intern(const AttributeSet::Attributes& attributes);
+    void remove(AttributeSet *set);
+
+  public:
+    AttributeSetPool() {}
+    ~AttributeSetPool();
+
+    /**
+     * Returns the set with the given contents.
+     */
+    AttributeSetRef get(const StringMap& attributes);
+
+    /**
+     * Returns the set of this pool with the same contents as the given set,
+     * which may belong to another pool.
+     */
+    AttributeSetRef get(const AttributeSetRef& set);
+
+    /**
+     * Returns the set that contains the attributes of both arguments;
+     * values in "attributes" override the ones in "set".
+     */
+    AttributeSetRef merge(const AttributeSetRef& set, const StringMap& attributes);
+
+    /**
+     * Returns the number of distinct sets in the pool.
+     */
+    int size() const { return sets.size(); }
+
+  private:
+    // not copyable: sets point back to the pool
+    AttributeSetPool(const AttributeSetPool&);
+    AttributeSetPool& operator=(const AttributeSetPool&);
+};
+
+inline AttributeSetRef& AttributeSetRef::operator=(const AttributeSetRef& other)
+{
+    if (other.set)
+        other.set->refCount++;
+    if (set && --set->refCount == 0)
+        set->release();
+    set = other.set;
+    return *this;
+}
+
+NAMESPACE_END
+
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <zlib.h>
+#include "platmisc.h"
+#include "exception.h"
+#include "binaryvectorfile.h"
+
+USING_NAMESPACE
+
+#define LL  INT64_PRINTF_FORMAT
+
+static inline unsigned int getUInt32(const unsigned char *p)
+{
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static inline double getDouble(const unsigned char *p)
+{
+    uint64 x = 0;
+    for (int i = 7; i >= 0; i--)
+        x = (x << 8) | p[i];
+    double d;
+    memcpy(&d, &x, sizeof(d));
+    return d;
+}
+
+bool BinaryVectorFileReader::isBinaryVectorFile(const char *fileName)
+{
+    FILE *f = fopen(fileName, "rb");
+    if (f == NULL)
+        return false;
+
+    char magic[8];
+    bool result = fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+                  memcmp(magic, BINARY_VECTOR_FILE_MAGIC, sizeof(magic)) == 0;
+    fclose(f);
+    return result;
+}
+
+BinaryVectorFileReader::BinaryVectorFileReader(const char *fileName)
+    : fileName(fileName), f(NULL), fileSize(0), compression(BINARY_VECTOR_COMPRESSION_NONE), count(0), numReadBytes(0)
+{
+}
+
+BinaryVectorFileReader::~BinaryVectorFileReader()
+{
+    if (f)
+        fclose(f);
+}
+
+void BinaryVectorFileReader::openFile()
+{
+    f = fopen(fileName.c_str(), "rb");
+    if (!f)
+        throw opp_runtime_error("Cannot open file `%s'", fileName.c_str());
+
+    unsigned char header[BINARY_VECTOR_FILE_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), f) != sizeof(header) ||
+            memcmp(header, BINARY_VECTOR_FILE_MAGIC, 8) != 0)
+        throw opp_runtime_error("`%s' is not a binary vector file", fileName.c_str());
+    unsigned int version = getUInt32(header+8);
+    if (version > BINARY_VECTOR_FILE_VERSION)
+        throw opp_runtime_error("Binary vector file `%s': expects version %d or lower", fileName.c_str(), BINARY_VECTOR_FILE_VERSION);
+    if (getUInt32(header+16) != BINARY_VECTOR_RECORD_SIZE || memcmp(header+20, "TV", 2) != 0)
+        throw opp_runtime_error("Binary vector file `%s': unsupported record layout", fileName.c_str());
+    compression = version >= 2 ? getUInt32(header+24) : BINARY_VECTOR_COMPRESSION_NONE;
+    if (compression != BINARY_VECTOR_COMPRESSION_NONE && compression != BINARY_VECTOR_COMPRESSION_ZLIB)
+        throw opp_runtime_error("Binary vector file `%s': unsupported compression method %d", fileName.c_str(), compression);
+    numReadBytes += sizeof(header);
+
+    // for checking the blocks in the index against it
+    if (opp_fseek(f, 0, SEEK_END) != 0 || (fileSize = opp_ftell(f)) < 0)
+        throw opp_runtime_error("Cannot determine the size of file `%s'", fileName.c_str());
+}
+
+long BinaryVectorFileReader::readBlock(const VectorData *vector, const Block *block)
+{
+    if (!f)
+        openFile();
+
+    count = 0;
+    if (block->size < BINARY_VECTOR_BLOCK_HEADER_SIZE)
+        throw opp_runtime_error("Binary vector file `%s': invalid block size at offset %" LL "d", fileName.c_str(), (int64)block->startOffset);
+    if (block->startOffset < BINARY_VECTOR_FILE_HEADER_SIZE || block->startOffset > fileSize || block->size > fileSize - block->startOffset)
+        throw opp_runtime_error("Binary vector file `%s': block at offset %" LL "d (size %" LL "d) is outside the file, the index may be out of date",
+                                fileName.c_str(), (int64)block->startOffset, (int64)block->size);
+
+    std::vector<unsigned char>& data = compression == BINARY_VECTOR_COMPRESSION_NONE ? buffer : compressedBuffer;
+    data.resize(block->size);
+    if (opp_fseek(f, block->startOffset, SEEK_SET) != 0)
+        throw opp_runtime_error("Cannot seek in file `%s'", fileName.c_str());
+    if (fread(&data[0], 1, block->size, f) != (size_t)block->size)
+        throw opp_runtime_error("Read error in file `%s' at offset %" LL "d", fileName.c_str(), (int64)block->startOffset);
+    numReadBytes += block->size;
+
+    unsigned int vectorId = getUInt32(&data[0]);
+    long n = getUInt32(&data[4]);
+    if ((int)vectorId != vector->vectorId)
+        throw opp_runtime_error("Binary vector file `%s': unexpected vector id at offset %" LL "d", fileName.c_str(), (int64)block->startOffset);
+    if (n != block->getCount() ||
+            (compression == BINARY_VECTOR_COMPRESSION_NONE && BINARY_VECTOR_BLOCK_HEADER_SIZE + n * BINARY_VECTOR_RECORD_SIZE != block->size))
+        throw opp_runtime_error("Binary vector file `%s': block size mismatch at offset %" LL "d", fileName.c_str(), (int64)block->startOffset);
+
+    if (compression != BINARY_VECTOR_COMPRESSION_NONE)
+        uncompressBlock(block, n);
+
+    count = n;
+    return count;
+}
+
+void BinaryVectorFileReader::uncompressBlock(const Block *block, long n)
+{
+    // inflate the shuffled columns
+    long numDoubles = 2 * n;
+    std::vector<unsigned char> shuffled(numDoubles * 8);
+    uLongf length = shuffled.size();
+    if (n > 0 && (uncompress(&shuffled[0], &length, &compressedBuffer[BINARY_VECTOR_BLOCK_HEADER_SIZE],
+                             compressedBuffer.size() - BINARY_VECTOR_BLOCK_HEADER_SIZE) != Z_OK || length != shuffled.size()))
+        throw opp_runtime_error("Binary vector file `%s': corrupt compressed block at offset %" LL "d", fileName.c_str(), (int64)block->startOffset);
+
+    // restore the (time, value) record layout of uncompressed blocks
+    buffer.resize(BINARY_VECTOR_BLOCK_HEADER_SIZE + n * BINARY_VECTOR_RECORD_SIZE);
+    memcpy(&buffer[0], &compressedBuffer[0], BINARY_VECTOR_BLOCK_HEADER_SIZE);
+    for (long j = 0; j < numDoubles; j++)
+    {
+        unsigned char *dest = &buffer[BINARY_VECTOR_BLOCK_HEADER_SIZE + (j < n ? j * BINARY_VECTOR_RECORD_SIZE : (j - n) * BINARY_VECTOR_RECORD_SIZE + 8)];
+        for (int k = 0; k < 8; k++)
+            dest[k] = shuffled[k * numDoubles + j];
+    }
+}
+
+double BinaryVectorFileReader::getTime(long i) const
+{
+    Assert(0 <= i && i < count);
+    return getDouble(&buffer[BINARY_VECTOR_BLOCK_HEADER_SIZE + i * BINARY_VECTOR_RECORD_SIZE]);
+}
+
+double BinaryVectorFileReader::getValue(long i) const
+{
+    Assert(0 <= i && i < count);
+    return getDouble(&buffer[BINARY_VECTOR_BLOCK_HEADER_SIZE + i * BINARY_VECTOR_RECORD_SIZE + 8]);
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _BINARYVECTORFILE_H_
+#define _BINARYVECTORFILE_H_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "scavedefs.h"
+#include "indexfile.h"
+
+NAMESPACE_BEGIN
+
+// layout of binary vector files, must be kept consistent with the result writer library
+#define BINARY_VECTOR_FILE_MAGIC          "OMNETVEC"
+#define BINARY_VECTOR_FILE_VERSION        2  // version 1 files have no compression field
+#define BINARY_VECTOR_FILE_HEADER_SIZE    32
+#define BINARY_VECTOR_BLOCK_HEADER_SIZE   8
+#define BINARY_VECTOR_RECORD_SIZE         16
+
+// compression methods of data blocks
+#define BINARY_VECTOR_COMPRESSION_NONE    0
+#define BINARY_VECTOR_COMPRESSION_ZLIB    1
+
+/**
+ * Reads data blocks of binary vector files. Binary vector files contain
+ * no declarations, only a fixed size file header and (vectorId, count, records)
+ * blocks of little-endian (time, value) doubles; the vector declarations,
+ * run attributes and the block offsets are in the index file.
+ *
+ * In compressed files (version 2, with a compression method in the header),
+ * the records of each block are zlib-compressed separately, so that any block
+ * can be read without touching the others. Compressed blocks are stored
+ * column-wise (all times, then all values) and byte-shuffled (byte 0 of each
+ * double, then byte 1, etc.), which makes them compress much better.
+ *
+ * All functions throw opp_runtime_error on error.
+ */
+class SCAVE_API BinaryVectorFileReader
+{
+    private:
+        std::string fileName;
+        FILE *f;
+        file_offset_t fileSize;
+        int compression;                   // compression method of the data blocks
+        std::vector<unsigned char> buffer; // contents of the last read block, uncompressed
+        std::vector<unsigned char> compressedBuffer;
+        long count;                        // number of records in buffer
+        int64 numReadBytes;
+
+    public:
+        /**
+         * Returns true if the file starts with the binary vector file magic.
+         */
+        static bool isBinaryVectorFile(const char *fileName);
+
+        BinaryVectorFileReader(const char *fileName);
+        ~BinaryVectorFileReader();
+
+        /**
+         * Reads the given block of the given vector into memory, and returns
+         * the number of records in it.
+         */
+        long readBlock(const VectorData *vector, const Block *block);
+
+        /**
+         * Returns the time of the ith record of the last read block.
+         */
+        double getTime(long i) const;
+
+        /**
+         * Returns the value of the ith record of the last read block.
+         */
+        double getValue(long i) const;
+
+        /**
+         * Returns the total number of bytes read in so far.
+         */
+        int64 getNumReadBytes() const { return numReadBytes; }
+
+    protected:
+        void openFile();
+        void uncompressBlock(const Block *block, long n);
+};
+
+NAMESPACE_END
+
+
+#endif
@@ -33,6 +33,8 @@
 #include "channel.h"
 #include "stringutil.h"
 #include "indexedvectorfile.h"
+#include "binaryvectorfile.h"
+#include "doubleformat.h"
 #include "scaveutils.h"
 
 USING_NAMESPACE
@@ -43,8 +45,10 @@ USING_NAMESPACE
 //=========================================================================
 
 IndexedVectorFileReader::IndexedVectorFileReader(const char *filename, int vectorId)
-    : fname(filename), index(NULL), vector(NULL), currentBlock(NULL)
+    : fname(filename), index(NULL), vector(NULL), currentBlock(NULL), binaryReader(NULL)
 {
+    binary = BinaryVectorFileReader::isBinaryVectorFile(filename);
+
     std::string ifname = IndexFile::getIndexFileName(filename);
     IndexFileReader indexReader(ifname.c_str());
     index = indexReader.readAll(); // XXX do not read whole index
@@ -59,6 +63,7 @@ IndexedVectorFileReader::~IndexedVectorFileReader()
 {
     if (index != NULL)
         delete index;
+    delete binaryReader;
 }
 
 // see filemgrs.h
@@ -84,6 +89,11 @@ void IndexedVectorFileReader::loadBlock(const Block &block)
         currentEntries.clear();
     }
 
+    if (binary) {
+        loadBinaryBlock(block);
+        return;
+    }
+
     size_t bufferSize = vector->blockSize;
     if (bufferSize < MIN_BUFFER_SIZE)
         bufferSize = MIN_BUFFER_SIZE;
@@ -130,6 +140,24 @@ void IndexedVectorFileReader::loadBlock(const Block &block)
     currentBlock = &block;
 }
 
+void IndexedVectorFileReader::loadBinaryBlock(const Block &block)
+{
+    if (!binaryReader)
+        binaryReader = new BinaryVectorFileReader(fname.c_str());
+    long count = binaryReader->readBlock(vector, &block);
+    currentEntries.resize(count);
+
+    for (long i=0; i<count; ++i)
+    {
+        OutputVectorEntry &entry = currentEntries[i];
+        entry.serial = block.startSerial+i;
+        entry.simtime = BigDecimal(binaryReader->getTime(i));
+        entry.value = binaryReader->getValue(i);
+    }
+
+    currentBlock = &block;
+}
+
 OutputVectorEntry *IndexedVectorFileReader::getEntryBySerial(long serial)
 {
     if (serial<0 || serial>=vector->getCount())
@@ -261,7 +289,7 @@ IndexedVectorFileWriterNode::IndexedVectorFileWriterNode(const char *fileName, c
 {
     f = NULL;
     indexWriter = NULL;
-    this->prec = DEFAULT_PRECISION;
+    this->prec = SHORTEST_PRECISION;
     this->fileHeader = (fileHeader ? fileHeader : "");
     this->fileName = fileName;
     this->indexFileName = indexFileName;
@@ -284,8 +312,8 @@ Port *IndexedVectorFileWriterNode::addVector(int vectorId, const char *module, c
 Port *IndexedVectorFileWriterNode::addVector(const VectorResult &vector)
 {
     VectorInputPort *inputport = new VectorInputPort(vector.vectorId, vector.moduleNameRef->c_str(), vector.nameRef->c_str(),
-                                            vector.columns.c_str(), blockSize, this);
-    inputport->vector.attributes = vector.attributes;
+                                            vector.columnsRef->c_str(), blockSize, this);
+    inputport->vector.attributes = vector.attributes.toStringMap();
     ports.push_back(inputport);
     return inputport;
 }
@@ -386,6 +414,7 @@ void IndexedVectorFileWriterNode::writeRecordsToBuffer(VectorInputPort *port)
     int colno = columns.size();
     Datum a;
     char buf[64];
+    char xbuf[FORMATDOUBLE_BUFSIZE], ybuf[FORMATDOUBLE_BUFSIZE];
     char *endp;
 
     if (colno == 2 && columns[0] == 'T' && columns[1] == 'V')
@@ -396,9 +425,9 @@ void IndexedVectorFileWriterNode::writeRecordsToBuffer(VectorInputPort *port)
             if (port->bufferPtr - port->buffer >= port->bufferSize - 100)
                 writeBufferToFile(port);
             if (a.xp.isNil())
-                bufferPrintf(port, "%d\t%.*g\t%.*g\n", vectorId, prec, a.x, prec, a.y);
+                bufferPrintf(port, "%d\t%s\t%s\n", vectorId, opp_formatdouble(xbuf, a.x, prec, endp), opp_formatdouble(ybuf, a.y, prec, endp));
             else
-                bufferPrintf(port, "%d\t%s\t%.*g\n", vectorId, BigDecimal::ttoa(buf, a.xp, endp), prec, a.y);
+                bufferPrintf(port, "%d\t%s\t%s\n", vectorId, BigDecimal::ttoa(buf, a.xp, endp), opp_formatdouble(ybuf, a.y, prec, endp));
             port->bufferNumOfRecords++;
             port->vector.blocks.back().collect(-1, a.x, a.y);
         }
@@ -411,9 +440,9 @@ void IndexedVectorFileWriterNode::writeRecordsToBuffer(VectorInputPort *port)
             if (port->bufferPtr - port->buffer >= port->bufferSize - 100)
                 writeBufferToFile(port);
             if (a.xp.isNil())
-                bufferPrintf(port, "%d\t%"LL"d\t%.*g\t%.*g\n", vectorId, a.eventNumber, prec, a.x, prec, a.y);
+                bufferPrintf(port, "%d\t%"LL"d\t%s\t%s\n", vectorId, a.eventNumber, opp_formatdouble(xbuf, a.x, prec, endp), opp_formatdouble(ybuf, a.y, prec, endp));
             else
-                bufferPrintf(port, "%d\t%"LL"d\t%s\t%.*g\n", vectorId, a.eventNumber, BigDecimal::ttoa(buf, a.xp, endp), prec, a.y);
+                bufferPrintf(port, "%d\t%"LL"d\t%s\t%s\n", vectorId, a.eventNumber, BigDecimal::ttoa(buf, a.xp, endp), opp_formatdouble(ybuf, a.y, prec, endp));
             port->bufferNumOfRecords++;
             port->vector.blocks.back().collect(a.eventNumber, a.x, a.y);
         }
@@ -431,10 +460,10 @@ void IndexedVectorFileWriterNode::writeRecordsToBuffer(VectorInputPort *port)
                 {
                 case 'T':
                     if (a.xp.isNil())
-                        bufferPrintf(port,"%.*g", prec, a.x);
+                        bufferPrintf(port,"%s", opp_formatdouble(xbuf, a.x, prec, endp));
                     else
                         bufferPrintf(port,"%s", BigDecimal::ttoa(buf, a.xp, endp)); break;
-                case 'V': bufferPrintf(port,"%.*g", prec, a.y); break;
+                case 'V': bufferPrintf(port,"%s", opp_formatdouble(ybuf, a.y, prec, endp)); break;
                 case 'E': bufferPrintf(port,"%"LL"d", a.eventNumber); break;
                 default: throw opp_runtime_error("unknown column type: '%c'", columns[j]);
                 }
@@ -56,6 +56,8 @@ struct OutputVectorEntry {
 
 typedef std::vector<OutputVectorEntry> Entries;
 
+class BinaryVectorFileReader;
+
 /**
  * Vector file reader with random access.
  * Each instance reads one vector from a vector file.
@@ -68,6 +70,8 @@ class SCAVE_API IndexedVectorFileReader
     const VectorData *vector;     // index data of the read vector, points into index
     const Block *currentBlock;    // last loaded block, points into index
     Entries currentEntries; // entries of the loaded block
+    bool binary;            // true if the vector file is in binary format
+    BinaryVectorFileReader *binaryReader; // reads the blocks of binary files; opened on first use
 
     public:
         explicit IndexedVectorFileReader(const char* filename, int vectorId);
@@ -75,6 +79,8 @@ class SCAVE_API IndexedVectorFileReader
     protected:
         /** reads a block from the vector file */
         void loadBlock(const Block &block);
+        /** reads a block from a binary vector file */
+        void loadBinaryBlock(const Block &block);
     public:
         /**
          * Returns the number of entries in the vector.
@@ -40,9 +40,10 @@ using namespace std;
 #define LL  INT64_PRINTF_FORMAT
 
 IndexedVectorFileReaderNode::IndexedVectorFileReaderNode(const char *filename, size_t bufferSize) :
-  ReaderNode(filename, bufferSize), index(NULL), currentBlockIndex(0)
+  ReaderNode(filename, bufferSize), index(NULL), currentBlockIndex(0), binaryReader(NULL)
 {
-
+    // blocks of the selected vectors are scattered over the file
+    reader.setMemoryMapped(true, FileReader::RANDOM);
 }
 
 IndexedVectorFileReaderNode::~IndexedVectorFileReaderNode()
@@ -51,6 +52,7 @@ IndexedVectorFileReaderNode::~IndexedVectorFileReaderNode()
         delete index;
         index = NULL;
     }
+    delete binaryReader;
 }
 
 Port *IndexedVectorFileReaderNode::addVector(const VectorResult &vector)
@@ -97,6 +99,9 @@ void IndexedVectorFileReaderNode::readIndexFile()
     IndexFileReader reader(indexFileName.c_str());
     index = reader.readAll();
 
+    if (BinaryVectorFileReader::isBinaryVectorFile(fn))
+        binaryReader = new BinaryVectorFileReader(fn);
+
     for (VectorIdToPortMap::iterator it = ports.begin(); it != ports.end(); ++it)
     {
         int vectorId = it->first;
@@ -108,6 +113,8 @@ void IndexedVectorFileReaderNode::readIndexFile()
             throw opp_runtime_error("indexed vector file reader: vector %d not found, file %s",
                                         vectorId, indexFileName.c_str());
 
+        portData.decoder = getVectorLineDecoder(portData.vector->columns);
+
         Blocks &blocks = portData.vector->blocks;
         for (Blocks::iterator it = blocks.begin(); it != blocks.end(); ++it)
             blocksToRead.push_back(BlockAndPortData(&(*it), &portData));
@@ -122,6 +129,9 @@ long IndexedVectorFileReaderNode::readBlock(const Block *blockPtr, const PortDat
     assert(blockPtr);
     assert(portDataPtr->vector);
 
+    if (binaryReader)
+        return readBinaryBlock(blockPtr, portDataPtr);
+
     const char *file = filename.c_str();
     file_offset_t offset;
 #define CHECK(cond, msg) {if (!cond) throw opp_runtime_error(msg ", file %s, offset %"LL"d", file, (int64)offset); }
@@ -130,6 +140,7 @@ long IndexedVectorFileReaderNode::readBlock(const Block *blockPtr, const PortDat
     file_offset_t startOffset = blockPtr->startOffset;
     long count = blockPtr->getCount();
 
+    reader.prefetch(startOffset, blockPtr->size);
     reader.seekTo(startOffset);
 
     long readTime=0;
@@ -148,20 +159,27 @@ long IndexedVectorFileReaderNode::readBlock(const Block *blockPtr, const PortDat
 
         offset = reader.getCurrentLineStartOffset();
         int length = reader.getCurrentLineLength();
-        TIME(tokenizeTime, tokenizer.tokenize(line, length));
-
-        int numtokens = tokenizer.numTokens();
-        char **vec = tokenizer.tokens();
         int vectorId;
+        Datum a;
 
-        // check vector id
-        CHECK((numtokens >= 3) && opp_isdigit(vec[0][0]), "vector file reader: data line too short");
-        CHECK(parseInt(vec[0], vectorId), "invalid vector file syntax: invalid vector id column");
-        CHECK(vectorId == vector->vectorId, "vector file reader: unexpected vector id");
+        // decode the line directly from the buffer if possible;
+        // other lines are tokenized and parsed column by column
+        const char *columns = portDataPtr->decoder ? parseVectorId(line, line + length, vectorId) : NULL;
+        if (!columns || vectorId != vector->vectorId || !portDataPtr->decoder(columns, line + length, a))
+        {
+            TIME(tokenizeTime, tokenizer.tokenize(line, length));
 
-        // parse columns
-        Datum a;
-        TIME(parseTime, a = parseColumns(vec, numtokens, vector->columns, file, -1, offset));
+            int numtokens = tokenizer.numTokens();
+            char **vec = tokenizer.tokens();
+
+            // check vector id
+            CHECK((numtokens >= 3) && opp_isdigit(vec[0][0]), "vector file reader: data line too short");
+            CHECK(parseInt(vec[0], vectorId), "invalid vector file syntax: invalid vector id column");
+            CHECK(vectorId == vector->vectorId, "vector file reader: unexpected vector id");
+
+            // parse columns
+            TIME(parseTime, a = parseColumns(vec, numtokens, vector->columns, file, -1, offset));
+        }
 
         // write to port(s)
         for (PortVector::const_iterator port = portDataPtr->ports.begin(); port != portDataPtr->ports.end(); ++port)
@@ -174,6 +192,24 @@ long IndexedVectorFileReaderNode::readBlock(const Block *blockPtr, const PortDat
     return blockPtr->size;
 }
 
+long IndexedVectorFileReaderNode::readBinaryBlock(const Block *blockPtr, const PortData *portDataPtr)
+{
+    long count = binaryReader->readBlock(portDataPtr->vector, blockPtr);
+
+    for (long k = 0; k < count; ++k)
+    {
+        Datum a;
+        a.x = binaryReader->getTime(k);
+        a.y = binaryReader->getValue(k);
+
+        // write to port(s)
+        for (PortVector::const_iterator port = portDataPtr->ports.begin(); port != portDataPtr->ports.end(); ++port)
+            port->getChannel()->write(&a,1);
+    }
+
+    return blockPtr->size;
+}
+
 //-----
 
 const char *IndexedVectorFileReaderNodeType::getDescription() const
@@ -36,6 +36,8 @@
 #include "filereader.h"
 #include "linetokenizer.h"
 #include "indexfile.h"
+#include "binaryvectorfile.h"
+#include "vectorlinedecoder.h"
 #include "resultfilemanager.h"
 
 NAMESPACE_BEGIN
@@ -54,9 +56,10 @@ class SCAVE_API IndexedVectorFileReaderNode : public ReaderNode
     struct PortData
     {
         VectorData *vector;
+        VectorLineDecoder decoder; // NULL if the column layout has no specialized decoder
         PortVector ports;
 
-        PortData() : vector(NULL) {}
+        PortData() : vector(NULL), decoder(NULL) {}
     };
 
     struct BlockAndPortData
@@ -81,6 +84,7 @@ class SCAVE_API IndexedVectorFileReaderNode : public ReaderNode
         std::vector<BlockAndPortData> blocksToRead;
         unsigned int currentBlockIndex;
         LineTokenizer tokenizer;
+        BinaryVectorFileReader *binaryReader; // non-NULL if the vector file is binary
 
     public:
         IndexedVectorFileReaderNode(const char *filename, size_t bufferSize = VECFILEREADER_BUFSIZE);
@@ -95,6 +99,7 @@ class SCAVE_API IndexedVectorFileReaderNode : public ReaderNode
     private:
         void readIndexFile();
         long readBlock(const Block *blockPtr, const PortData *portDataPtr);
+        long readBinaryBlock(const Block *blockPtr, const PortData *portDataPtr);
 };
 
 
@@ -553,7 +553,7 @@ void IndexFileWriter::writeVectorAttributes(const VectorData &vector)
 
 void IndexFileWriter::writeBlock(const VectorData &vector, const Block &block)
 {
-    static char buff1[64], buff2[64];
+    static char buff1[64], buff2[64], buff3[64], buff4[64];
     char *e;
 
     if (block.getCount() > 0)
@@ -563,9 +563,12 @@ void IndexFileWriter::writeBlock(const VectorData &vector, const Block &block)
         if (vector.hasColumn('T')) { CHECK(fprintf(file, " %s %s",
                                                 BigDecimal::ttoa(buff1, block.startTime, e),
                                                 BigDecimal::ttoa(buff2, block.endTime, e))); }
-        if (vector.hasColumn('V')) { CHECK(fprintf(file, " %ld %.*g %.*g %.*g %.*g",
-                                                block.getCount(), precision, block.getMin(), precision, block.getMax(),
-                                                precision, block.getSum(), precision, block.getSumSqr())); }
+        if (vector.hasColumn('V')) { CHECK(fprintf(file, " %ld %s %s %s %s",
+                                                block.getCount(),
+                                                opp_formatdouble(buff1, block.getMin(), precision, e),
+                                                opp_formatdouble(buff2, block.getMax(), precision, e),
+                                                opp_formatdouble(buff3, block.getSum(), precision, e),
+                                                opp_formatdouble(buff4, block.getSumSqr(), precision, e))); }
         CHECK(fprintf(file, "\n"));
     }
 }
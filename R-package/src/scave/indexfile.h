@@ -34,6 +34,7 @@
 #include "platmisc.h"
 #include "scavedefs.h"
 #include "commonutil.h"
+#include "doubleformat.h"
 #include "statistics.h"
 
 NAMESPACE_BEGIN
@@ -310,7 +311,7 @@ class SCAVE_API IndexFileWriter
         /**
          * Creates a writer for the specified index file.
          */
-        IndexFileWriter(const char *filename, int precision=14);
+        IndexFileWriter(const char *filename, int precision=SHORTEST_PRECISION);
         /**
          * Deletes the writer. (Closes the index file first.)
          */
@@ -34,6 +34,7 @@
 #include "indexedvectorfile.h"
 #include "indexedvectorfilereader.h"
 #include "indexedvectorfilereader2.h"
+#include "sharedmemoryreader.h"
 #include "filewriter.h"
 #include "windowavg.h"
 #include "slidingwinavg.h"
@@ -77,6 +78,7 @@ NodeTypeRegistry::NodeTypeRegistry()
     add(new IndexedVectorFileWriterNodeType());
     add(new IndexedVectorFileReaderNodeType());
     add(new IndexedVectorFileReaderNode2Type());
+    add(new SharedMemoryReaderNodeType());
     add(new FileWriterNodeType());
     add(new MergerNodeType());
     add(new AggregatorNodeType());
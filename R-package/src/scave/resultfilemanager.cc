@@ -26,6 +26,7 @@
  */
 
 #include <stdlib.h>
+#include <limits.h>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -33,6 +34,7 @@
 #include <algorithm>
 #include <utility>
 #include <functional>
+#include <pthread.h>
 #include "opp_ctype.h"
 #include "platmisc.h"
 #include "matchexpression.h"
@@ -42,6 +44,7 @@
 #include "stringtokenizer.h"
 #include "filereader.h"
 #include "indexfile.h"
+#include "binaryvectorfile.h"
 #include "scaveutils.h"
 #include "scaveexception.h"
 #include "resultfilemanager.h"
@@ -61,35 +64,34 @@ USING_NAMESPACE
 
 ResultItem::Type ResultItem::getType() const
 {
-    StringMap::const_iterator it = attributes.find("type");
-    if (it == attributes.end())
+    const char *type = attributes.get("type");
+    if (type == NULL)
     {
-        if (attributes.find("enum") != attributes.end())
+        if (attributes.get("enum") != NULL)
             return TYPE_ENUM;
         else
             return TYPE_DOUBLE;
     }
     else
     {
-        const std::string &type = it->second;
-        if (type == "int")
+        if (strcmp(type, "int") == 0)
             return TYPE_INT;
-        else if (type == "double")
+        else if (strcmp(type, "double") == 0)
             return TYPE_DOUBLE;
-        else if (type == "enum")
+        else if (strcmp(type, "enum") == 0)
             return TYPE_ENUM;
         else
-            throw opp_runtime_error("Unknown type: %s", type.c_str());
+            throw opp_runtime_error("Unknown type: %s", type);
     }
 }
 
 EnumType* ResultItem::getEnum() const
 {
-    StringMap::const_iterator it = attributes.find("enum");
-    if (it != attributes.end())
+    const char *enumText = attributes.get("enum");
+    if (enumText != NULL)
     {
         EnumType *enumPtr = new EnumType();
-        enumPtr->parseFromString(it->second.c_str());
+        enumPtr->parseFromString(enumText);
         return enumPtr;
     }
     else
@@ -100,20 +102,19 @@ EnumType* ResultItem::getEnum() const
 
 InterpolationMode VectorResult::getInterpolationMode() const
 {
-    StringMap::const_iterator it = attributes.find("interpolationmode");
-    if (it != attributes.end())
+    const char *mode = attributes.get("interpolationmode");
+    if (mode != NULL)
     {
-        const std::string &mode = it->second;
-        if (mode == "none")
+        if (strcmp(mode, "none") == 0)
             return NONE;
-        else if (mode == "sample-hold")
+        else if (strcmp(mode, "sample-hold") == 0)
             return SAMPLE_HOLD;
-        else if (mode == "backward-sample-hold")
+        else if (strcmp(mode, "backward-sample-hold") == 0)
             return BACKWARD_SAMPLE_HOLD;
-        else if (mode == "linear")
+        else if (strcmp(mode, "linear") == 0)
             return LINEAR;
         else
-            throw opp_runtime_error("Unknown interpolation mode: %s", mode.c_str());
+            throw opp_runtime_error("Unknown interpolation mode: %s", mode);
     }
     else
     {
@@ -143,6 +144,7 @@ ResultFileManager::~ResultFileManager()
     moduleNames.clear();
     names.clear();
     classNames.clear();
+    vectorColumns.clear();
 }
 
 ResultFileList ResultFileManager::getFiles() const
@@ -250,16 +252,33 @@ StringSet *ResultFileManager::getUniqueNames(const IDList& ids) const
     return set;
 }
 
+// attribute sets are shared, so each distinct set only needs to be looked at once
+typedef std::set<const AttributeSet*> AttributeSetSet;
+
+static void collectNames(const AttributeSetRef& attributes, AttributeSetSet& seen, StringSet *names)
+{
+    if (!attributes.empty() && seen.insert(attributes.getSet()).second)
+        for (AttributeSetRef::const_iterator it = attributes.begin(); it != attributes.end(); ++it)
+            names->insert(*it->nameRef);
+}
+
+static void collectValue(const AttributeSetRef& attributes, const char *name, AttributeSetSet& seen, StringSet *values)
+{
+    if (!attributes.empty() && seen.insert(attributes.getSet()).second)
+    {
+        const char *value = attributes.get(name);
+        if (value != NULL)
+            values->insert(value);
+    }
+}
+
 StringSet *ResultFileManager::getUniqueAttributeNames(const IDList &ids) const
 {
     READER_MUTEX
     StringSet *set = new StringSet;
+    AttributeSetSet seen;
     for (int i=0; i<ids.size(); i++)
-    {
-        const StringMap &attributes = getItem(ids.get(i)).attributes;
-        for(StringMap::const_iterator it = attributes.begin(); it != attributes.end(); ++it)
-            set->insert(it->first);
-    }
+        collectNames(getItem(ids.get(i)).attributes, seen, set);
     return set;
 }
 
@@ -267,12 +286,9 @@ StringSet *ResultFileManager::getUniqueRunAttributeNames(const RunList *runList)
 {
     READER_MUTEX
     StringSet *set = new StringSet;
+    AttributeSetSet seen;
     for (RunList::const_iterator runRef = runList->begin(); runRef != runList->end(); ++runRef)
-    {
-        const StringMap &attributes = (*runRef)->attributes;
-        for(StringMap::const_iterator it = attributes.begin(); it != attributes.end(); ++it)
-            set->insert(it->first);
-    }
+        collectNames((*runRef)->attributes, seen, set);
     return set;
 }
 
@@ -280,12 +296,9 @@ StringSet *ResultFileManager::getUniqueModuleParamNames(const RunList *runList)
 {
     READER_MUTEX
     StringSet *set = new StringSet;
+    AttributeSetSet seen;
     for (RunList::const_iterator runRef = runList->begin(); runRef != runList->end(); ++runRef)
-    {
-        const StringMap &params = (*runRef)->moduleParams;
-        for(StringMap::const_iterator it = params.begin(); it != params.end(); ++it)
-            set->insert(it->first);
-    }
+        collectNames((*runRef)->moduleParams, seen, set);
     return set;
 }
 
@@ -293,12 +306,9 @@ StringSet *ResultFileManager::getUniqueAttributeValues(const IDList &ids, const
 {
     READER_MUTEX
     StringSet *values = new StringSet;
+    AttributeSetSet seen;
     for (int i = 0; i < ids.size(); ++i)
-    {
-        const char *value = getItem(ids.get(i)).getAttribute(attrName);
-        if (value != NULL)
-            values->insert(value);
-    }
+        collectValue(getItem(ids.get(i)).attributes, attrName, seen, values);
     return values;
 }
 
@@ -306,13 +316,9 @@ StringSet *ResultFileManager::getUniqueRunAttributeValues(const RunList& runList
 {
     READER_MUTEX
     StringSet *values = new StringSet;
+    AttributeSetSet seen;
     for (RunList::const_iterator runRef = runList.begin(); runRef != runList.end(); ++runRef)
-    {
-        const char *value = (*runRef)->getAttribute(attrName);
-        if (value!=NULL)
-            values->insert(value);
-    }
-
+        collectValue((*runRef)->attributes, attrName, seen, values);
     return values;
 }
 
@@ -320,13 +326,9 @@ StringSet *ResultFileManager::getUniqueModuleParamValues(const RunList& runList,
 {
     READER_MUTEX
     StringSet *values = new StringSet;
+    AttributeSetSet seen;
     for (RunList::const_iterator runRef = runList.begin(); runRef != runList.end(); ++runRef)
-    {
-        const char *value = (*runRef)->getModuleParam(paramName);
-        if (value != NULL)
-            values->insert(value);
-    }
-
+        collectValue((*runRef)->moduleParams, paramName, seen, values);
     return values;
 }
 
@@ -454,10 +456,8 @@ ResultFile *ResultFileManager::getFile(const char *fileName) const
         return NULL;
 
     READER_MUTEX
-    for (int i=0; i<(int)fileList.size(); i++)
-        if (fileList[i]!=NULL && fileList[i]->filePath==fileName)
-            return fileList[i];
-    return NULL;
+    FileIndex::const_iterator it = fileIndex.find(fileName);
+    return it != fileIndex.end() ? it->second : NULL;
 }
 
 Run *ResultFileManager::getRunByName(const char *runName) const
@@ -466,19 +466,15 @@ Run *ResultFileManager::getRunByName(const char *runName) const
         return NULL;
 
     READER_MUTEX
-    for (int i=0; i<(int)runList.size(); i++)
-        if (runList[i]->runName==runName)
-            return runList[i];
-    return NULL;
+    RunIndex::const_iterator it = runIndex.find(runName);
+    return it != runIndex.end() ? it->second : NULL;
 }
 
 FileRun *ResultFileManager::getFileRun(ResultFile *file, Run *run) const
 {
     READER_MUTEX
-    for (int i=0; i<(int)fileRunList.size(); i++)
-        if (fileRunList[i]->fileRef==file && fileRunList[i]->runRef==run)
-            return fileRunList[i];
-    return NULL;
+    FileRunIndex::const_iterator it = fileRunIndex.find(std::make_pair(file, run));
+    return it != fileRunIndex.end() ? it->second : NULL;
 }
 
 // currently unused
@@ -530,12 +526,16 @@ ID ResultFileManager::getVectorById(const ResultFile *fileRef, int vectorId) con
 
     READER_MUTEX
 
-    const VectorResults& vectorResults = fileRef->vectorResults;
-    for (int i=0; i<(int)vectorResults.size(); i++)
+    VectorIdIndex::const_iterator it = vectorIdIndex.find(std::make_pair(fileRef->id, vectorId));
+    if (it != vectorIdIndex.end())
+        return _mkID(fileRef->vectorResults[it->second].isComputed(), false, VECTOR, fileRef->id, it->second);
+
+    // vector ids are unique within the run, so at most one shard has it
+    for (int i=0; i<(int)fileRef->shardIds.size(); i++)
     {
-        const VectorResult& vector = vectorResults[i];
-        if (vector.vectorId == vectorId)
-            return _mkID(vector.isComputed(), false, VECTOR, fileRef->id, i);
+        ID id = getVectorById(fileList[fileRef->shardIds[i]], vectorId);
+        if (id)
+            return id;
     }
 
     return 0;
@@ -779,15 +779,18 @@ ResultFile *ResultFileManager::addFile(const char *fileName, const char *fileSys
     file->computed = computed;
     file->numLines = 0;
     file->numUnrecognizedLines = 0;
+    fileIndex.insert(std::make_pair(file->filePath, file));
     return file;
 }
 
-Run *ResultFileManager::addRun()
+Run *ResultFileManager::addRun(const std::string& runName)
 {
     Run *run = new Run();
+    run->runName = runName;
     run->resultFileManager = this;
     run->runNumber = 0;
     runList.push_back(run);
+    runIndex.insert(std::make_pair(runName, run));
     return run;
 }
 
@@ -797,6 +800,7 @@ FileRun *ResultFileManager::addFileRun(ResultFile *file, Run *run)
     fileRunList.push_back(fileRun);
     fileRun->fileRef = file;
     fileRun->runRef = run;
+    fileRunIndex.insert(std::make_pair(std::make_pair(file, run), fileRun));
     return fileRun;
 }
 
@@ -823,18 +827,25 @@ int ResultFileManager::addVector(FileRun *fileRunRef, int vectorId, const char *
     vector.vectorId = vectorId;
     vector.moduleNameRef = moduleNames.insert(moduleName);
     vector.nameRef = names.insert(vectorName);
-    vector.columns = columns;
+    vector.columnsRef = vectorColumns.insert(columns);
     vector.stat = Statistics(-1, NaN, NaN, NaN, NaN);
-    VectorResults &vectors = fileRunRef->fileRef->vectorResults;
+    return addVectorResult(fileRunRef->fileRef, vector);
+}
+
+int ResultFileManager::addVectorResult(ResultFile *fileRef, const VectorResult& vector)
+{
+    VectorResults &vectors = fileRef->vectorResults;
     vectors.push_back(vector);
-    return vectors.size() - 1;
+    int pos = vectors.size() - 1;
+    vectorIdIndex.insert(std::make_pair(std::make_pair(fileRef->id, vector.vectorId), pos));  // first one wins
+    return pos;
 }
 
 int ResultFileManager::addHistogram(FileRun *fileRunRef, const char *moduleName, const char *histogramName,
         Statistics stat, const StringMap &attrs, const HistogramFields &fields)
 {
     HistogramResult histogram;
-    histogram.attributes = attrs;
+    histogram.attributes = attributeSets.get(attrs);
     histogram.fields = fields;
     histogram.fileRunRef = fileRunRef;
     histogram.moduleNameRef = moduleNames.insert(moduleName);
@@ -867,14 +878,14 @@ ID ResultFileManager::addComputedVector(int vectorId, const char *name, const ch
     VectorResult newVector = VectorResult();
     newVector.vectorId = vectorId;
     newVector.computation = computation;
-    newVector.columns = vector.columns;
+    newVector.columnsRef = vector.columnsRef;
     newVector.moduleNameRef = vector.moduleNameRef;
     newVector.nameRef = names.insert(name);
     newVector.fileRunRef = fileRunRef;
-    newVector.attributes = attributes;
+    newVector.attributes = attributeSets.get(attributes);
     newVector.stat = Statistics(-1, NaN, NaN, NaN, NaN);
-    fileRef->vectorResults.push_back(newVector);
-    ID id = _mkID(true, false, VECTOR, fileRef->id, fileRef->vectorResults.size()-1);
+    int pos = addVectorResult(fileRef, newVector);
+    ID id = _mkID(true, false, VECTOR, fileRef->id, pos);
     std::pair<ComputationID, ID> key = std::make_pair(computationID, input);
     computedIDCache[key] = id;
     return id;
@@ -919,6 +930,35 @@ void ResultFileManager::dump(ResultFile *fileRef, std::ostream& out) const
 #define CHECK(cond,msg) if (!(cond)) throw ResultFileFormatException(msg, ctx.fileName, ctx.lineNo);
 
 
+// value of an attribute read from the file: the one not yet flushed if any, otherwise the stored one
+static const char *getPendingValue(const StringMap& pending, const AttributeSetRef& attributes, const std::string& name)
+{
+    StringMap::const_iterator it = pending.find(name);
+    return it != pending.end() ? it->second.c_str() : attributes.get(name.c_str());
+}
+
+void ResultFileManager::flushAttributes(sParseContext &ctx)
+{
+    if (ctx.attributesRef)
+    {
+        *ctx.attributesRef = attributeSets.merge(*ctx.attributesRef, ctx.attributes);
+        ctx.attributesRef = NULL;
+        ctx.attributes.clear();
+    }
+    if (!ctx.itervars.empty())
+    {
+        Run *runRef = ctx.fileRunRef->runRef;
+        runRef->itervars = attributeSets.merge(runRef->itervars, ctx.itervars);
+        ctx.itervars.clear();
+    }
+    if (!ctx.moduleParams.empty())
+    {
+        Run *runRef = ctx.fileRunRef->runRef;
+        runRef->moduleParams = attributeSets.merge(runRef->moduleParams, ctx.moduleParams);
+        ctx.moduleParams.clear();
+    }
+}
+
 void ResultFileManager::processLine(char **vec, int numTokens, sParseContext &ctx)
 {
     ++ctx.lineNo;
@@ -927,6 +967,11 @@ void ResultFileManager::processLine(char **vec, int numTokens, sParseContext &ct
     if (numTokens==0 || vec[0][0]=='#')
         return;
 
+    // attributes belong to the run or result item above them; store them when another kind of line comes
+    if (ctx.attributesRef || !ctx.itervars.empty() || !ctx.moduleParams.empty())
+        if (strcmp(vec[0], "attr") != 0 && strcmp(vec[0], "itervar") != 0 && strcmp(vec[0], "param") != 0)
+            flushAttributes(ctx);
+
     // process "run" lines
     if (vec[0][0]=='r' && !strcmp(vec[0],"run"))
     {
@@ -936,15 +981,6 @@ void ResultFileManager::processLine(char **vec, int numTokens, sParseContext &ct
         {
             // old-style "run" line, format: run <runNumber> [<networkName> [<dateTime>]]
             // and runs in different files cannot be related, so we must create a new Run entry.
-            Run *runRef = addRun();
-            ctx.fileRunRef = addFileRun(ctx.fileRef, runRef);
-
-            runRef->runNumber = atoi(vec[1]);
-            runRef->attributes["run-number"] = vec[1];
-            if (numTokens>=3)
-                runRef->attributes["network"] = vec[2];
-            if (numTokens>=4)
-                runRef->attributes["dateTime"] = vec[3];
 
             // assemble a probably-unique runName
             std::stringstream os;
@@ -953,7 +989,18 @@ void ResultFileManager::processLine(char **vec, int numTokens, sParseContext &ct
                 os << "-" << vec[2];
             if (numTokens>=4)
                 os << "-" << vec[3];
-            runRef->runName = os.str();
+
+            Run *runRef = addRun(os.str());
+            ctx.fileRunRef = addFileRun(ctx.fileRef, runRef);
+
+            runRef->runNumber = atoi(vec[1]);
+            StringMap attributes;
+            attributes["run-number"] = vec[1];
+            if (numTokens>=3)
+                attributes["network"] = vec[2];
+            if (numTokens>=4)
+                attributes["dateTime"] = vec[3];
+            runRef->attributes = attributeSets.get(attributes);
         }
         else
         {
@@ -963,8 +1010,7 @@ void ResultFileManager::processLine(char **vec, int numTokens, sParseContext &ct
             if (!runRef)
             {
                 // not yet: add it
-                runRef = addRun();
-                runRef->runName = vec[1];
+                runRef = addRun(vec[1]);
             }
             // associate Run with this file
             CHECK(getFileRun(ctx.fileRef, runRef)==NULL, "invalid result file: run Id repeats in the file");
@@ -987,7 +1033,7 @@ void ResultFileManager::processLine(char **vec, int numTokens, sParseContext &ct
     if (ctx.fileRunRef==NULL)
     {
         // fake a new Run
-        Run *runRef = addRun();
+        Run *runRef = addRun("");
         ctx.fileRunRef = addFileRun(ctx.fileRef, runRef);
         runRef->runNumber = 0;
 
@@ -1089,11 +1135,10 @@ void ResultFileManager::processLine(char **vec, int numTokens, sParseContext &ct
         std::string varName = vec[1];
         std::string varValue = vec[2];
 
-        StringMap &itervars = ctx.fileRunRef->runRef->itervars;
-        StringMap::iterator oldRef = itervars.find(varName);
-        CHECK(oldRef == itervars.end() || oldRef->second == varValue,
+        const char *oldValue = getPendingValue(ctx.itervars, ctx.fileRunRef->runRef->itervars, varName);
+        CHECK(oldValue == NULL || varValue == oldValue,
            "Value of iteration variable conflicts with previously loaded value");
-        itervars[varName] = varValue;
+        ctx.itervars[varName] = varValue;
     }
     else if (vec[0][0]=='a' && !strcmp(vec[0],"attr"))
     {
@@ -1105,11 +1150,12 @@ void ResultFileManager::processLine(char **vec, int numTokens, sParseContext &ct
         if (ctx.lastResultItemType == 0) // run attribute
         {
             // store attribute
-            StringMap &attributes = ctx.fileRunRef->runRef->attributes;
-            StringMap::iterator oldPairRef = attributes.find(attrName);
-            CHECK(oldPairRef == attributes.end() || oldPairRef->second == attrValue,
+            AttributeSetRef &attributes = ctx.fileRunRef->runRef->attributes;
+            const char *oldValue = getPendingValue(ctx.attributes, attributes, attrName);
+            CHECK(oldValue == NULL || attrValue == oldValue,
                   "Value of run attribute conflicts with previously loaded value");
-            attributes[attrName] = attrValue;
+            ctx.attributesRef = &attributes;
+            ctx.attributes[attrName] = attrValue;
 
             // the "runNumber" attribute is also stored separately
             if (attrName == "runNumber")
@@ -1118,17 +1164,20 @@ void ResultFileManager::processLine(char **vec, int numTokens, sParseContext &ct
         else if (ctx.lastResultItemType == SCALAR)
         {
             Assert(!ctx.fileRef->scalarResults.empty());
-            ctx.fileRef->scalarResults.back().attributes[attrName] = attrValue;
+            ctx.attributesRef = &ctx.fileRef->scalarResults.back().attributes;
+            ctx.attributes[attrName] = attrValue;
         }
         else if (ctx.lastResultItemType == VECTOR)
         {
             Assert(!ctx.fileRef->vectorResults.empty());
-            ctx.fileRef->vectorResults.back().attributes[attrName] = attrValue;
+            ctx.attributesRef = &ctx.fileRef->vectorResults.back().attributes;
+            ctx.attributes[attrName] = attrValue;
         }
         else if (ctx.lastResultItemType == HISTOGRAM)
         {
             Assert(!ctx.fileRef->histogramResults.empty());
-            ctx.fileRef->histogramResults.back().attributes[attrName] = attrValue;
+            ctx.attributesRef = &ctx.fileRef->histogramResults.back().attributes;
+            ctx.attributes[attrName] = attrValue;
         }
     }
     else if (vec[0][0]=='p' && !strcmp(vec[0],"param"))
@@ -1138,11 +1187,10 @@ void ResultFileManager::processLine(char **vec, int numTokens, sParseContext &ct
         // store module param
         std::string paramName = vec[1];
         std::string paramValue = vec[2];
-        StringMap &params = ctx.fileRunRef->runRef->moduleParams;
-        StringMap::iterator oldPairRef = params.find(paramName);
-        CHECK(oldPairRef == params.end() || oldPairRef->second == paramValue,
+        const char *oldValue = getPendingValue(ctx.moduleParams, ctx.fileRunRef->runRef->moduleParams, paramName);
+        CHECK(oldValue == NULL || paramValue == oldValue,
               "Value of module parameter conflicts with previously loaded value");
-        params[paramName] = paramValue;
+        ctx.moduleParams[paramName] = paramValue;
     }
     else if (opp_isdigit(vec[0][0]) && numTokens>=3)
     {
@@ -1199,16 +1247,27 @@ ResultFile *ResultFileManager::loadFile(const char *fileName, const char *fileSy
     {
         fileRef = addFile(fileName, fileSystemFileName, false);
 
+        // a manifest of sharded vector files: load the shards
+        if (isManifestFile(fileSystemFileName))
+        {
+            loadManifest(fileRef, reload);
+        }
         // if vector file and has index, load vectors from the index file
-        if (IndexFile::isVectorFile(fileSystemFileName) && IndexFile::isIndexFileUpToDate(fileSystemFileName))
+        else if (IndexFile::isVectorFile(fileSystemFileName) && IndexFile::isIndexFileUpToDate(fileSystemFileName))
         {
             std::string indexFileName = IndexFile::getIndexFileName(fileSystemFileName);
             loadVectorsFromIndex(indexFileName.c_str(), fileRef);
         }
+        else if (BinaryVectorFileReader::isBinaryVectorFile(fileSystemFileName))
+        {
+            // binary vector files contain no declarations, they cannot be loaded without their index
+            throw opp_runtime_error("binary vector file `%s' has no up-to-date index file", fileSystemFileName);
+        }
         else
         {
             // process lines in file
             FileReader freader(fileSystemFileName);
+            freader.setMemoryMapped(true, FileReader::SEQUENTIAL);
             char *line;
             LineTokenizer tokenizer;
             sParseContext ctx(fileRef);
@@ -1219,6 +1278,7 @@ ResultFile *ResultFileManager::loadFile(const char *fileName, const char *fileSy
                 char **tokens = tokenizer.tokens();
                 processLine(tokens, numTokens, ctx);
             }
+            flushAttributes(ctx);
 
             fileRef->numLines = ctx.lineNo; // freader.getNumReadLines();
         }
@@ -1238,6 +1298,307 @@ ResultFile *ResultFileManager::loadFile(const char *fileName, const char *fileSy
     return fileRef;
 }
 
+// state shared by the threads of loadFiles()
+struct StagedLoad
+{
+    const std::vector<std::string> *fileNames;
+    std::vector<int> pending;              // indices of the files to be parsed
+    std::vector<ResultFile*> stagedFiles;  // by file index
+    std::vector<ResultFileManager*> stagingManagers;  // by file index
+    std::vector<std::string> errors;       // by file index
+    size_t next;                           // in "pending"
+    pthread_mutex_t mutex;                 // protects "next"
+};
+
+static void *loadStagedFiles(void *arg)
+{
+    StagedLoad *load = (StagedLoad *)arg;
+    while (true)
+    {
+        pthread_mutex_lock(&load->mutex);
+        size_t k = load->next++;
+        pthread_mutex_unlock(&load->mutex);
+        if (k >= load->pending.size())
+            return NULL;
+
+        // a manager of its own, so that the file sees no runs of other files
+        int i = load->pending[k];
+        ResultFileManager *manager = new ResultFileManager();
+        load->stagingManagers[i] = manager;
+        try
+        {
+            load->stagedFiles[i] = manager->loadFile((*load->fileNames)[i].c_str());
+        }
+        catch (std::exception& e)
+        {
+            load->errors[i] = e.what();
+        }
+    }
+}
+
+ResultFileList ResultFileManager::loadFiles(const std::vector<std::string>& fileNames, int numThreads)
+{
+    WRITER_MUTEX
+    int numFiles = fileNames.size();
+    ResultFileList result(numFiles);
+
+    // find the files that need parsing; loaded ones, repeated ones and manifests are done later
+    StagedLoad load;
+    load.fileNames = &fileNames;
+    load.stagedFiles.resize(numFiles);
+    load.stagingManagers.resize(numFiles);
+    load.errors.resize(numFiles);
+    load.next = 0;
+    std::set<std::string> seen;
+    for (int i = 0; i < numFiles; i++)
+    {
+        const char *fileName = fileNames[i].c_str();
+        if (!getFile(fileName) && !isManifestFile(fileName) && seen.insert(fileName).second)
+            load.pending.push_back(i);
+    }
+
+    if (numThreads <= 0)
+        numThreads = getNumCPUs();
+    if (numThreads > (int)load.pending.size())
+        numThreads = load.pending.size();
+
+    if (numThreads <= 1)
+    {
+        for (int i = 0; i < numFiles; i++)
+            result[i] = loadFile(fileNames[i].c_str());
+        return result;
+    }
+
+    // parse the files on numThreads threads (this thread is one of them)
+    pthread_mutex_init(&load.mutex, NULL);
+    std::vector<pthread_t> threadIds;
+    for (int t = 1; t < numThreads; t++)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, loadStagedFiles, &load) != 0)
+            break;  // make do with the threads we have
+        threadIds.push_back(thread);
+    }
+    loadStagedFiles(&load);
+    for (size_t t = 0; t < threadIds.size(); t++)
+        pthread_join(threadIds[t], NULL);
+    pthread_mutex_destroy(&load.mutex);
+
+    // move the files over, in the given order
+    try
+    {
+        for (int i = 0; i < numFiles; i++)
+        {
+            if (!load.errors[i].empty())
+                throw opp_runtime_error("%s", load.errors[i].c_str());
+            ResultFileManager *staging = load.stagingManagers[i];
+            if (!staging || getFile(fileNames[i].c_str()))
+                result[i] = loadFile(fileNames[i].c_str());  // loaded already (maybe as a shard), or a manifest
+            else
+            {
+                PooledStringMap pooledNames;
+                PooledAttributeSetMap pooledAttributeSets;
+                try
+                {
+                    result[i] = mergeFile(staging, load.stagedFiles[i], pooledNames, pooledAttributeSets);
+                }
+                catch (std::exception&)
+                {
+                    // conflicts with earlier files: parse it again here, for the error message of loadFile()
+                    result[i] = loadFile(fileNames[i].c_str());
+                }
+            }
+            delete staging;
+            load.stagingManagers[i] = NULL;
+        }
+    }
+    catch (std::exception&)
+    {
+        for (int i = 0; i < numFiles; i++)
+            delete load.stagingManagers[i];
+        throw;
+    }
+    return result;
+}
+
+ResultFile *ResultFileManager::mergeFile(const ResultFileManager *staging, const ResultFile *file, PooledStringMap& pooledNames, PooledAttributeSetMap& pooledAttributeSets)
+{
+    ResultFile *fileRef = addFile(file->filePath.c_str(), file->fileSystemFilePath.c_str(), false);
+    try
+    {
+        // runs and their associations with the file, in their original order
+        std::map<const FileRun*, FileRun*> fileRuns;
+        for (int i = 0; i < (int)staging->fileRunList.size(); i++)
+        {
+            const FileRun *fileRun = staging->fileRunList[i];
+            if (fileRun->fileRef == file)
+                fileRuns[fileRun] = addFileRun(fileRef, mergeRun(fileRun->runRef, file));
+        }
+
+        fileRef->scalarResults = file->scalarResults;
+        for (int i = 0; i < (int)fileRef->scalarResults.size(); i++)
+            mergeItem(fileRef->scalarResults[i], fileRuns, pooledNames, pooledAttributeSets);
+        fileRef->vectorResults.reserve(file->vectorResults.size());
+        for (int i = 0; i < (int)file->vectorResults.size(); i++)
+        {
+            VectorResult vector = file->vectorResults[i];
+            mergeItem(vector, fileRuns, pooledNames, pooledAttributeSets);
+            const std::string *&columns = pooledNames[vector.columnsRef];
+            if (!columns)
+                columns = vectorColumns.insert(*vector.columnsRef);
+            vector.columnsRef = columns;
+            addVectorResult(fileRef, vector);
+        }
+        fileRef->histogramResults = file->histogramResults;
+        for (int i = 0; i < (int)fileRef->histogramResults.size(); i++)
+            mergeItem(fileRef->histogramResults[i], fileRuns, pooledNames, pooledAttributeSets);
+        fileRef->numLines = file->numLines;
+        fileRef->numUnrecognizedLines = file->numUnrecognizedLines;
+    }
+    catch (std::exception&)
+    {
+        unloadFile(fileRef);
+        throw;
+    }
+    return fileRef;
+}
+
+Run *ResultFileManager::mergeRun(const Run *run, const ResultFile *file)
+{
+    // runs from old-style "run" lines are named "<fileName>:<lineNo>-..." and never shared between files
+    bool oldStyle = run->runName.compare(0, file->fileName.size()+1, file->fileName + ":") == 0;
+    Run *runRef = (run->runName.empty() || oldStyle) ? NULL : getRunByName(run->runName.c_str());
+    if (!runRef)
+    {
+        runRef = addRun(run->runName);
+        runRef->runNumber = run->runNumber;
+        runRef->attributes = attributeSets.get(run->attributes);
+        runRef->itervars = attributeSets.get(run->itervars);
+        runRef->moduleParams = attributeSets.get(run->moduleParams);
+        return runRef;
+    }
+
+    // all checked before anything is merged, so a conflict leaves the run as it was
+    StringMap attributes = run->attributes.toStringMap();
+    StringMap itervars = run->itervars.toStringMap();
+    StringMap moduleParams = run->moduleParams.toStringMap();
+    checkRunAttributes(runRef->attributes, attributes, "run attribute", file);
+    checkRunAttributes(runRef->itervars, itervars, "iteration variable", file);
+    checkRunAttributes(runRef->moduleParams, moduleParams, "module parameter", file);
+    mergeRunAttributes(runRef->attributes, attributes);
+    mergeRunAttributes(runRef->itervars, itervars);
+    mergeRunAttributes(runRef->moduleParams, moduleParams);
+    if (run->runNumber != 0)
+        runRef->runNumber = run->runNumber;
+    return runRef;
+}
+
+void ResultFileManager::checkRunAttributes(const AttributeSetRef& to, const StringMap& from, const char *what, const ResultFile *file)
+{
+    for (StringMap::const_iterator it = from.begin(); it != from.end(); ++it)
+    {
+        const char *oldValue = to.get(it->first.c_str());
+        if (oldValue != NULL && it->second != oldValue)
+            throw opp_runtime_error("Value of %s conflicts with previously loaded value, file %s",
+                                    what, file->fileSystemFilePath.c_str());
+    }
+}
+
+void ResultFileManager::mergeRunAttributes(AttributeSetRef& to, const StringMap& from)
+{
+    if (!from.empty())
+        to = attributeSets.merge(to, from);
+}
+
+void ResultFileManager::mergeItem(ResultItem& item, const std::map<const FileRun*, FileRun*>& fileRuns, PooledStringMap& pooledNames, PooledAttributeSetMap& pooledAttributeSets)
+{
+    item.fileRunRef = fileRuns.find(item.fileRunRef)->second;
+
+    // pooled strings of the staging manager are mapped to ours once
+    const std::string *&moduleName = pooledNames[item.moduleNameRef];
+    if (!moduleName)
+        moduleName = moduleNames.insert(*item.moduleNameRef);
+    item.moduleNameRef = moduleName;
+
+    const std::string *&name = pooledNames[item.nameRef];
+    if (!name)
+        name = names.insert(*item.nameRef);
+    item.nameRef = name;
+
+    // and so are attribute sets
+    if (!item.attributes.empty())
+    {
+        AttributeSetRef &attributes = pooledAttributeSets[item.attributes.getSet()];
+        if (attributes.empty())
+            attributes = attributeSets.get(item.attributes);
+        item.attributes = attributes;
+    }
+}
+
+bool ResultFileManager::isManifestFile(const char *fileName)
+{
+    int len = strlen(fileName);
+    return (len >= 4) && (strcmp(fileName+len-4, ".vmf") == 0);
+}
+
+void ResultFileManager::loadManifest(ResultFile *fileRef, bool reload)
+{
+    // shard names are relative to the directory of the manifest
+    std::string::size_type pos = fileRef->filePath.find_last_of("/\\");
+    std::string dir = pos == std::string::npos ? "" : fileRef->filePath.substr(0, pos+1);
+    pos = fileRef->fileSystemFilePath.find_last_of("/\\");
+    std::string fileSystemDir = pos == std::string::npos ? "" : fileRef->fileSystemFilePath.substr(0, pos+1);
+
+    FileReader freader(fileRef->fileSystemFilePath.c_str());
+    char *line;
+    LineTokenizer tokenizer;
+    sParseContext ctx(fileRef);
+    std::string runName;
+    while ((line=freader.getNextLineBufferPointer())!=NULL)
+    {
+        int len = freader.getCurrentLineLength();
+        int numTokens = tokenizer.tokenize(line, len);
+        char **vec = tokenizer.tokens();
+        ++ctx.lineNo;
+
+        if (numTokens==0 || vec[0][0]=='#')
+            continue;
+        else if (!strcmp(vec[0], "version"))
+        {
+            int version;
+            CHECK(numTokens >= 2, "missing version number");
+            CHECK(parseInt(vec[1], version), "version is not a number");
+            CHECK(version <= 1, "expects manifest version 1 or lower");
+        }
+        else if (!strcmp(vec[0], "run"))
+        {
+            CHECK(numTokens >= 2, "invalid manifest: run Id missing from `run' line");
+            runName = vec[1];
+        }
+        else if (!strcmp(vec[0], "shard"))
+        {
+            CHECK(numTokens >= 2, "invalid manifest: file name missing from `shard' line");
+            std::string shardFileName = dir + vec[1];
+            std::string shardFileSystemFileName = fileSystemDir + vec[1];
+            fileRef->shardIds.push_back(loadFile(shardFileName.c_str(), shardFileSystemFileName.c_str(), reload)->id);
+        }
+        else
+            fileRef->numUnrecognizedLines++;
+    }
+    fileRef->numLines = ctx.lineNo;
+
+    // the manifest belongs to the run of its shards
+    if (!runName.empty())
+    {
+        Run *runRef = getRunByName(runName.c_str());
+        if (!runRef)
+        {
+            runRef = addRun(runName);
+        }
+        addFileRun(fileRef, runRef);
+    }
+}
+
 void ResultFileManager::loadVectorsFromIndex(const char *filename, ResultFile *fileRef)
 {
     VectorFileIndex *index = IndexFileReader(filename).readAll();
@@ -1248,15 +1609,27 @@ void ResultFileManager::loadVectorsFromIndex(const char *filename, ResultFile *f
         return;
     }
 
-    Run *runRef = getRunByName(index->run.runName.c_str());
+    // a file without a run line has a run of its own, like when it is parsed
+    Run *runRef = index->run.runName.empty() ? NULL : getRunByName(index->run.runName.c_str());
     if (!runRef)
     {
-        runRef = addRun();
-        runRef->runName = index->run.runName;
+        runRef = addRun(index->run.runName);
+    }
+    // merged into what other files of the run have loaded, the same way mergeRun() does
+    try
+    {
+        checkRunAttributes(runRef->attributes, index->run.attributes, "run attribute", fileRef);
+        checkRunAttributes(runRef->moduleParams, index->run.moduleParams, "module parameter", fileRef);
     }
-    runRef->runNumber = index->run.runNumber;
-    runRef->attributes = index->run.attributes;
-    runRef->moduleParams = index->run.moduleParams;
+    catch (std::exception&)
+    {
+        delete index;
+        throw;
+    }
+    if (index->run.runNumber != 0)
+        runRef->runNumber = index->run.runNumber;
+    mergeRunAttributes(runRef->attributes, index->run.attributes);
+    mergeRunAttributes(runRef->moduleParams, index->run.moduleParams);
     FileRun *fileRunRef = addFileRun(fileRef, runRef);
 
     for (int i = 0; i < numOfVectors; ++i)
@@ -1266,17 +1639,17 @@ void ResultFileManager::loadVectorsFromIndex(const char *filename, ResultFile *f
 
         VectorResult vectorResult;
         vectorResult.fileRunRef = fileRunRef;
-        vectorResult.attributes = StringMap(vectorRef->attributes);
+        vectorResult.attributes = attributeSets.get(vectorRef->attributes);
         vectorResult.vectorId = vectorRef->vectorId;
         vectorResult.moduleNameRef = moduleNames.insert(vectorRef->moduleName);
         vectorResult.nameRef = names.insert(vectorRef->name);
-        vectorResult.columns = vectorRef->columns;
+        vectorResult.columnsRef = vectorColumns.insert(vectorRef->columns);
         vectorResult.startEventNum = vectorRef->startEventNum;
         vectorResult.endEventNum = vectorRef->endEventNum;
         vectorResult.startTime = vectorRef->startTime;
         vectorResult.endTime = vectorRef->endTime;
         vectorResult.stat = vectorRef->stat;
-        fileRef->vectorResults.push_back(vectorResult);
+        addVectorResult(fileRef, vectorResult);
     }
     delete index;
 }
@@ -1285,6 +1658,14 @@ void ResultFileManager::unloadFile(ResultFile *file)
 {
     WRITER_MUTEX
 
+    // unload the shards of a manifest, unless already done
+    for (int i=0; i<(int)file->shardIds.size(); i++)
+    {
+        ResultFile *shard = fileList[file->shardIds[i]];
+        if (shard)
+            unloadFile(shard);
+    }
+
     // remove computed vector IDs
     for (ComputedIDCache::iterator it = computedIDCache.begin(); it != computedIDCache.end();)
     {
@@ -1309,6 +1690,7 @@ void ResultFileManager::unloadFile(ResultFile *file)
             runsPotentiallyToBeDeleted.push_back(fileRunList[i]->runRef);
 
             // delete fileRun
+            fileRunIndex.erase(std::make_pair(file, fileRunList[i]->runRef));
             delete fileRunList[i];
             fileRunList.erase(fileRunList.begin()+i);
             i--;
@@ -1319,6 +1701,11 @@ void ResultFileManager::unloadFile(ResultFile *file)
     // It is not allowed to move another ResultFile into the hole, because
     // that would change its "id", and invalidate existing IDs (IDLists)
     // that use that file.
+    FileIndex::iterator fileIt = fileIndex.find(file->filePath);
+    if (fileIt != fileIndex.end() && fileIt->second == file)
+        fileIndex.erase(fileIt);
+    vectorIdIndex.erase(vectorIdIndex.lower_bound(std::make_pair(file->id, INT_MIN)),
+                        vectorIdIndex.lower_bound(std::make_pair(file->id + 1, INT_MIN)));
     fileList[file->id] = NULL;
     delete file;
 
@@ -1332,6 +1719,15 @@ void ResultFileManager::unloadFile(ResultFile *file)
             RunList::iterator it = std::find(runList.begin(), runList.end(), runRef);
             assert(it != runList.end());  // runs may occur only once in runsPotentiallyToBeDeleted, because runNames are not allowed to repeat in files
             runList.erase(it);
+
+            std::pair<RunIndex::iterator, RunIndex::iterator> range = runIndex.equal_range(runRef->runName);
+            for (RunIndex::iterator runIt = range.first; runIt != range.second; ++runIt)
+                if (runIt->second == runRef)
+                {
+                    runIndex.erase(runIt);
+                    break;
+                }
+            delete runRef;  // also releases its attribute sets
         }
     }
 }
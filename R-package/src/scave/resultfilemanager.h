@@ -42,6 +42,7 @@
 #include "commonutil.h"
 #include "statistics.h"
 #include "scaveutils.h"
+#include "attributeset.h"
 
 #ifdef THREADED
 #include "rwlock.h"
@@ -78,14 +79,13 @@ struct SCAVE_API ResultItem
     FileRun *fileRunRef; // backref to containing FileRun
     const std::string *moduleNameRef; // points into ResultFileManager's StringSet
     const std::string *nameRef; // scalarname or vectorname; points into ResultFileManager's StringSet
-    StringMap attributes; // metadata in key/value form
+    AttributeSetRef attributes; // metadata in key/value form; interned by ResultFileManager's AttributeSetPool
     ComputationNode computation;
 
     ResultItem() : fileRunRef(NULL), moduleNameRef(NULL), nameRef(NULL), computation(NULL) {}
 
     const char *getAttribute(const char *attrName) const {
-        StringMap::const_iterator it = attributes.find(attrName);
-        return it==attributes.end() ? NULL : it->second.c_str();
+        return attributes.get(attrName);
     }
 
     /**
@@ -118,12 +118,12 @@ struct SCAVE_API ScalarResult : public ResultItem
 struct SCAVE_API VectorResult : public ResultItem
 {
     int vectorId;
-    std::string columns;
+    const std::string *columnsRef; // e.g. "ETV"; points into ResultFileManager's StringSet
     eventnumber_t startEventNum, endEventNum;
     simultime_t startTime, endTime;
     Statistics stat;
 
-    VectorResult() : vectorId(-1), startEventNum(-1), endEventNum(-1), startTime(0.0), endTime(0.0) {}
+    VectorResult() : vectorId(-1), columnsRef(NULL), startEventNum(-1), endEventNum(-1), startTime(0.0), endTime(0.0) {}
 
     long getCount()      const { return stat.getCount(); }
     double getMin()      const { return stat.getMin(); }
@@ -191,6 +191,7 @@ struct SCAVE_API ResultFile
     HistogramResults histogramResults;
     int numLines;
     int numUnrecognizedLines;
+    std::vector<int> shardIds; // for manifests (".vmf"): ids of the vector files listed in it
 };
 
 /**
@@ -203,32 +204,29 @@ struct SCAVE_API Run
     std::string runName; // unique identifier for the run, "runId"
     ResultFileManager *resultFileManager; // backref to containing ResultFileManager
 
-    // various attributes of the run are stored in a string map.
+    // various attributes of the run are stored in an attribute set
+    // (interned by ResultFileManager's AttributeSetPool, like the other two sets).
     // keys include: runNumber, networkName, datetime, experiment, measurement, replication
-    StringMap attributes;
+    AttributeSetRef attributes;
     int runNumber; // this is stored separately as well, for convenience
 
     // iteration variables, denotes by "itervar"
-    StringMap itervars;
+    AttributeSetRef itervars;
 
     // module parameters: maps wildcard pattern to value
-    StringMap moduleParams;
+    AttributeSetRef moduleParams;
 
-    // utility methods to non-disruptive access to the maps (note that evaluating
-    // attributes["nonexisting-key"] would create a blank entry with that key!)
+    // utility methods to access the sets
     const char *getAttribute(const char *attrName) const {
-        StringMap::const_iterator it = attributes.find(attrName);
-        return it==attributes.end() ? NULL : it->second.c_str();
+        return attributes.get(attrName);
     }
 
     const char *getIterationVariable(const char *varName) const {
-        StringMap::const_iterator it = itervars.find(varName);
-        return it==itervars.end() ? NULL : it->second.c_str();
+        return itervars.get(varName);
     }
 
     const char *getModuleParam(const char *paramName) const {
-        StringMap::const_iterator it = moduleParams.find(paramName);
-        return it==moduleParams.end() ? NULL : it->second.c_str();
+        return moduleParams.get(paramName);
     }
 };
 
@@ -253,6 +251,12 @@ typedef std::vector<std::string> StringVector;
 
 typedef std::map<std::pair<ComputationID, ID> , ID> ComputedIDCache;
 
+// indexes for ResultFileManager lookups; runs with the same name are kept in creation order
+typedef std::map<std::string, ResultFile*> FileIndex;
+typedef std::multimap<std::string, Run*> RunIndex;
+typedef std::map<std::pair<ResultFile*, Run*>, FileRun*> FileRunIndex;
+typedef std::map<std::pair<int, int>, int> VectorIdIndex; // (fileId,vectorId) -> position in vectorResults
+
 class CmpBase;
 
 /**
@@ -288,8 +292,18 @@ class SCAVE_API ResultFileManager
     StringPool moduleNames;
     StringPool names;
     StringPool classNames; // currently not used
+    StringPool vectorColumns; // column layouts of vectors
+
+    // attributes of result items and runs; equal sets are stored once
+    AttributeSetPool attributeSets;
 
     ComputedIDCache computedIDCache;
+
+    // lookup indexes, maintained by the add...() functions and unloadFile()
+    FileIndex fileIndex;
+    RunIndex runIndex;
+    FileRunIndex fileRunIndex;
+    VectorIdIndex vectorIdIndex;
 #ifdef THREADED
     ReentrantReadWriteLock lock;
 #endif
@@ -302,10 +316,16 @@ class SCAVE_API ResultFileManager
         FileRun *fileRunRef; /*inout*/
         // type of the last result item which attributes should be added to
         int lastResultItemType; /*inout*/
+        // attributes read since the last result item or run line; they are
+        // added to the attribute sets by flushAttributes()
+        AttributeSetRef *attributesRef; /*inout*/
+        StringMap attributes; /*inout*/
+        StringMap itervars; /*inout*/
+        StringMap moduleParams; /*inout*/
 
         sParseContext(ResultFile *fileRef)
             : fileRef(fileRef), fileName(fileRef->filePath.c_str()), lineNo(0),
-              fileRunRef(NULL), lastResultItemType(0) {}
+              fileRunRef(NULL), lastResultItemType(0), attributesRef(NULL) {}
     };
 
   public:
@@ -325,16 +345,29 @@ class SCAVE_API ResultFileManager
 
     // utility functions called while loading a result file
     ResultFile *addFile(const char *fileName, const char *fileSystemFileName, bool computed);
-    Run *addRun();
+    Run *addRun(const std::string& runName);
     FileRun *addFileRun(ResultFile *file, Run *run);  // associates a ResultFile with a Run
 
     void processLine(char **vec, int numTokens, sParseContext &ctx);
+    void flushAttributes(sParseContext &ctx);
     int addScalar(FileRun *fileRunRef, const char *moduleName, const char *scalarName, double value, bool isField);
     int addVector(FileRun *fileRunRef, int vectorId, const char *moduleName, const char *vectorName, const char *columns);
+    int addVectorResult(ResultFile *fileRef, const VectorResult& vector);
     int addHistogram(FileRun *fileRunRef, const char *moduleName, const char *histogramName, Statistics stat, const StringMap &attrs, const HistogramFields &fields);
 
     ResultFile *getFileForID(ID id) const; // checks for NULL
     void loadVectorsFromIndex(const char *filename, ResultFile *fileRef);
+    void checkRunAttributes(const AttributeSetRef& to, const StringMap& from, const char *what, const ResultFile *file);
+    void mergeRunAttributes(AttributeSetRef& to, const StringMap& from);
+    void loadManifest(ResultFile *fileRef, bool reload);
+    static bool isManifestFile(const char *fileName);
+
+    // utility functions for loadFiles(): copying files loaded by another manager
+    typedef std::map<const std::string*, const std::string*> PooledStringMap;
+    typedef std::map<const AttributeSet*, AttributeSetRef> PooledAttributeSetMap;
+    ResultFile *mergeFile(const ResultFileManager *staging, const ResultFile *file, PooledStringMap& pooledNames, PooledAttributeSetMap& pooledAttributeSets);
+    Run *mergeRun(const Run *run, const ResultFile *file);
+    void mergeItem(ResultItem& item, const std::map<const FileRun*, FileRun*>& fileRuns, PooledStringMap& pooledNames, PooledAttributeSetMap& pooledAttributeSets);
 
     template <class T>
     void collectIDs(IDList &result, std::vector<T> ResultFile::* vec, int type, bool includeComputed = false, bool includeFields = true) const;
@@ -424,6 +457,17 @@ class SCAVE_API ResultFileManager
      * the file is actually read from fileSystemFileName
      */
     ResultFile *loadFile(const char *fileName, const char *fileSystemFileName=NULL, bool reload=false);
+
+    /**
+     * Loads several files like loadFile() does, but parses them on numThreads
+     * threads (0 means one per processor). Each file is loaded into a separate
+     * manager, then they are moved over in the given order, so IDs and run
+     * metadata come out the same as if the files were loaded one by one.
+     * Files that a manifest earlier in the list has already loaded as its
+     * shards are not loaded again. If a file cannot be loaded, the files
+     * before it remain loaded. Manifests are loaded on the calling thread.
+     */
+    ResultFileList loadFiles(const std::vector<std::string>& fileNames, int numThreads=0);
     void unloadFile(ResultFile *file);
 
 
@@ -28,8 +28,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <utility>
-#include <locale.h>
 #include "platmisc.h"
+#include "numberparser.h"
 #include "scaveutils.h"
 
 
@@ -37,31 +37,22 @@ NAMESPACE_BEGIN
 
 bool parseInt(const char *s, int &dest)
 {
-    char *e;
-    dest = (int)strtol(s,&e,10);
-    return !*e;
+    return opp_parseint(s, dest);
 }
 
 bool parseLong(const char *s, long &dest)
 {
-    char *e;
-    dest = strtol(s,&e,10);
-    return !*e;
+    return opp_parselong(s, dest);
 }
 
 bool parseInt64(const char *s, int64 &dest)
 {
-    char *e;
-    dest = strtoll(s,&e,10);
-    return !*e;
+    return opp_parseint64(s, dest);
 }
 
 bool parseDouble(const char *s, double& dest)
 {
-    char *e;
-    setlocale(LC_NUMERIC, "C");
-    dest = strtod(s,&e);
-    if (!*e)
+    if (opp_parsedouble(s, dest))
     {
         return true;
     }
@@ -86,6 +77,15 @@ bool parseSimtime(const char *s, simultime_t &dest)
     const char *e;
     simultime_t t;
     double d;
+    int64 mantissa;
+    int scale;
+
+    // plain fixed-point numbers, the format written by current simulations
+    if (opp_parsedecimal(s, mantissa, scale))
+    {
+        dest = BigDecimal(mantissa, scale);
+        return true;
+    }
 
     try {
         t = BigDecimal::parse(s, e);
@@ -126,6 +126,18 @@ std::string unquoteString(const char *str)
     return result;
 }
 
+int getNumCPUs()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
 const std::string *StringPool::insert(const std::string& str)
 {
         if (!lastInsertedPtr || *lastInsertedPtr!=str)
@@ -45,6 +45,9 @@ SCAVE_API bool parseDouble(const char *str, double &dest);
 SCAVE_API bool parseSimtime(const char *str, simultime_t &dest);
 SCAVE_API std::string unquoteString(const char *str);
 
+// number of processors available, for sizing thread pools
+SCAVE_API int getNumCPUs();
+
 // simple profiling macro
 // var is a long variable collecting the execution time of stmt in usec
 #define TIME(var,stmt) { timeval start,end; \
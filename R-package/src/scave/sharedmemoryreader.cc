@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#endif
+#include "channel.h"
+#include "scaveutils.h"
+#include "sharedmemoryreader.h"
+
+NAMESPACE_BEGIN
+
+using namespace std;
+
+#define POLL_INTERVAL_USEC  1000   // how long to sleep when no new data is available
+#define MAX_RECORDS         1000   // records read in one process() call
+#define WRITER_CHECK_INTERVAL  0.1 // seconds between checking whether an idle writer is still alive
+
+SharedMemoryReaderNode::SharedMemoryReaderNode(const char *name, double timeout) :
+  name(name), timeout(timeout), numLostSamples(0), idleTime(0), lastWriterCheck(0), fFinished(false)
+{
+#ifdef _WIN32
+    throw opp_runtime_error("Shared memory rings are not supported on this platform");
+#else
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1)
+        throw opp_runtime_error("Cannot open shared memory ring `%s'", name);
+
+    // map the header first, to learn the size of the ring
+    struct stat s;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &s) == 0 && (size_t)s.st_size >= sizeof(SharedMemoryRingHeader))
+        p = mmap(NULL, s.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        throw opp_runtime_error("Cannot map shared memory ring `%s'", name);
+    size = s.st_size;
+    header = (const SharedMemoryRingHeader *)p;
+
+    if (memcmp(header->magic, SHARED_MEMORY_RING_MAGIC, 8) != 0 ||
+        header->headerSize != sizeof(SharedMemoryRingHeader) ||
+        header->recordSize != sizeof(SharedMemoryRingRecord) ||
+        size < sizeof(SharedMemoryRingHeader) + (size_t)header->capacity * sizeof(SharedMemoryRingRecord))
+    {
+        munmap(p, size);
+        throw opp_runtime_error("`%s' is not a shared memory ring, or it is not initialized yet", name);
+    }
+    if (header->version > SHARED_MEMORY_RING_VERSION)
+    {
+        munmap(p, size);
+        throw opp_runtime_error("Shared memory ring `%s': expects version %d or lower", name, SHARED_MEMORY_RING_VERSION);
+    }
+
+    records = (const SharedMemoryRingRecord *)(header + 1);
+    mask = header->capacity - 1;
+
+    // start with the oldest data still in the ring
+    uint64 head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+    position = head > header->capacity ? head - header->capacity : 0;
+#endif
+}
+
+SharedMemoryReaderNode::~SharedMemoryReaderNode()
+{
+#ifndef _WIN32
+    munmap((void *)header, size);
+#endif
+}
+
+Port *SharedMemoryReaderNode::addVector(const VectorResult &vector)
+{
+    PortVector& portvec = ports[vector.vectorId];
+    portvec.push_back(Port(this));
+    Port& port = portvec.back();
+    return &port;
+}
+
+bool SharedMemoryReaderNode::isWriterAlive() const
+{
+#ifndef _WIN32
+    // writers that do not store their pid (0) are assumed to be alive
+    pid_t pid = (pid_t)header->writerPid;
+    if (pid != 0 && kill(pid, 0) == -1 && errno == ESRCH)
+        return false;
+#endif
+    return true;
+}
+
+bool SharedMemoryReaderNode::isReady() const
+{
+    return true;
+}
+
+void SharedMemoryReaderNode::process()
+{
+    uint64 head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+    if (head == position)
+    {
+        // nothing new: the writer has finished or died, or we wait a bit
+        if (__atomic_load_n(&header->closed, __ATOMIC_ACQUIRE))
+            fFinished = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE) == position;
+        else if (timeout > 0 && idleTime >= timeout)
+            fFinished = true;
+        else if (idleTime - lastWriterCheck >= WRITER_CHECK_INTERVAL && !isWriterAlive())
+            fFinished = true;  // it will not publish anything any more
+        else
+        {
+            if (idleTime - lastWriterCheck >= WRITER_CHECK_INTERVAL)
+                lastWriterCheck = idleTime;
+            usleep(POLL_INTERVAL_USEC);
+            idleTime += POLL_INTERVAL_USEC / 1e6;
+        }
+        return;
+    }
+    idleTime = 0;
+    lastWriterCheck = 0;
+
+    // skip what has already been overwritten
+    if (head - position > mask + 1)
+    {
+        numLostSamples += head - (mask + 1) - position;
+        position = head - (mask + 1);
+    }
+
+    for (int k = 0; k < MAX_RECORDS && position < head; k++, position++)
+    {
+        const SharedMemoryRingRecord *record = records + (position & mask);
+        uint64 seq = __atomic_load_n(&record->seq, __ATOMIC_ACQUIRE);
+        uint32 vectorId = __atomic_load_n(&record->vectorId, __ATOMIC_RELAXED);
+        uint64 time = __atomic_load_n(&record->time, __ATOMIC_RELAXED);
+        uint64 value = __atomic_load_n(&record->value, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (seq != position + 1 || __atomic_load_n(&record->seq, __ATOMIC_RELAXED) != seq)
+        {
+            // the writer has lapped us while reading
+            numLostSamples++;
+            continue;
+        }
+
+        Portmap::iterator portvec = ports.find(vectorId);
+        if (portvec != ports.end())
+        {
+            Datum a;
+            memcpy(&a.x, &time, sizeof(a.x));
+            memcpy(&a.y, &value, sizeof(a.y));
+
+            // write to port(s)
+            for (PortVector::iterator p=portvec->second.begin(); p!=portvec->second.end(); ++p)
+                p->getChannel()->write(&a,1);
+        }
+    }
+}
+
+bool SharedMemoryReaderNode::isFinished() const
+{
+    return fFinished;
+}
+
+//-----
+
+const char *SharedMemoryReaderNodeType::getDescription() const
+{
+    return "Reads vector data published by a running simulation in a shared memory ring.";
+}
+
+void SharedMemoryReaderNodeType::getAttributes(StringMap& attrs) const
+{
+    attrs["name"] = "name of the shared memory ring";
+    attrs["timeout"] = "finish if no data arrives for this many seconds (0: wait until the writer finishes or exits)";
+}
+
+void SharedMemoryReaderNodeType::getAttrDefaults(StringMap& attrs) const
+{
+    attrs["timeout"] = "0";
+}
+
+Node *SharedMemoryReaderNodeType::create(DataflowManager *mgr, StringMap& attrs) const
+{
+    checkAttrNames(attrs);
+
+    const char *name = attrs["name"].c_str();
+    double timeout = 0;
+    if (attrs.find("timeout") != attrs.end() && !parseDouble(attrs["timeout"].c_str(), timeout))
+        throw opp_runtime_error("sharedmemoryreader: invalid timeout `%s'", attrs["timeout"].c_str());
+
+    Node *node = new SharedMemoryReaderNode(name, timeout);
+    node->setNodeType(this);
+    mgr->addNode(node);
+    return node;
+}
+
+Port *SharedMemoryReaderNodeType::getPort(Node *node, const char *portname) const
+{
+    // vector id is used as port name
+    SharedMemoryReaderNode *node1 = dynamic_cast<SharedMemoryReaderNode *>(node);
+    VectorResult vector;
+    if (!parseInt(portname, vector.vectorId) || vector.vectorId < 0)
+        throw opp_runtime_error("sharedmemoryreader: invalid port name `%s', expecting a vector id", portname);
+    return node1->addVector(vector);
+}
+
+NAMESPACE_END
+
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SHAREDMEMORYREADER_H_
+#define _SHAREDMEMORYREADER_H_
+
+#include <map>
+#include <vector>
+#include <string>
+#include "platmisc.h"
+#include "node.h"
+#include "nodetype.h"
+#include "commonnodes.h"
+#include "resultfilemanager.h"
+
+NAMESPACE_BEGIN
+
+// layout of shared memory rings, must be kept consistent with the result writer library
+#define SHARED_MEMORY_RING_MAGIC          "OMNETRNG"
+#define SHARED_MEMORY_RING_VERSION        1
+#define SHARED_MEMORY_RING_BUSY           (~(uint64)0)
+
+struct SharedMemoryRingHeader
+{
+    char magic[8];
+    uint32 version;
+    uint32 headerSize;
+    uint32 recordSize;
+    uint32 capacity;   // a power of two
+    uint64 head;       // number of records published so far
+    uint32 closed;     // nonzero once the writer has finished
+    uint32 writerPid;  // process id of the writer
+    uint32 reserved[6];
+};
+
+struct SharedMemoryRingRecord
+{
+    uint64 seq;        // sequence number + 1, or SHARED_MEMORY_RING_BUSY
+    uint32 vectorId;
+    uint32 reserved;
+    uint64 time;       // bit pattern of the double
+    uint64 value;
+};
+
+/**
+ * Producer node which reads vector data that a running simulation
+ * publishes in a shared memory ring (see SharedMemoryRing in the result
+ * writer library), instead of the vector file. It starts with the oldest
+ * data still in the ring, and finishes when the writer has closed the
+ * ring, or the writer process has exited without closing it (or nothing
+ * was published for "timeout" seconds, if given).
+ *
+ * The writer never waits for readers: if the reader falls behind by more
+ * than the capacity of the ring, the overwritten samples are skipped and
+ * counted in getNumLostSamples().
+ */
+class SCAVE_API SharedMemoryReaderNode : public Node
+{
+    public:
+        typedef std::vector<Port> PortVector;
+        typedef std::map<int,PortVector> Portmap;
+    private:
+        std::string name;
+        double timeout;
+        Portmap ports;
+        size_t size;
+        const SharedMemoryRingHeader *header;
+        const SharedMemoryRingRecord *records;
+        uint64 mask;
+        uint64 position;     // of the next record to be read
+        int64 numLostSamples;
+        double idleTime;     // since the last data
+        double lastWriterCheck;  // idleTime when it was last checked that the writer is alive
+        bool fFinished;
+
+        bool isWriterAlive() const;
+
+    public:
+        SharedMemoryReaderNode(const char *name, double timeout = 0);
+        virtual ~SharedMemoryReaderNode();
+
+        Port *addVector(const VectorResult &vector);
+        int64 getNumLostSamples() const {return numLostSamples;}
+
+        virtual bool isReady() const;
+        virtual void process();
+        virtual bool isFinished() const;
+};
+
+
+class SCAVE_API SharedMemoryReaderNodeType : public ReaderNodeType
+{
+    public:
+        virtual const char *getName() const {return "sharedmemoryreader";}
+        virtual const char *getDescription() const;
+        virtual void getAttributes(StringMap& attrs) const;
+        virtual void getAttrDefaults(StringMap& attrs) const;
+        virtual Node *create(DataflowManager *mgr, StringMap& attrs) const;
+        virtual Port *getPort(Node *node, const char *portname) const;
+};
+
+
+NAMESPACE_END
+
+
+#endif
@@ -39,7 +39,9 @@
 #include "linetokenizer.h"
 #include "dataflowmanager.h"
 #include "indexfile.h"
+#include "binaryvectorfile.h"
 #include "indexedvectorfile.h"
+#include "vectorlinedecoder.h"
 #include "nodetyperegistry.h"
 #include "vectorfileindexer.h"
 
@@ -65,10 +67,39 @@ static string createTempFileName(const string baseFileName)
     return tmpFileName;
 }
 
+// Closes the current block, and starts a new one for the data line of the given vector at lineOffset.
+static VectorData *startBlock(VectorFileIndex& index, VectorData *currentVectorRef, Block& currentBlock, int vectorId,
+                              file_offset_t lineOffset, const char *vectorFileName, int64 lineNo)
+{
+    if (currentVectorRef != NULL)
+    {
+        currentBlock.size = (int64)(lineOffset - currentBlock.startOffset);
+        if (currentBlock.size > currentVectorRef->blockSize)
+            currentVectorRef->blockSize = currentBlock.size;
+        currentVectorRef->addBlock(currentBlock);
+    }
+
+    currentBlock = Block();
+    currentBlock.startOffset = lineOffset;
+    VectorData *vectorRef = index.getVectorById(vectorId);
+    if (vectorRef == NULL)
+        throw ResultFileFormatException("vector file indexer: missing vector declaration", vectorFileName, lineNo);
+    return vectorRef;
+}
+
 // TODO: adjacent blocks are merged
 void VectorFileIndexer::generateIndex(const char *vectorFileName, IProgressMonitor *monitor)
 {
+    // the index of binary vector files is written by the recorder, it cannot be regenerated
+    if (BinaryVectorFileReader::isBinaryVectorFile(vectorFileName))
+    {
+        if (IndexFile::isIndexFileUpToDate(vectorFileName))
+            return;
+        throw opp_runtime_error("cannot generate index for binary vector file `%s'", vectorFileName);
+    }
+
     FileReader reader(vectorFileName);
+    reader.setMemoryMapped(true, FileReader::SEQUENTIAL);
     LineTokenizer tokenizer(1024);
     VectorFileIndex index;
     index.vectorFileName = vectorFileName;
@@ -78,6 +109,7 @@ void VectorFileIndexer::generateIndex(const char *vectorFileName, IProgressMonit
     int64 lineNo;
     int numTokens, numOfUnrecognizedLines = 0;
     VectorData *currentVectorRef = NULL;
+    VectorLineDecoder currentDecoder = NULL;
     VectorData *lastVectorDecl = NULL;
     Block currentBlock;
 
@@ -111,10 +143,32 @@ void VectorFileIndexer::generateIndex(const char *vectorFileName, IProgressMonit
                 }
             }
 
-            tokenizer.tokenize(line, reader.getCurrentLineLength());
+            int length = reader.getCurrentLineLength();
+            lineNo = reader.getNumReadLines();
+
+            // data lines are decoded directly from the buffer if possible;
+            // all other lines are tokenized
+            int vectorId;
+            const char *columns = parseVectorId(line, line + length, vectorId);
+            if (columns)
+            {
+                if (currentVectorRef == NULL || vectorId != currentVectorRef->vectorId)
+                {
+                    currentVectorRef = startBlock(index, currentVectorRef, currentBlock, vectorId, reader.getCurrentLineStartOffset(), vectorFileName, lineNo);
+                    currentDecoder = getVectorLineDecoder(currentVectorRef->columns);
+                }
+
+                Datum a;
+                if (currentDecoder && currentDecoder(columns, line + length, a))
+                {
+                    currentBlock.collect(a.eventNumber, a.xp, a.y);
+                    continue;
+                }
+            }
+
+            tokenizer.tokenize(line, length);
             numTokens = tokenizer.numTokens();
             tokens = tokenizer.tokens();
-            lineNo = reader.getNumReadLines();
 
             if (numTokens == 0 || tokens[0][0] == '#')
                 continue;
@@ -152,6 +206,7 @@ void VectorFileIndexer::generateIndex(const char *vectorFileName, IProgressMonit
                 index.addVector(vector);
                 lastVectorDecl = index.getVectorAt(index.getNumberOfVectors() - 1);
                 currentVectorRef = NULL;
+                currentDecoder = NULL;
             }
             else if (tokens[0][0] == 'v' && strcmp(tokens[0], "version") == 0)
             {
@@ -165,7 +220,6 @@ void VectorFileIndexer::generateIndex(const char *vectorFileName, IProgressMonit
             }
             else // data line
             {
-                int vectorId;
                 simultime_t simTime;
                 double value;
                 eventnumber_t eventNum = -1;
@@ -178,19 +232,8 @@ void VectorFileIndexer::generateIndex(const char *vectorFileName, IProgressMonit
 
                 if (currentVectorRef == NULL || vectorId != currentVectorRef->vectorId)
                 {
-                    if (currentVectorRef != NULL)
-                    {
-                        currentBlock.size = (int64)(reader.getCurrentLineStartOffset() - currentBlock.startOffset);
-                        if (currentBlock.size > currentVectorRef->blockSize)
-                            currentVectorRef->blockSize = currentBlock.size;
-                        currentVectorRef->addBlock(currentBlock);
-                    }
-
-                    currentBlock = Block();
-                    currentBlock.startOffset = reader.getCurrentLineStartOffset();
-                    currentVectorRef = index.getVectorById(vectorId);
-                    if (currentVectorRef == NULL)
-                        throw ResultFileFormatException("vector file indexer: missing vector declaration", vectorFileName, lineNo);
+                    currentVectorRef = startBlock(index, currentVectorRef, currentBlock, vectorId, reader.getCurrentLineStartOffset(), vectorFileName, lineNo);
+                    currentDecoder = getVectorLineDecoder(currentVectorRef->columns);
                 }
 
                 for (int i = 0; i < (int)currentVectorRef->columns.size(); ++i)
@@ -348,7 +391,7 @@ void VectorFileIndexer::rebuildVectorFile(const char *vectorFileName, IProgressM
                 dynamic_cast<IndexedVectorFileWriterNode*>(writerNodeType->create(&dataflowManager, writerAttrs));
             if (!writerNode)
                 throw opp_runtime_error("Cannot create the indexedvectorfilewriternode.");
-            writerNode->setRun(runPtr->runName.c_str(), runPtr->attributes, runPtr->moduleParams);
+            writerNode->setRun(runPtr->runName.c_str(), runPtr->attributes.toStringMap(), runPtr->moduleParams.toStringMap());
 
 
             // create a ports
@@ -133,6 +133,27 @@ void VectorFileReaderNode::process()
     {
         int64 lineNo = reader.getNumReadLines();
         int length = reader.getCurrentLineLength();
+
+        // data lines of the vectors read are decoded directly from the buffer
+        // if possible; all other lines are tokenized
+        int vectorId;
+        const char *dataColumns = parseVectorId(line, line + length, vectorId);
+        if (dataColumns)
+        {
+            Portmap::iterator portvec = ports.find(vectorId);
+            if (portvec == ports.end())
+                continue;
+
+            DecoderMap::iterator decoder = decoders.find(vectorId);
+            Datum a;
+            if (decoder != decoders.end() && decoder->second && decoder->second(dataColumns, line + length, a))
+            {
+                for (PortVector::iterator p=portvec->second.begin(); p!=portvec->second.end(); ++p)
+                    p->getChannel()->write(&a,1);
+                continue;
+            }
+        }
+
         tokenizer.tokenize(line, length);
 
         int numtokens = tokenizer.numTokens();
@@ -142,10 +163,12 @@ void VectorFileReaderNode::process()
         {
             CHECK(numtokens >= 4, "broken vector declaration");
 
-            int vectorId;
             CHECK(parseInt(vec[1], vectorId), "malformed vector in vector declaration");
             if (ports.find(vectorId) != ports.end())
+            {
                 columns[vectorId] = (numtokens < 5 || opp_isdigit(vec[4][0]) ? "TV" : vec[4]);
+                decoders[vectorId] = getVectorLineDecoder(columns[vectorId]);
+            }
         }
         else if (vec[0][0] == 'v' && strcmp(vec[0], "version") == 0)
         {
@@ -157,7 +180,6 @@ void VectorFileReaderNode::process()
         else if (numtokens>=3 && opp_isdigit(vec[0][0]))  // silently ignore incomplete lines
         {
             // extract vector id
-            int vectorId;
             CHECK(parseInt(vec[0], vectorId), "invalid vector id column");
 
             Portmap::iterator portvec = ports.find(vectorId);
@@ -36,6 +36,7 @@
 #include "commonnodes.h"
 #include "filereader.h"
 #include "linetokenizer.h"
+#include "vectorlinedecoder.h"
 #include "resultfilemanager.h"
 
 NAMESPACE_BEGIN
@@ -56,9 +57,11 @@ class SCAVE_API VectorFileReaderNode : public ReaderNode
         typedef std::map<int,PortVector> Portmap;
         typedef std::string ColumnSpec;
         typedef std::map<int,ColumnSpec> ColumnMap;
+        typedef std::map<int,VectorLineDecoder> DecoderMap;
     private:
         Portmap ports;
         ColumnMap columns;
+        DecoderMap decoders;  // specialized decoders of the vectors read, NULL if none
         LineTokenizer tokenizer;
         bool fFinished;
 
@@ -31,6 +31,7 @@
 #include "channel.h"
 #include "vectorfilewriter.h"
 #include "stringutil.h"
+#include "doubleformat.h"
 
 #define VECTOR_FILE_VERSION 2
 
@@ -47,7 +48,7 @@ USING_NAMESPACE
 VectorFileWriterNode::VectorFileWriterNode(const char *fileName, const char *fileHeader)
 {
     f = NULL;
-    this->prec = DEFAULT_PRECISION;
+    this->prec = SHORTEST_PRECISION;
     this->fileName = fileName;
     this->fileHeader = (fileHeader ? fileHeader : "");
 }
@@ -58,7 +59,7 @@ VectorFileWriterNode::~VectorFileWriterNode()
 
 Port *VectorFileWriterNode::addVector(const VectorResult &vector)
 {
-    ports.push_back(Pair(vector.vectorId, vector.moduleNameRef->c_str(), vector.nameRef->c_str(), vector.columns.c_str(), this));
+    ports.push_back(Pair(vector.vectorId, vector.moduleNameRef->c_str(), vector.nameRef->c_str(), vector.columnsRef->c_str(), this));
     return &(ports.back().port);
 }
 
@@ -99,6 +100,7 @@ void VectorFileWriterNode::process()
         int colno = columns.size();
         Datum a;
         char buf[64];
+        char xbuf[FORMATDOUBLE_BUFSIZE], ybuf[FORMATDOUBLE_BUFSIZE];
         char *endp;
 
         if (colno == 2 && columns[0] == 'T' && columns[1] == 'V')
@@ -108,11 +110,11 @@ void VectorFileWriterNode::process()
                 chan->read(&a,1);
                 if (a.xp.isNil())
                 {
-                    CHECK(fprintf(f,"%d\t%.*g\t%.*g\n", it->id, prec, a.x, prec, a.y));
+                    CHECK(fprintf(f,"%d\t%s\t%s\n", it->id, opp_formatdouble(xbuf, a.x, prec, endp), opp_formatdouble(ybuf, a.y, prec, endp)));
                 }
                 else
                 {
-                    CHECK(fprintf(f,"%d\t%s\t%.*g\n", it->id, BigDecimal::ttoa(buf, a.xp, endp), prec, a.y));
+                    CHECK(fprintf(f,"%d\t%s\t%s\n", it->id, BigDecimal::ttoa(buf, a.xp, endp), opp_formatdouble(ybuf, a.y, prec, endp)));
                 }
             }
         }
@@ -123,11 +125,11 @@ void VectorFileWriterNode::process()
                 chan->read(&a,1);
                 if (a.xp.isNil())
                 {
-                    CHECK(fprintf(f,"%d\t%"LL"d\t%.*g\t%.*g\n", it->id, a.eventNumber, prec, a.x, prec, a.y));
+                    CHECK(fprintf(f,"%d\t%"LL"d\t%s\t%s\n", it->id, a.eventNumber, opp_formatdouble(xbuf, a.x, prec, endp), opp_formatdouble(ybuf, a.y, prec, endp)));
                 }
                 else
                 {
-                    CHECK(fprintf(f,"%d\t%"LL"d\t%s\t%.*g\n", it->id, a.eventNumber, BigDecimal::ttoa(buf, a.xp, endp), prec, a.y));
+                    CHECK(fprintf(f,"%d\t%"LL"d\t%s\t%s\n", it->id, a.eventNumber, BigDecimal::ttoa(buf, a.xp, endp), opp_formatdouble(ybuf, a.y, prec, endp)));
                 }
             }
         }
@@ -145,14 +147,14 @@ void VectorFileWriterNode::process()
                     case 'T':
                         if (a.xp.isNil())
                         {
-                            CHECK(fprintf(f,"%.*g", prec, a.x));
+                            CHECK(fputs(opp_formatdouble(xbuf, a.x, prec, endp), f));
                         }
                         else
                         {
                             CHECK(fprintf(f, "%s", BigDecimal::ttoa(buf, a.xp, endp)));
                         }
                         break;
-                    case 'V': CHECK(fprintf(f,"%.*g", prec, a.y)); break;
+                    case 'V': CHECK(fputs(opp_formatdouble(ybuf, a.y, prec, endp), f)); break;
                     case 'E': CHECK(fprintf(f,"%"LL"d", a.eventNumber)); break;
                     default: throw opp_runtime_error("unknown column type: '%c' while writing %s", columns[j], fileName.c_str());
                     }
@@ -201,11 +203,11 @@ Port *VectorFileWriterNodeType::getPort(Node *node, const char *portname) const
     // vector id is used as port name
     VectorFileWriterNode *node1 = dynamic_cast<VectorFileWriterNode *>(node);
     VectorResult vector;
-    std::string moduleName = "n/a", name = "n/a";
+    std::string moduleName = "n/a", name = "n/a", columns = "TV";
     vector.vectorId = atoi(portname);  // FIXME check it's numeric at all
     vector.moduleNameRef = &moduleName;
     vector.nameRef = &name;
-    vector.columns = "TV";             // old vector file format
+    vector.columnsRef = &columns;      // old vector file format
     return node1->addVector(vector);
 }
 
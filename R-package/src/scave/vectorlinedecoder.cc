@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "numberparser.h"
+#include "vectorlinedecoder.h"
+
+NAMESPACE_BEGIN
+
+static inline bool isSeparator(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+// Skips the separators before the next column, and returns the end of the
+// column, or NULL if there are no separators or no column.
+static inline const char *nextColumn(const char *&s, const char *end)
+{
+    if (s == end || !isSeparator(*s))
+        return NULL;
+    do
+        s++;
+    while (s != end && isSeparator(*s));
+    if (s == end)
+        return NULL;
+    const char *columnEnd = s;
+    while (columnEnd != end && !isSeparator(*columnEnd))
+        columnEnd++;
+    return columnEnd;
+}
+
+// Decodes one column of the given type and advances s past it. '\0' stands
+// for no column, so that layouts of up to three columns can be expressed as
+// template arguments.
+template <char type>
+struct ColumnDecoder;
+
+template <>
+struct ColumnDecoder<'\0'>
+{
+    static bool decode(const char *&s, const char *end, Datum& a)
+    {
+        return true;
+    }
+};
+
+template <>
+struct ColumnDecoder<'E'>
+{
+    static bool decode(const char *&s, const char *end, Datum& a)
+    {
+        const char *columnEnd = nextColumn(s, end);
+        if (!columnEnd || !opp_parseint64(s, columnEnd, a.eventNumber))
+            return false;
+        s = columnEnd;
+        return true;
+    }
+};
+
+template <>
+struct ColumnDecoder<'T'>
+{
+    static bool decode(const char *&s, const char *end, Datum& a)
+    {
+        const char *columnEnd = nextColumn(s, end);
+        int64 mantissa;
+        int scale;
+        if (!columnEnd || !opp_parsedecimal(s, columnEnd, mantissa, scale))
+            return false;
+        a.xp = BigDecimal(mantissa, scale);
+        a.x = a.xp.dbl();
+        s = columnEnd;
+        return true;
+    }
+};
+
+template <>
+struct ColumnDecoder<'V'>
+{
+    static bool decode(const char *&s, const char *end, Datum& a)
+    {
+        const char *columnEnd = nextColumn(s, end);
+        if (!columnEnd || !opp_parsedouble(s, columnEnd, a.y))
+            return false;
+        s = columnEnd;
+        return true;
+    }
+};
+
+template <char c1, char c2, char c3>
+static bool decodeColumns(const char *s, const char *end, Datum& a)
+{
+    // the line terminator is not part of the last column
+    while (end != s && (end[-1] == '\n' || end[-1] == '\r'))
+        end--;
+
+    if (!ColumnDecoder<c1>::decode(s, end, a) ||
+            !ColumnDecoder<c2>::decode(s, end, a) ||
+            !ColumnDecoder<c3>::decode(s, end, a))
+        return false;
+
+    // only trailing separators may follow
+    while (s != end && isSeparator(*s))
+        s++;
+    return s == end;
+}
+
+VectorLineDecoder getVectorLineDecoder(const std::string& columns)
+{
+    if (columns == "TV")
+        return &decodeColumns<'T','V','\0'>;
+    else if (columns == "ETV")
+        return &decodeColumns<'E','T','V'>;
+    else
+        return NULL;
+}
+
+NAMESPACE_END
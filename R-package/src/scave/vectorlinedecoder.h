@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _VECTORLINEDECODER_H_
+#define _VECTORLINEDECODER_H_
+
+#include <string>
+#include "scavedefs.h"
+#include "node.h"
+
+NAMESPACE_BEGIN
+
+/**
+ * Decodes the columns of a data line of an output vector file into a Datum,
+ * directly from the line buffer, without tokenizing the line. s points
+ * to the separator after the vector id (see parseVectorId()), end to the
+ * end of the line, which may include the line terminator; the line does
+ * not need to be zero-terminated.
+ *
+ * A decoder returns false if the line is not in the plain form it handles
+ * (missing or extra columns, quoted tokens, special values, exponents in the
+ * simulation time, etc.). The line must then be tokenized and parsed with
+ * parseColumns(), which also reports the errors.
+ */
+typedef bool (*VectorLineDecoder)(const char *s, const char *end, Datum& a);
+
+/**
+ * Returns the decoder specialized for the given column layout ("TV" or
+ * "ETV"), or NULL if the layout has no specialized decoder. Readers look up
+ * the decoder once per vector.
+ */
+SCAVE_API VectorLineDecoder getVectorLineDecoder(const std::string& columns);
+
+/**
+ * Parses the vector id at the start of a data line. Returns a pointer to the
+ * separator following the id, or NULL if the line does not start with a
+ * plain vector id and a separator.
+ */
+inline const char *parseVectorId(const char *s, const char *end, int& vectorId)
+{
+    const char *p = s;
+    int id = 0;
+    while (p != end && (unsigned char)(*p - '0') < 10)
+    {
+        if (p - s == 9)
+            return NULL;
+        id = id * 10 + (*p++ - '0');
+    }
+    if (p == s || p == end || (*p != ' ' && *p != '\t'))
+        return NULL;
+    vectorId = id;
+    return p;
+}
+
+NAMESPACE_END
+
+
+#endif
@@ -60,6 +60,20 @@ class IOutputScalarManager : public IResultManager
     virtual void recordScalar(const char *componentPath, const char *statisticName, double value,
                               StringMap attributes) = 0;
 
+    /**
+     * Records several numeric scalar results at once; the ith one is recorded
+     * with componentPaths[i], statisticNames[i] and values[i]. This is more
+     * efficient than calling recordScalar() for each of them.
+     *
+     * @param attributes  array of the attributes of the scalars; may be null.
+     */
+    virtual void recordScalars(const char **componentPaths, const char **statisticNames, const double *values,
+                               int count, const StringMap *attributes = NULL)
+    {
+        for (int i = 0; i < count; i++)
+            recordScalar(componentPaths[i], statisticNames[i], values[i], attributes ? attributes[i] : StringMap());
+    }
+
     /**
      * Records a histogram or statistic object. If the object additionally implements
      * the IStatisticalSummary2 and/or IHistogramSummary interfaces, more data are recorded.
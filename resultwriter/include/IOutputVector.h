@@ -28,6 +28,8 @@
 #ifndef __IOUTPUTVECTOR_H
 #define __IOUTPUTVECTOR_H
 
+#include <stdlib.h>
+
 /**
  * An output vector. Output vectors should not be instantiated directly;
  * instances should be obtained from an IOutputVectorManager.
@@ -74,6 +76,23 @@ class IOutputVector
      * Values MUST be recorded increasing timestamp order.
      */
     virtual bool record(double time, double value) = 0;
+
+    /**
+     * Record n values with the given time stamps into the output vector.
+     * This is equivalent to calling record(times[i], values[i]) for each
+     * of them, but it is more efficient. Returns the number of values
+     * actually recorded.
+     *
+     * Values MUST be recorded increasing timestamp order.
+     */
+    virtual size_t recordBatch(const double *times, const double *values, size_t n)
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < n; i++)
+            if (record(times[i], values[i]))
+                count++;
+        return count;
+    }
 };
 
 #endif
@@ -167,6 +167,24 @@ static const std::string ATTR_MIN = "min";
  */
 static const std::string ATTR_MAX = "max";
 
+/**
+ * Vector attribute: data reduction to apply while recording, as a chain of
+ * filters separated by whitespace, each applied to the output of the previous
+ * one. Example: <code>"timewindow(100,200) deadband(0.5) average(1)"</code>.
+ * Available filters:
+ *  - <code>decimate(n)</code>: keeps every nth value;
+ *  - <code>average(interval)</code>: the mean of the values in each interval
+ *    (with the timestamp of its last value);
+ *  - <code>envelope(interval)</code>: the minimum and the maximum in each interval;
+ *  - <code>deadband(delta)</code>: only values that differ from the last kept
+ *    one by more than delta;
+ *  - <code>changes</code>: only values that differ from the previous one;
+ *  - <code>timewindow(start,end)</code>: only values recorded between start and
+ *    end (inclusive); end may be omitted.
+ * Intervals are aligned to multiples of the interval length.
+ */
+static const std::string ATTR_FILTER = "filter";
+
 // values for ATTR_TYPE
 static const std::string TYPE_INT = "int";
 static const std::string TYPE_DOUBLE = "double";
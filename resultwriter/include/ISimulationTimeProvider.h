@@ -41,6 +41,11 @@
 class ISimulationTimeProvider
 {
   public:
+    /**
+     * Virtual destructor.
+     */
+    virtual ~ISimulationTimeProvider() {}
+
     /**
      * Returns the current simulation time.
      */
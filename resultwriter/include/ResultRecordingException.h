@@ -43,6 +43,7 @@ class ResultRecordingException : public std::exception
 
   public:
     ResultRecordingException(const char *message) {this->message = message;}
+    ResultRecordingException(const std::string& message) {this->message = message;}
 
     /**
      * Destructor with throw clause required by gcc.
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <exception>
+#include "AsyncWriter.h"
+#include "ResultRecordingException.h"
+
+using namespace std;
+
+// atomic reads of the variables shared with producers (full barriers, like the other __sync builtins)
+template <typename T> static inline T atomicRead(T volatile *p)
+{
+    return __sync_val_compare_and_swap(p, (T)0, (T)0);
+}
+
+AsyncWriter::AsyncWriter(int maxQueueLength)
+{
+    this->maxQueueLength = maxQueueLength < 1 ? 1 : maxQueueLength;
+    head = NULL;
+    queueLength = 0;
+    stopping = false;
+    failed = 0;
+
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&workAvailable, NULL);
+    pthread_cond_init(&queueChanged, NULL);
+    if (pthread_create(&thread, NULL, threadMain, this) != 0)
+    {
+        pthread_cond_destroy(&queueChanged);
+        pthread_cond_destroy(&workAvailable);
+        pthread_mutex_destroy(&mutex);
+        throw ResultRecordingException("Cannot start writer thread");
+    }
+}
+
+AsyncWriter::~AsyncWriter()
+{
+    pthread_mutex_lock(&mutex);
+    stopping = true;
+    pthread_cond_signal(&workAvailable);
+    pthread_mutex_unlock(&mutex);
+
+    pthread_join(thread, NULL);
+
+    pthread_cond_destroy(&queueChanged);
+    pthread_cond_destroy(&workAvailable);
+    pthread_mutex_destroy(&mutex);
+}
+
+void AsyncWriter::submit(Task *task)
+{
+    // backpressure: wait for the writer if the queue is full
+    if (atomicRead(&queueLength) >= maxQueueLength)
+    {
+        pthread_mutex_lock(&mutex);
+        while (!atomicRead(&failed) && atomicRead(&queueLength) >= maxQueueLength)
+            pthread_cond_wait(&queueChanged, &mutex);
+        pthread_mutex_unlock(&mutex);
+    }
+
+    if (atomicRead(&failed))
+    {
+        delete task;
+        checkError();
+    }
+
+    __sync_fetch_and_add(&queueLength, 1);
+
+    Task *oldHead;
+    do {
+        oldHead = atomicRead(&head);
+        task->next = oldHead;
+    } while (!__sync_bool_compare_and_swap(&head, oldHead, task));
+
+    // the writer only sleeps when it found the list empty, so wake it up if it was
+    if (oldHead == NULL)
+    {
+        pthread_mutex_lock(&mutex);
+        pthread_cond_signal(&workAvailable);
+        pthread_mutex_unlock(&mutex);
+    }
+}
+
+void AsyncWriter::drain()
+{
+    pthread_mutex_lock(&mutex);
+    while (atomicRead(&queueLength) > 0)
+        pthread_cond_wait(&queueChanged, &mutex);
+    pthread_mutex_unlock(&mutex);
+    checkError();
+}
+
+void AsyncWriter::checkError()
+{
+    pthread_mutex_lock(&mutex);
+    bool hasFailed = atomicRead(&failed) != 0;
+    string message = errorMessage;
+    pthread_mutex_unlock(&mutex);
+
+    if (hasFailed)
+        throw ResultRecordingException(message);
+}
+
+void *AsyncWriter::threadMain(void *arg)
+{
+    ((AsyncWriter *)arg)->run();
+    return NULL;
+}
+
+void AsyncWriter::taskDone()
+{
+    pthread_mutex_lock(&mutex);
+    __sync_fetch_and_sub(&queueLength, 1);
+    pthread_cond_broadcast(&queueChanged);  // wake up producers waiting for space, and drain()
+    pthread_mutex_unlock(&mutex);
+}
+
+void AsyncWriter::run()
+{
+    while (true)
+    {
+        pthread_mutex_lock(&mutex);
+        while (atomicRead(&head) == NULL && !stopping)
+            pthread_cond_wait(&workAvailable, &mutex);
+        bool finished = atomicRead(&head) == NULL;  // stopping, and nothing left to do
+        pthread_mutex_unlock(&mutex);
+        if (finished)
+            break;
+
+        // take all submitted tasks at once, and restore submission order
+        Task *list = __sync_lock_test_and_set(&head, (Task *)NULL);
+        Task *ordered = NULL;
+        while (list)
+        {
+            Task *next = list->next;
+            list->next = ordered;
+            ordered = list;
+            list = next;
+        }
+
+        while (ordered)
+        {
+            Task *task = ordered;
+            ordered = task->next;
+
+            if (!atomicRead(&failed))
+            {
+                // after an error, the rest is discarded: it would most likely fail as well
+                try
+                {
+                    task->execute();
+                }
+                catch (exception& e)
+                {
+                    pthread_mutex_lock(&mutex);
+                    errorMessage = e.what();
+                    __sync_lock_test_and_set(&failed, 1);
+                    pthread_mutex_unlock(&mutex);
+                }
+            }
+            delete task;
+            taskDone();
+        }
+    }
+}
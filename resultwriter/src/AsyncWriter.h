@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ASYNCWRITER_H
+#define __ASYNCWRITER_H
+
+#include <pthread.h>
+#include <string>
+
+/**
+ * Executes write operations on a dedicated background thread, so that the
+ * thread doing the recording never blocks on file I/O. Tasks are executed
+ * in the order they were submitted. The queue is bounded: submit() blocks
+ * while the queue is full, so a writer thread that falls behind slows down
+ * the recording instead of letting memory usage grow without limits.
+ *
+ * submit() may be called from several threads at the same time. Tasks are
+ * pushed onto a lock-free list with compare-and-swap, so producers do not
+ * contend on a lock unless they have to wait for the writer; tasks
+ * submitted by the same thread are executed in their submission order.
+ *
+ * If a task throws an exception, the remaining tasks are discarded and the
+ * error is reported by the next submit() or drain() call as a
+ * ResultRecordingException.
+ *
+ * @author Andras
+ */
+class AsyncWriter
+{
+  public:
+    /**
+     * A unit of work for the writer thread. The writer deletes the task
+     * after it has been executed (or discarded).
+     */
+    class Task
+    {
+      private:
+        friend class AsyncWriter;
+        Task *next;  // link in the queue
+
+      public:
+        Task() : next(NULL) {}
+        virtual ~Task() {}
+        virtual void execute() = 0;
+    };
+
+    static const int DEFAULT_QUEUE_LENGTH = 64;
+
+  protected:
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t workAvailable;   // signalled when the queue becomes non-empty
+    pthread_cond_t queueChanged;    // signalled when a task has been executed
+    Task *volatile head;            // submitted tasks, most recent first
+    volatile int queueLength;       // submitted but not yet executed tasks
+    int maxQueueLength;
+    bool stopping;
+    volatile int failed;
+    std::string errorMessage;
+
+  public:
+    /**
+     * Starts the writer thread. At most maxQueueLength tasks may be
+     * waiting for execution.
+     */
+    AsyncWriter(int maxQueueLength = DEFAULT_QUEUE_LENGTH);
+
+    /**
+     * Executes the remaining tasks and stops the writer thread. Errors
+     * are not reported from here; call drain() before if they matter.
+     */
+    ~AsyncWriter();
+
+    /**
+     * Appends a task to the queue; blocks while the queue is full.
+     * Takes ownership of the task.
+     */
+    void submit(Task *task);
+
+    /**
+     * Waits until all submitted tasks have been executed. After it returns,
+     * the caller may touch the data the tasks were working on.
+     */
+    void drain();
+
+  protected:
+    static void *threadMain(void *arg);
+    void run();
+    void taskDone();
+    void checkError();
+};
+
+#endif
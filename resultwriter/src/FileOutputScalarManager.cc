@@ -27,36 +27,121 @@
 
 #include <string>
 #include <stdio.h>
+#include <string.h>
 #include "FileOutputScalarManager.h"
 #include "OutputFileManager.h"
 #include "ResultRecordingException.h"
 
 using namespace std;
 
+// quantiles recorded for IQuantileSummary statistics
+static const struct { const char *name; double p; } QUANTILES[] = {
+    {"p50", 0.5}, {"p90", 0.9}, {"p95", 0.95}, {"p99", 0.99}, {NULL, 0}
+};
+
+/**
+ * Writes out a chunk of formatted results on the writer thread of an
+ * asynchronous FileOutputScalarManager.
+ */
+class ScalarWriteTask : public AsyncWriter::Task
+{
+  protected:
+    FileOutputScalarManager *manager;
+    std::string text;
+
+  public:
+    ScalarWriteTask(FileOutputScalarManager *manager, const std::string& text)
+    {
+        this->manager = manager;
+        this->text = text;
+    }
+
+    void execute()
+    {
+        if (!manager->out->is_open())
+            manager->open();
+        manager->out->write(text.data(), text.size());
+        if (!manager->out->good())
+            throw ResultRecordingException("Cannot write output scalar file ");
+    }
+};
+
 FileOutputScalarManager::FileOutputScalarManager()
 {
+    out = NULL;
+    asyncWriter = NULL;
+    buffered = false;
+    statisticsOffset = -1;
 }
 
 FileOutputScalarManager::~FileOutputScalarManager()
 {
+    delete asyncWriter;
+    delete out;
 }
 
-FileOutputScalarManager::FileOutputScalarManager(string fileName)
+FileOutputScalarManager::FileOutputScalarManager(const char *fileName)
 {
     //FIXME TODO remove file if exists
     //if (unlink(fileName.c_str())!=0
     this->fileName = fileName;
-    out = new ofstream(fileName.c_str());
-
-
-    if (!out->is_open()){
+    asyncWriter = NULL;
+    buffered = false;
+    statisticsOffset = -1;
+    out = new OutputFile();
+    try
+    {
+        out->open(fileName);
+    }
+    catch(exception& e)
+    {
         throw ResultRecordingException("Cannot create output file");
     }
     out->close();
 
 }
 
-void FileOutputScalarManager::open(string runID, stringMap runAttributes)
+bool FileOutputScalarManager::isAsync()
+{
+    return asyncWriter != NULL;
+}
+
+void FileOutputScalarManager::setAsync(bool async, int maxQueueLength)
+{
+    if (asyncWriter)
+    {
+        // hand over what has been recorded so far to the current writer, and wait for it
+        submitPending();
+        AsyncWriter *writer = asyncWriter;
+        asyncWriter = NULL;
+        try
+        {
+            writer->drain();
+        }
+        catch (...)
+        {
+            delete writer;
+            throw;
+        }
+        delete writer;
+    }
+    if (async)
+        asyncWriter = new AsyncWriter(maxQueueLength);
+}
+
+bool FileOutputScalarManager::isBuffered()
+{
+    return buffered;
+}
+
+void FileOutputScalarManager::setBuffered(bool buffered)
+{
+    if (this->buffered && !buffered)
+        writePending();
+    this->buffered = buffered;
+}
+
+void FileOutputScalarManager::open(const char *runID, const StringMap& runAttributes)
 {
     this->runID = runID;
     this->runAttributes = runAttributes;
@@ -64,82 +149,189 @@ void FileOutputScalarManager::open(string runID, stringMap runAttributes)
 
 void FileOutputScalarManager::open()
 {
-    try
-    {
-        out->open(this->getFileName().c_str());
-    }
-    catch(exception e)
-    {
-        throw ResultRecordingException("Cannot open output scalar file ");
-    }
+    out->setBufferSize(fileBufferSize);
+    out->setPreallocationSize(preallocationSize);
+    out->open(this->getFileName());
 
-    *out << "version " << FILE_VERSION << endl << endl;
+    *out << "version " << FILE_VERSION << "\n\n";
 
-    writeRunHeader(out, runID, runAttributes);
+    statisticsOffset = writeRunHeader(out, runID, runAttributes);
     flushAndCheck();
 }
 
 void FileOutputScalarManager::close()
 {
+    writePending();
+    if (asyncWriter)
+        asyncWriter->drain();
+
     if (out->is_open())
     {
         flushAndCheck();
+        if (statisticsOffset != -1)
+            updateStatisticsAttributes(out, statisticsOffset, getStatistics());
         out->close();
+        if (out->bad())
+            throw ResultRecordingException("Cannot write output scalar file ");
     }
 }
 
 void FileOutputScalarManager::flush()
 {
+    writePending();
+    if (asyncWriter)
+        asyncWriter->drain();
+
     if (out->is_open())
         flushAndCheck();
+}
 
+void FileOutputScalarManager::sync()
+{
+    flush();
+
+    if (out->is_open())
+        out->sync();
 }
 
 void FileOutputScalarManager::flushAndCheck()
 {
+    double startTime = getTime();
     out->flush();
     if (!out->good())
         throw ResultRecordingException("Cannot write output scalar file ");
+
+    pthread_mutex_lock(&statisticsMutex);
+    statistics.flushTime += getTime() - startTime;
+    statistics.bytes = out->tell();
+    pthread_mutex_unlock(&statisticsMutex);
+}
+
+void FileOutputScalarManager::countResults(int count)
+{
+    pthread_mutex_lock(&statisticsMutex);
+    statistics.samples += count;
+    pthread_mutex_unlock(&statisticsMutex);
 }
 
-string FileOutputScalarManager::getFileName()
+const char *FileOutputScalarManager::getStatisticsPrefix()
 {
-    return fileName;
+    return "scalarwriter.";
 }
 
-void FileOutputScalarManager::recordScalar(string componentPath, string name, double value,
-                                           stringMap attributes)
+const char *FileOutputScalarManager::getFileName()
 {
+    return fileName.c_str();
+}
+
+std::ostream *FileOutputScalarManager::beginRecord()
+{
+    if (asyncWriter || buffered)
+        return &pending;
+
     if (!out->is_open())
         open();
-    *out << "scalar " << q(componentPath) << " " << q(name) << " " << value << endl;
-    writeAttributes(out, &attributes);
+    return out;
 }
 
-void FileOutputScalarManager::recordStatistic(string componentPath, string name, IStatisticalSummary* statistic, stringMap attributes)
+void FileOutputScalarManager::endRecord()
 {
-    if (!out)
-        open();
+    if (asyncWriter && !buffered && pending.tellp() >= ASYNC_CHUNK_SIZE)
+        submitPending();
+}
+
+void FileOutputScalarManager::submitPending()
+{
+    if (pending.tellp() > 0)
+    {
+        asyncWriter->submit(new ScalarWriteTask(this, pending.str()));
+        pending.str("");
+    }
+}
+
+void FileOutputScalarManager::writePending()
+{
+    if (asyncWriter)
+        submitPending();
+    else if (pending.tellp() > 0)
+    {
+        if (!out->is_open())
+            open();
+        std::string text = pending.str();
+        pending.str("");
+        out->write(text.data(), text.size());
+        if (!out->good())
+            throw ResultRecordingException("Cannot write output scalar file ");
+    }
+}
+
+void FileOutputScalarManager::recordScalar(const char *componentPath, const char *name, double value,
+                                           StringMap attributes)
+{
+    std::ostream *out = beginRecord();
+    writeScalar(out, componentPath, name, value, &attributes);
+    endRecord();
+    countResults(1);
+}
 
-    *out << "statistic " << q(componentPath) << " " << q(name) << endl;
-    writeField("count", statistic->getN());
-    writeField("mean", statistic->getMean());
-    writeField("stddev", statistic->getStandardDeviation());
-    writeField("sum", statistic->getSum());
-    writeField("sqrsum", statistic->getSqrSum());
-    writeField("min", statistic->getMin());
-    writeField("max", statistic->getMax());
+void FileOutputScalarManager::recordScalars(const char **componentPaths, const char **names, const double *values,
+                                            int count, const StringMap *attributes)
+{
+    std::ostream *out = beginRecord();
+    for (int i = 0; i < count; i++)
+        writeScalar(out, componentPaths[i], names[i], values[i], attributes ? &attributes[i] : NULL);
+    endRecord();
+    countResults(count);
+}
+
+void FileOutputScalarManager::writeScalar(std::ostream *out, const char *componentPath, const char *name, double value,
+                                          const StringMap *attributes)
+{
+    char buf[NUMBER_BUFSIZE];
+    formatDouble(buf, value);
+
+    out->write("scalar ", 7);
+    writeQuoted(out, componentPath);
+    out->put(' ');
+    writeQuoted(out, name);
+    out->put(' ');
+    out->write(buf, strlen(buf));
+    out->put('\n');
+    if (attributes)
+        writeAttributes(out, attributes);
+}
+
+void FileOutputScalarManager::recordStatistic(const char *componentPath, const char *name, IStatisticalSummary* statistic, StringMap attributes)
+{
+    std::ostream *out = beginRecord();
+
+    *out << "statistic " << q(componentPath) << " " << q(name) << "\n";
+    writeField(out, "count", statistic->getN());
+    writeField(out, "mean", statistic->getMean());
+    writeField(out, "stddev", statistic->getStandardDeviation());
+    writeField(out, "sum", statistic->getSum());
+    writeField(out, "sqrsum", statistic->getSqrSum());
+    writeField(out, "min", statistic->getMin());
+    writeField(out, "max", statistic->getMax());
 
     writeAttributes(out, &attributes);
 
-    if (dynamic_cast<IStatisticalSummary2 *>(statistic))
+    if (dynamic_cast<IStatisticalSummary2 *>(statistic) && static_cast<IStatisticalSummary2 *>(statistic)->isWeighted())
     {
         IStatisticalSummary2 *statistic2 = static_cast<IStatisticalSummary2 *>(statistic);
 
-        writeField("weights", statistic2->getWeights());
-        writeField("weightedSum", statistic2->getWeightedSum());
-        writeField("sqrSumWeights", statistic2->getSqrSumWeights());
-        writeField("weightedSqrSum", statistic2->getWeightedSqrSum());
+        writeField(out, "weights", statistic2->getWeights());
+        writeField(out, "weightedSum", statistic2->getWeightedSum());
+        writeField(out, "sqrSumWeights", statistic2->getSqrSumWeights());
+        writeField(out, "weightedSqrSum", statistic2->getWeightedSqrSum());
+    }
+
+    if (dynamic_cast<IQuantileSummary *>(statistic))
+    {
+        IQuantileSummary *statistic2 = static_cast<IQuantileSummary *>(statistic);
+
+        for (int i = 0; QUANTILES[i].name; i++)
+            writeField(out, QUANTILES[i].name, statistic2->getQuantile(QUANTILES[i].p));
     }
 
     if (dynamic_cast<IHistogramSummary *>(statistic))
@@ -149,16 +341,29 @@ void FileOutputScalarManager::recordStatistic(string componentPath, string name,
         int n = statistic2->getNumCells();
         if (n > 0)
         {
-            *out << "bin -INF " << statistic2->getUnderflowCell() << endl;
+            char buf1[NUMBER_BUFSIZE], buf2[NUMBER_BUFSIZE];
+            *out << "bin -INF " << statistic2->getUnderflowCell() << "\n";
             for (int i = 0; i < n; i++)
-                *out << "bin " << statistic2->getCellBoundary(i) << " " << statistic2->getCellValue(i) << endl;
-            *out << "bin " << statistic2->getCellBoundary(n) << statistic2->getOverflowCell() << endl;
+            {
+                formatDouble(buf1, statistic2->getCellBoundary(i));
+                formatDouble(buf2, statistic2->getCellValue(i));
+                *out << "bin " << buf1 << " " << buf2 << "\n";
+            }
+            formatDouble(buf1, statistic2->getCellBoundary(n));
+            *out << "bin " << buf1 << " " << statistic2->getOverflowCell() << "\n";
         }
     }
+
+    endRecord();
+    countResults(1);
 }
 
-void FileOutputScalarManager::writeField(string name, double value)
+void FileOutputScalarManager::writeField(std::ostream *out, const char *name, double value)
 {
-    if (isNaN(value))
-        *out << "field " << q(name) << " " << value << endl;
+    if (!isNaN(value))
+    {
+        char buf[NUMBER_BUFSIZE];
+        formatDouble(buf, value);
+        *out << "field " << q(name) << " " << buf << "\n";
+    }
 }
@@ -35,6 +35,8 @@
 #include "IOutputScalarManager.h"
 #include "IStatisticalSummary2.h"
 #include "IHistogramSummary.h"
+#include "IQuantileSummary.h"
+#include "AsyncWriter.h"
 
 /**
  * An output scalar manager that writes OMNeT++ scalar (".sca") files.
@@ -42,18 +44,36 @@
  * This class does not support filtering (of scalars or recorded data),
  * this functionality may be added via subclasses.
  *
+ * Output is buffered in a large user-space buffer (see setFileBufferSize()),
+ * and written to the file when the buffer fills up and at flush().
+ *
+ * In asynchronous mode (see setAsync()), results are formatted into memory,
+ * and written to the file by a background thread in ASYNC_CHUNK_SIZE chunks.
+ * flush() and close() wait until everything has been written.
+ *
+ * In buffered mode (see setBuffered()), all results are formatted into memory,
+ * and only written to the file (in a single write) at flush() and close().
+ * This is the fastest way of dumping many results at the end of a run.
+ *
  * @author Andras
  */
 class FileOutputScalarManager : public OutputFileManager, public IOutputScalarManager
 {
   public:
     static const int FILE_VERSION = 2;
+    static const int ASYNC_CHUNK_SIZE = 64 * 1024;
+    friend class ScalarWriteTask;
 
   protected:
     std::string runID;
     StringMap runAttributes;
     std::string fileName;
-    std::ofstream *out;
+    OutputFile *out;
+
+    AsyncWriter *asyncWriter;       // non-NULL in asynchronous mode
+    bool buffered;
+    long statisticsOffset;          // of the statistics attributes in the file, or -1
+    std::ostringstream pending;     // results not yet written or handed to the writer thread
 
   public:
     FileOutputScalarManager();
@@ -61,7 +81,23 @@ class FileOutputScalarManager : public OutputFileManager, public IOutputScalarMa
 
     ~FileOutputScalarManager();
 
-    void open(const char *runID, StringMap runAttributes);
+    bool isAsync();
+
+    /**
+     * Turns asynchronous writing on or off. When maxQueueLength chunks are
+     * waiting for the writer thread, recording blocks until it catches up.
+     */
+    void setAsync(bool async, int maxQueueLength = AsyncWriter::DEFAULT_QUEUE_LENGTH);
+
+    bool isBuffered();
+
+    /**
+     * Turns buffered mode on or off. In buffered mode, results are kept
+     * in memory until flush() or close().
+     */
+    void setBuffered(bool buffered);
+
+    void open(const char *runID, const StringMap& runAttributes);
 
     void close();
 
@@ -70,17 +106,40 @@ class FileOutputScalarManager : public OutputFileManager, public IOutputScalarMa
     void recordScalar(const char *componentPath, const char *name, double value,
                       StringMap attributes);
 
+    void recordScalars(const char **componentPaths, const char **names, const double *values,
+                       int count, const StringMap *attributes = NULL);
+
     void recordStatistic(const char *componentPath, const char *name, IStatisticalSummary *statistic, StringMap attributes);
 
     void flush();
 
+    /**
+     * Like flush(), but also waits until the data has been stored on disk.
+     */
+    void sync();
+
   protected:
 
     void open();
 
     void flushAndCheck();
 
-    void writeField(const char *name, double value);
+    std::ostream *beginRecord();
+
+    void endRecord();
+
+    void submitPending();
+
+    void writePending();
+
+    const char *getStatisticsPrefix();
+
+    void countResults(int count);
+
+    void writeScalar(std::ostream *out, const char *componentPath, const char *name, double value,
+                     const StringMap *attributes);
+
+    void writeField(std::ostream *out, const char *name, double value);
 };
 
 #endif
@@ -26,59 +26,118 @@
  */
 
 #include <sstream>
+#include <algorithm>
 #include <exception>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <zlib.h>
 #include "FileOutputVectorManager.h"
 #include "OutputFileManager.h"
 #include "ResultRecordingException.h"
+#include "IResultAttributes.h"
 
 static double zero = 0.0;
 double const NaN = zero / zero;
 
+const char FileOutputVectorManager::BINARY_MAGIC[] = "OMNETVEC";
+
 using namespace std;
 
-OutputVector::OutputVector(int id, const string&componentPath, const string&vectorName, StringMap& attributes)
+// binary files are little-endian, whatever the host byte order is
+static inline char *putUInt32(char *p, uint32_t x)
+{
+    for (int i = 0; i < 4; i++)
+        *p++ = (char)(x >> (8 * i));
+    return p;
+}
+
+static inline char *putDouble(char *p, double d)
+{
+    uint64_t x;
+    memcpy(&x, &d, sizeof(x));
+    for (int i = 0; i < 8; i++)
+        *p++ = (char)(x >> (8 * i));
+    return p;
+}
+
+// byte k of the double goes to p[k*stride]
+static inline void putShuffledDouble(unsigned char *p, int stride, double d)
+{
+    uint64_t x;
+    memcpy(&x, &d, sizeof(x));
+    for (int k = 0; k < 8; k++, x >>= 8)
+        p[k * stride] = (unsigned char)x;
+}
+
+OutputVector::OutputVector(int id, const string& componentPath, const string& vectorName, const StringMap& attributes)
 {
     blockStartTime = 0;
     blockEndTime = 0;
     n = 0;
+    firstChunk = NULL;
+    lastChunk = NULL;
     min = NaN;
     max = NaN;
     sum = 0;
     sqrSum = 0;
+    lastRecorded = 0;
+    filter = NULL;
+    stored = false;
+    slot = -1;
+    dirtySlot = -1;
+    shard = NULL;
     this->id = id;
 
     // postpone writing out vector declaration until there's actually something to record
-    ostringstream *outstream = new ostringstream();
-    *outstream << "vector " << id << " " << OutputFileManager::q(componentPath) << " " << OutputFileManager::q(vectorName) << " TV" << endl;
+    ostringstream outstream;
+    outstream << "vector " << id << " " << OutputFileManager::q(componentPath) << " " << OutputFileManager::q(vectorName) << " TV" << "\n";
 
-    OutputFileManager::writeAttributes(outstream, &attributes);
-    header = outstream->str();
+    OutputFileManager::writeAttributes(&outstream, &attributes);
+    header = outstream.str();
 }
 
-OutputVector::~OutputVector()
+/**
+ * Last element of the filter chain of a vector: stores the data in the vector.
+ */
+class VectorStoreFilter : public VectorFilter
 {
-}
+  protected:
+    OutputVector *vector;
+
+  public:
+    VectorStoreFilter(OutputVector *vector) {this->vector = vector;}
+    void process(double time, double value) {vector->store(time, value);}
+};
 
-void OutputVector::writeVectorHeader() throw()
+OutputVector::~OutputVector()
 {
-    if (!fileOutputVector->out->is_open())
-        fileOutputVector->open();
-    *(fileOutputVector->out) << header;
-    *(fileOutputVector->indexOut) << header;
-    header.clear();
+    delete filter;
+    fileOutputVector->chunkPool.release(firstChunk);
 }
 
 void OutputVector::close()
 {
-    fileOutputVector->flush();
-    vector<OutputVector*>::iterator iter;
-    for (iter = fileOutputVector->vectors.begin(); iter != fileOutputVector->vectors.end(); ++iter)
+    // emit data held back by the filters
+    if (filter)
+        filter->finish();
+
+    writeBlock();
+
+    // remove from the manager; the last vector takes over our slot
+    pthread_mutex_lock(&fileOutputVector->vectorsMutex);
+    vector<OutputVector*>& vectors = fileOutputVector->vectors;
+    if (slot != -1)
     {
-        if ((*iter)->id == this->id)
-        {
-            fileOutputVector->vectors.erase(iter);
-        }
+        OutputVector *last = vectors.back();
+        vectors[slot] = last;
+        last->slot = slot;
+        vectors.pop_back();
+        slot = -1;
     }
+    pthread_mutex_unlock(&fileOutputVector->vectorsMutex);
 
     id = -1;                    // i.e. dead object
 }
@@ -96,7 +155,7 @@ bool OutputVector::record(double value)
     if (!fileOutputVector->simtimeProvider)
         throw ResultRecordingException("Simtime provider not yet specified");
 
-    return record(fileOutputVector->simtimeProvider->getSimulationTime(), value);
+    return OutputVector::record(fileOutputVector->simtimeProvider->getSimulationTime(), value);
 }
 
 bool OutputVector::record(double time, double value)
@@ -110,11 +169,29 @@ bool OutputVector::record(double time, double value)
         throw
             ResultRecordingException("Vector data must be recorded in increasing timestamp order");
 
-    // store
-    times.push_back(time);
-    values.push_back(value);
+    if (filter)
+    {
+        stored = false;
+        filter->process(time, value);
+        return stored;
+    }
+
+    store(time, value);
+    return true;
+}
+
+void OutputVector::store(double time, double value)
+{
+    if (!lastChunk || lastChunk->n == VectorChunk::CAPACITY)
+        addChunk();
+    lastChunk->times[lastChunk->n] = time;
+    lastChunk->values[lastChunk->n] = value;
+    lastChunk->n++;
     if (n == 0)
+    {
         blockStartTime = time;
+        fileOutputVector->addDirty(this);
+    }
     blockEndTime = time;
     n++;
 
@@ -126,102 +203,279 @@ bool OutputVector::record(double time, double value)
     sum += value;
     sqrSum += value * value;
 
-    ++fileOutputVector->nbuffered;
+    if (!fileOutputVector->concurrent)
+    {
+        lastRecorded = ++fileOutputVector->recordCount;
+        fileOutputVector->bufferedBytes += BYTES_PER_SAMPLE;
+    }
+    else
+        __atomic_fetch_add(&fileOutputVector->bufferedBytes, (size_t)BYTES_PER_SAMPLE, __ATOMIC_RELAXED);
 
     // flush if needed
     fileOutputVector->changed(this);
 
-    return false;
+    stored = true;
 }
 
-void OutputVector::writeBlock()
+size_t OutputVector::recordBatch(const double *times, const double *values, size_t n)
 {
-    try
+    if (id == -1)
+        throw
+            ResultRecordingException("Attempt to write to an output vector that's already closed");
+
+    if (n == 0)
+        return 0;
+
+    if (times[0] < blockEndTime)
+        throw
+            ResultRecordingException("Vector data must be recorded in increasing timestamp order");
+    for (size_t i = 1; i < n; i++)
+        if (times[i] < times[i-1])
+            throw
+                ResultRecordingException("Vector data must be recorded in increasing timestamp order");
+
+    if (filter)
     {
-        // write out vector declaration if not yet done
-        if (!header.empty())
-            writeVectorHeader();
+        size_t count = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            stored = false;
+            filter->process(times[i], values[i]);
+            if (stored)
+                count++;
+        }
+        return count;
+    }
 
-        // write data
-        long blockOffset = fileOutputVector->out->tellp();
-        for (int i = 0; i < n; i++)
-            *(fileOutputVector->
-              out) << id << " " << (float) times[i] << " " << (float) values[i] << endl;
+    storeBatch(times, values, n);
+    return n;
+}
 
-        // make sure that the offsets referred   to by the index file are exists in the vector file
-        // so the index can be used to access the vector file while it is being written
-        fileOutputVector->out->flush();
-        if (!fileOutputVector->out->good())
-            throw ResultRecordingException("Cannot write output vector file");
+void OutputVector::storeBatch(const double *times, const double *values, size_t count)
+{
+    // store the data in segments; a segment ends where record() would write
+    // out a block, or check the memory budget, so the output is the same
+    while (count > 0)
+    {
+        if (!lastChunk || lastChunk->n == VectorChunk::CAPACITY)
+            addChunk();
+        size_t k = VectorChunk::CAPACITY - lastChunk->n;
+        if (k > count)
+            k = count;
+        int untilLimit = fileOutputVector->perVectorLimit - n + 1;
+        if (untilLimit < 1)
+            untilLimit = 1;
+        if (k > (size_t)untilLimit)
+            k = untilLimit;
+        if (!fileOutputVector->concurrent && fileOutputVector->bufferedBytes > fileOutputVector->memoryBudget)
+            k = 1;
 
-        long blockSize = (long) (fileOutputVector->out->tellp()) - blockOffset;
+        memcpy(lastChunk->times + lastChunk->n, times, k * sizeof(double));
+        memcpy(lastChunk->values + lastChunk->n, values, k * sizeof(double));
+        lastChunk->n += k;
+        if (n == 0)
+        {
+            blockStartTime = times[0];
+            fileOutputVector->addDirty(this);
+        }
+        blockEndTime = times[k-1];
+        n += k;
 
-        // write index
-        *(fileOutputVector->indexOut) << id << " " << blockOffset << " " << blockSize << " " <<
-            blockStartTime << " " << blockEndTime << " " <<
-            n << " " << min << " " << max << " " << sum << " " << sqrSum << endl;
-
-        // reset block
-        fileOutputVector->nbuffered -= n;
-        n = 0;
-        min = NaN;
-        max = NaN;
-        sum = 0;
-        sqrSum = 0;
-        times.clear();
-        values.clear();
-    }
-    catch(exception e)
+        // update statistics
+        double blockMin = min, blockMax = max, blockSum = sum, blockSqrSum = sqrSum;
+        for (size_t i = 0; i < k; i++)
+        {
+            double value = values[i];
+            if (blockMin > value || isNaN(blockMin))
+                blockMin = value;
+            if (blockMax < value || isNaN(blockMax))
+                blockMax = value;
+            blockSum += value;
+            blockSqrSum += value * value;
+        }
+        min = blockMin;
+        max = blockMax;
+        sum = blockSum;
+        sqrSum = blockSqrSum;
+
+        if (!fileOutputVector->concurrent)
+        {
+            lastRecorded = ++fileOutputVector->recordCount;
+            fileOutputVector->bufferedBytes += k * BYTES_PER_SAMPLE;
+        }
+        else
+            __atomic_fetch_add(&fileOutputVector->bufferedBytes, k * BYTES_PER_SAMPLE, __ATOMIC_RELAXED);
+
+        // flush if needed
+        fileOutputVector->changed(this);
+
+        times += k;
+        values += k;
+        count -= k;
+    }
+}
+
+void OutputVector::addChunk()
+{
+    VectorChunk *chunk = fileOutputVector->chunkPool.acquire();
+    if (lastChunk)
+        lastChunk->next = chunk;
+    else
+        firstChunk = chunk;
+    lastChunk = chunk;
+}
+
+/**
+ * Writes out a block on the writer thread of an asynchronous
+ * FileOutputVectorManager.
+ */
+class VectorBlockWriteTask : public AsyncWriter::Task
+{
+  protected:
+    FileOutputVectorManager *manager;
+    VectorBlock block;
+
+  public:
+    VectorBlockWriteTask(FileOutputVectorManager *manager, const VectorBlock& block) : block(block)
     {
-        throw ResultRecordingException(std::string("Error recording vector results: ") + e.what());
+        this->manager = manager;
+    }
+
+    ~VectorBlockWriteTask()
+    {
+        manager->chunkPool.release(block.firstChunk);
+    }
+
+    void execute()
+    {
+        manager->writeBlock(block);
     }
+};
+
+void OutputVector::writeBlock()
+{
+    if (n == 0)
+        return;
+
+    VectorBlockWriteTask *task = NULL;
+    if (fileOutputVector->asyncWriter)
+    {
+        // hand over the block (i.e. its chunks) to the writer thread
+        task = new VectorBlockWriteTask(fileOutputVector, *this);
+        header.clear();
+        firstChunk = lastChunk = NULL;
+    }
+    else
+    {
+        fileOutputVector->writeBlock(*this);
+        fileOutputVector->chunkPool.release(firstChunk);
+        firstChunk = lastChunk = NULL;
+    }
+
+    // reset block
+    if (!fileOutputVector->concurrent)
+        fileOutputVector->bufferedBytes -= getBufferedBytes();
+    else
+        __atomic_fetch_sub(&fileOutputVector->bufferedBytes, getBufferedBytes(), __ATOMIC_RELAXED);
+    n = 0;
+    min = NaN;
+    max = NaN;
+    sum = 0;
+    sqrSum = 0;
+    fileOutputVector->removeDirty(this);
+
+    // only now, because a failed writer deletes the task, and with it the chunks
+    if (task)
+        fileOutputVector->asyncWriter->submit(task);
 }
 
-FileOutputVectorManager::FileOutputVectorManager()
+static std::string getIndexFileName(const std::string& fileName)
 {
+    std::string indexFileName = fileName;
+    size_t pos = fileName.find_last_of("\\.[^./\\:]*$");
+    indexFileName.replace(pos, indexFileName.length(), "");
+    return indexFileName + ".vci";
 }
 
-FileOutputVectorManager::~FileOutputVectorManager()
+VectorFileShard::VectorFileShard(const std::string& fileName)
+{
+    this->fileName = fileName;
+    indexFileName = getIndexFileName(fileName);
+    tempIndexFileName = indexFileName + ".tmp";
+    out = new OutputFile();
+    indexOut = new OutputFile();
+    statisticsOffset = -1;
+    indexStatisticsOffset = -1;
+    numVectors = 0;
+    size = 0;
+    indexSize = 0;
+}
+
+VectorFileShard::~VectorFileShard()
 {
-    delete simtimeProvider;
     delete out;
     delete indexOut;
 }
 
-FileOutputVectorManager::FileOutputVectorManager(const string&file)
+FileOutputVectorManager::FileOutputVectorManager()
 {
-    perVectorLimit = 1000;
-    totalLimit = 1000000;
-    lastId = 0;
-    nbuffered = 0;
+    init();
+}
+
+FileOutputVectorManager::~FileOutputVectorManager()
+{
+    delete asyncWriter;
+    delete ring;
+    pthread_mutex_destroy(&vectorsMutex);
+    delete simtimeProvider;
+    delete flushPolicy;
+    for (vector<VectorFileShard*>::iterator it = shards.begin(); it != shards.end(); ++it)
+        delete *it;
+}
 
+FileOutputVectorManager::FileOutputVectorManager(const char *file)
+{
+    init();
     this->fileName = file;
 
     //FIXME this opens and immediately closes the file!!!
+    OutputFile out;
     try
     {
-        out = new ofstream(fileName.c_str());
-        out->exceptions(ifstream::failbit | ifstream::badbit);
+        out.open(fileName.c_str());
     }
-    catch(exception e)
+    catch(exception& e)
     {
         throw ResultRecordingException("Cannot delete old output vector file"); //XXX
     }
 
-    indexFileName = fileName;
-    size_t pos = fileName.find_last_of("\\.[^./\\:]*$");
-    indexFileName.replace(pos, indexFileName.length(), "");
-    indexFileName += ".vci";
-    try
-    {
-        indexOut = new ofstream(indexFileName.c_str(),ios::out|ios::trunc);
-    }
-    catch(exception e)
-    {
-        throw ResultRecordingException(std::string("Cannot delete old output vector index file ") + indexFileName); //XXX
-    }
-    out->close();
-    indexOut->close();
+    std::string indexFileName = getIndexFileName(fileName);
+    if (remove(indexFileName.c_str()) != 0 && errno != ENOENT)
+        throw ResultRecordingException(std::string("Cannot delete old output vector index file ") + indexFileName);
+    manifestFileName = indexFileName.substr(0, indexFileName.length() - 4) + ".vmf";
+    if (remove(manifestFileName.c_str()) != 0 && errno != ENOENT)
+        throw ResultRecordingException(std::string("Cannot delete old output vector manifest file ") + manifestFileName);
+    out.close();
+}
+
+void FileOutputVectorManager::init()
+{
+    perVectorLimit = 1000;
+    memoryBudget = 1000000 * OutputVector::BYTES_PER_SAMPLE;
+    minBlockSize = 64;
+    flushPolicy = new LargestFirstFlushPolicy();
+    simtimeProvider = NULL;
+    lastId = 0;
+    bufferedBytes = 0;
+    recordCount = 0;
+    binary = false;
+    compressionLevel = 0;
+    asyncWriter = NULL;
+    ring = NULL;
+    concurrent = false;
+    pthread_mutex_init(&vectorsMutex, NULL);
+    shardSize = 0;
+    shardVectorCount = 0;
 }
 
 ISimulationTimeProvider *FileOutputVectorManager::getSimtimeProvider()
@@ -246,132 +500,735 @@ void FileOutputVectorManager::setPerVectorBufferLimit(int count)
 
 int FileOutputVectorManager::getTotalBufferLimit()
 {
-    return totalLimit;
+    return memoryBudget / OutputVector::BYTES_PER_SAMPLE;
 }
 
 void FileOutputVectorManager::setTotalBufferLimit(int count)
 {
-    this->totalLimit = count;
+    this->memoryBudget = (size_t)count * OutputVector::BYTES_PER_SAMPLE;
+}
+
+size_t FileOutputVectorManager::getMemoryBudget()
+{
+    return memoryBudget;
+}
+
+void FileOutputVectorManager::setMemoryBudget(size_t bytes)
+{
+    this->memoryBudget = bytes;
+}
+
+int FileOutputVectorManager::getMinBlockSize()
+{
+    return minBlockSize;
+}
+
+void FileOutputVectorManager::setMinBlockSize(int count)
+{
+    this->minBlockSize = count;
+}
+
+size_t FileOutputVectorManager::getMemoryUsage()
+{
+    return chunkPool.getAllocatedBytes();
+}
+
+VectorFlushPolicy *FileOutputVectorManager::getFlushPolicy()
+{
+    return flushPolicy;
+}
+
+void FileOutputVectorManager::setFlushPolicy(VectorFlushPolicy *policy)
+{
+    if (!policy)
+        throw ResultRecordingException("Flush policy must not be NULL");
+    if (policy != flushPolicy)
+        delete flushPolicy;
+    this->flushPolicy = policy;
+}
+
+bool FileOutputVectorManager::isBinaryFormat()
+{
+    return binary;
+}
+
+void FileOutputVectorManager::setBinaryFormat(bool binary)
+{
+    if (isOpen())
+        throw ResultRecordingException("Cannot change the vector file format after the file has been opened");
+    if (!binary && compressionLevel > 0)
+        throw ResultRecordingException("Compressed vector files are always binary");
+    this->binary = binary;
+}
+
+int FileOutputVectorManager::getCompressionLevel()
+{
+    return compressionLevel;
+}
+
+void FileOutputVectorManager::setCompressionLevel(int level)
+{
+    if (level < 0 || level > 9)
+        throw ResultRecordingException("Invalid compression level, must be between 0 and 9");
+    if (level > 0)
+        setBinaryFormat(true);
+    else if (isOpen())
+        throw ResultRecordingException("Cannot change the vector file format after the file has been opened");
+    this->compressionLevel = level;
+}
+
+bool FileOutputVectorManager::isAsync()
+{
+    return asyncWriter != NULL;
+}
+
+void FileOutputVectorManager::setAsync(bool async, int maxQueueLength)
+{
+    if (!async && concurrent)
+        throw ResultRecordingException("Concurrent mode requires asynchronous writing");
+
+    if (asyncWriter)
+    {
+        // let the writer finish what it has, before leaving async mode or replacing it
+        AsyncWriter *writer = asyncWriter;
+        asyncWriter = NULL;
+        try
+        {
+            writer->drain();
+        }
+        catch (...)
+        {
+            delete writer;
+            throw;
+        }
+        delete writer;
+    }
+    if (async)
+        asyncWriter = new AsyncWriter(maxQueueLength);
+}
+
+bool FileOutputVectorManager::isConcurrent()
+{
+    return concurrent;
+}
+
+void FileOutputVectorManager::setConcurrent(bool concurrent)
+{
+    // write out everything, so that the buffer accounting can be switched
+    flush();
+
+    if (concurrent && !asyncWriter)
+        setAsync(true);
+    this->concurrent = concurrent;
 }
 
-void FileOutputVectorManager::open(const string&runID, StringMap runAttributes)
+SharedMemoryRing *FileOutputVectorManager::getSharedMemoryRing()
+{
+    return ring;
+}
+
+void FileOutputVectorManager::setSharedMemoryRing(const char *name, int capacity)
+{
+    // blocks already handed over to the writer thread still go to the old ring
+    if (asyncWriter)
+        asyncWriter->drain();
+    delete ring;
+    ring = NULL;
+    if (name)
+        ring = new SharedMemoryRing(name, capacity);
+}
+
+bool FileOutputVectorManager::isSharded()
+{
+    return shardSize > 0 || shardVectorCount > 0;
+}
+
+long FileOutputVectorManager::getShardSize()
+{
+    return shardSize;
+}
+
+void FileOutputVectorManager::setShardSize(long bytes)
+{
+    if (!shards.empty())
+        throw ResultRecordingException("Cannot change sharding after vectors have been created");
+    if (bytes < 0)
+        throw ResultRecordingException("Invalid shard size, must not be negative");
+    this->shardSize = bytes;
+}
+
+int FileOutputVectorManager::getShardVectorCount()
+{
+    return shardVectorCount;
+}
+
+void FileOutputVectorManager::setShardVectorCount(int count)
+{
+    if (!shards.empty())
+        throw ResultRecordingException("Cannot change sharding after vectors have been created");
+    if (count < 0)
+        throw ResultRecordingException("Invalid shard vector count, must not be negative");
+    this->shardVectorCount = count;
+}
+
+void FileOutputVectorManager::open(const char *runID, const StringMap& runAttributes)
 {
     this->runID = runID;
     this->runAttributes = runAttributes;
 }
 
-void FileOutputVectorManager::open()
+void FileOutputVectorManager::open(VectorFileShard *shard)
 {
-    try
+    OutputFile *out = shard->out;
+    OutputFile *indexOut = shard->indexOut;
+    out->setBufferSize(fileBufferSize);
+    out->setPreallocationSize(preallocationSize);
+    out->open(shard->fileName.c_str());
+    indexOut->open(shard->tempIndexFileName.c_str());
+
+    if (binary)
     {
-        out->open(this->fileName.c_str(), ios::app);
+        writeBinaryFileHeader(out);
     }
-    catch(exception e)
+    else
     {
-        throw ResultRecordingException("Cannot open output vector file");
+        *out << "version " << FILE_VERSION << "\n\n";
+
+        shard->statisticsOffset = writeRunHeader(out, runID, runAttributes);
     }
 
-    try
+    *indexOut << string(FINGERPRINT_LINE_LENGTH, ' ') << "\n";  // placeholder, see writeFingerprint()
+    *indexOut << "version " << FILE_VERSION << "\n\n";
+
+    shard->indexStatisticsOffset = writeRunHeader(indexOut, runID, runAttributes);
+
+    flushAndCheck(shard);
+}
+
+bool FileOutputVectorManager::isOpen()
+{
+    for (vector<VectorFileShard*>::iterator it = shards.begin(); it != shards.end(); ++it)
+        if ((*it)->out->is_open())
+            return true;
+    return false;
+}
+
+VectorFileShard *FileOutputVectorManager::selectShard()
+{
+    // called with vectorsMutex locked
+    VectorFileShard *shard = shards.empty() ? NULL : shards.back();
+    if (shard && isSharded())
     {
-        indexOut->open(indexFileName.c_str(), ios::out|ios::trunc);
+        pthread_mutex_lock(&statisticsMutex);
+        long size = shard->size;
+        pthread_mutex_unlock(&statisticsMutex);
+        if ((shardSize > 0 && size >= shardSize) || (shardVectorCount > 0 && shard->numVectors >= shardVectorCount))
+            shard = NULL;
     }
-    catch(exception e)
+
+    if (!shard)
     {
-        throw ResultRecordingException("Cannot open output vector index file");
+        std::string shardFileName = fileName;
+        if (isSharded())
+        {
+            // insert the shard number before the extension
+            std::string indexFileName = getIndexFileName(fileName);
+            size_t pos = indexFileName.length() - 4;
+            char buf[NUMBER_BUFSIZE];
+            *formatInt(buf, (long)shards.size()) = '\0';
+            shardFileName = fileName.substr(0, pos) + "-" + buf + fileName.substr(pos);
+        }
+        shard = new VectorFileShard(shardFileName);
+        shards.push_back(shard);
     }
+    shard->numVectors++;
+    return shard;
+}
 
-    *out << "version " << FILE_VERSION << endl << endl;
-
-    writeRunHeader(out, runID, runAttributes);
-
-    *indexOut<<"                                                                  "<<endl;
-    *indexOut << "version " << FILE_VERSION << endl << endl;
+void FileOutputVectorManager::writeBinaryFileHeader(OutputFile *out)
+{
+    char buffer[BINARY_HEADER_SIZE];
+    memset(buffer, 0, sizeof(buffer));
 
-    writeRunHeader(indexOut, runID, runAttributes);
+    char *p = buffer;
+    memcpy(p, BINARY_MAGIC, 8);
+    p += 8;
+    p = putUInt32(p, compressionLevel > 0 ? BINARY_COMPRESSED_VERSION : BINARY_VERSION);
+    p = putUInt32(p, BINARY_HEADER_SIZE);
+    p = putUInt32(p, BINARY_RECORD_SIZE);
+    memcpy(p, "TV", 2);
+    p += 4;
+    if (compressionLevel > 0)
+        putUInt32(p, COMPRESSION_ZLIB);  // rest of the header is zero
 
-    flushAndCheck();
+    out->write(buffer, sizeof(buffer));
 }
 
 void FileOutputVectorManager::close()
 {
+    // emit data held back by the filters
+    vector<OutputVector*>::iterator iter;
+    for (iter = vectors.begin(); iter != vectors.end(); ++iter)
+        if ((*iter)->filter)
+            (*iter)->filter->finish();
 
-    if (out->is_open())
+    // write out buffered data first; this may open the files
+    flush();
+
+    if (isOpen())
     {
-        flush();
-        out->close();
+        WriterStatistics stats = getStatistics();
+        vector<VectorFileShard*>::iterator it;
+        for (it = shards.begin(); it != shards.end(); ++it)
+            if ((*it)->out->is_open())
+                closeShard(*it, stats);
+    }
 
-        // record size and timestamp of the vector file, for up-to-date checks
-        try
-        {
-            indexOut->seekp(ios::beg);
-        }
-        catch(exception e)
-        {
-            throw ResultRecordingException("Cannot rewind output vector index file ");
-        }
+    if (ring)
+        ring->close();
 
-        *indexOut << "file " << /*LENGTH*/ " " << endl/*file.lastModified()/1000) */ ;  //FIXME TODO
-        indexOut->flush();
-        if (indexOut->bad())
-            throw ResultRecordingException("Cannot write output vector index file ");
-        indexOut->close();
+    if (isSharded())
+    {
+        if (remove(fileName.c_str()) != 0 && errno != ENOENT)
+            throw ResultRecordingException(std::string("Cannot delete output vector file ") + fileName);
+        writeManifest();
     }
 
-    vector<OutputVector*>::iterator iter;
     for (iter = vectors.begin(); iter != vectors.end(); ++iter)
         delete *iter;
 
 }
 
+void FileOutputVectorManager::closeShard(VectorFileShard *shard, const WriterStatistics& stats)
+{
+    if (shard->statisticsOffset != -1)
+        updateStatisticsAttributes(shard->out, shard->statisticsOffset, stats);
+    shard->out->close();
+    if (shard->out->bad())
+        throw ResultRecordingException("Cannot write output vector file ");
+
+    writeFingerprint(shard);
+    if (shard->indexStatisticsOffset != -1)
+        updateStatisticsAttributes(shard->indexOut, shard->indexStatisticsOffset, stats);
+    shard->indexOut->close();
+    if (shard->indexOut->bad())
+        throw ResultRecordingException("Cannot write output vector index file ");
+
+    // replace the index atomically
+    if (rename(shard->tempIndexFileName.c_str(), shard->indexFileName.c_str()) != 0)
+        throw ResultRecordingException(std::string("Cannot rename output vector index file to ") + shard->indexFileName);
+}
+
+void FileOutputVectorManager::writeManifest()
+{
+    // shards are listed by their file name, relative to the manifest
+    std::string tempManifestFileName = manifestFileName + ".tmp";
+    OutputFile manifest;
+    manifest.open(tempManifestFileName.c_str());
+    manifest << "version " << MANIFEST_VERSION << "\n";
+    manifest << "run " << q(runID) << "\n";
+    vector<VectorFileShard*>::iterator it;
+    for (it = shards.begin(); it != shards.end(); ++it)
+    {
+        // shards that received no data have not been created
+        if ((*it)->size == 0)
+            continue;
+        const std::string& shardFileName = (*it)->fileName;
+        size_t pos = shardFileName.find_last_of("/\\");
+        manifest << "shard " << q(pos == std::string::npos ? shardFileName : shardFileName.substr(pos + 1)) << "\n";
+    }
+    manifest.close();
+    if (manifest.bad())
+        throw ResultRecordingException(std::string("Cannot write output vector manifest file ") + tempManifestFileName);
+
+    if (rename(tempManifestFileName.c_str(), manifestFileName.c_str()) != 0)
+        throw ResultRecordingException(std::string("Cannot rename output vector manifest file to ") + manifestFileName);
+}
+
 void FileOutputVectorManager::flush()
 {
+    collectDirtyVectors();
     vector<OutputVector*>::iterator iter;
-    for (iter = vectors.begin(); iter != vectors.end(); ++iter)
+    for (iter = flushVectors.begin(); iter != flushVectors.end(); ++iter)
         (*iter)->writeBlock();
 
-    if (out->is_open())
-        flushAndCheck();
+    // wait for the writer thread; after that, the files may be touched from here
+    if (asyncWriter)
+        asyncWriter->drain();
+
+    vector<VectorFileShard*>::iterator it;
+    for (it = shards.begin(); it != shards.end(); ++it)
+        if ((*it)->out->is_open())
+            flushAndCheck(*it);
 }
 
-void FileOutputVectorManager::flushAndCheck()
+void FileOutputVectorManager::sync()
 {
+    flush();
+
+    vector<VectorFileShard*>::iterator it;
+    for (it = shards.begin(); it != shards.end(); ++it)
+    {
+        if ((*it)->out->is_open())
+        {
+            (*it)->out->sync();
+            (*it)->indexOut->sync();
+        }
+    }
+}
+
+void FileOutputVectorManager::writeFingerprint(VectorFileShard *shard)
+{
+    // record size and modification time of the (closed) vector file into the
+    // first line of the index, so that readers can check the index is up to date
+    struct stat s;
+    if (stat(shard->fileName.c_str(), &s) != 0)
+        throw ResultRecordingException(std::string("Cannot stat output vector file ") + shard->fileName);
+
+    char buf[3 * NUMBER_BUFSIZE];
+    strcpy(buf, "file ");
+    char *p = formatInt(buf + 5, (long)s.st_size);
+    *p++ = ' ';
+    p = formatInt(p, (long)s.st_mtime);
+    shard->indexOut->writeAt(0, buf, p - buf);
+}
+
+void FileOutputVectorManager::flushAndCheck(VectorFileShard *shard)
+{
+    double startTime = getTime();
+    OutputFile *out = shard->out;
+    OutputFile *indexOut = shard->indexOut;
     out->flush();
     if (out->bad())
         throw ResultRecordingException("Cannot write output vector file ");
     indexOut->flush();
     if (indexOut->bad())
         throw ResultRecordingException("Cannot write output vector index file ");
+
+    pthread_mutex_lock(&statisticsMutex);
+    statistics.flushTime += getTime() - startTime;
+    updateSize(shard);
+    pthread_mutex_unlock(&statisticsMutex);
+}
+
+void FileOutputVectorManager::updateSize(VectorFileShard *shard)
+{
+    // called with statisticsMutex locked
+    long size = shard->out->tell();
+    long indexSize = shard->indexOut->tell();
+    statistics.bytes += (size - shard->size) + (indexSize - shard->indexSize);
+    shard->size = size;
+    shard->indexSize = indexSize;
 }
 
-const string&FileOutputVectorManager::getFileName()
+WriterStatistics FileOutputVectorManager::getStatistics()
 {
-    return fileName;
+    WriterStatistics result = OutputFileManager::getStatistics();
+    result.peakBufferedBytes = chunkPool.getPeakUsedBytes();
+    return result;
 }
 
-IOutputVector *FileOutputVectorManager::createVector(const string& componentPath, const string& vectorName,
+const char *FileOutputVectorManager::getStatisticsPrefix()
+{
+    return "vectorwriter.";
+}
+
+const char *FileOutputVectorManager::getFileName()
+{
+    return fileName.c_str();
+}
+
+const char *FileOutputVectorManager::getManifestFileName()
+{
+    return manifestFileName.c_str();
+}
+
+IOutputVector *FileOutputVectorManager::createVector(const char *componentPath, const char *vectorName,
                                                      StringMap& attributes)
 {
+    VectorFilter *filter = createFilter(componentPath, vectorName, attributes);
+
+    pthread_mutex_lock(&vectorsMutex);
     int id = ++lastId;
     OutputVector *vector = new OutputVector(id, componentPath, vectorName, attributes);
     vector->fileOutputVector = this;
+    vector->shard = selectShard();
+    vector->slot = vectors.size();
+    if (filter)
+    {
+        filter->append(new VectorStoreFilter(vector));
+        vector->filter = filter;
+    }
     vectors.push_back(vector);
+    pthread_mutex_unlock(&vectorsMutex);
     return vector;
 }
 
+VectorFilter *FileOutputVectorManager::createFilter(const char *componentPath, const char *vectorName,
+                                                   const StringMap& attributes)
+{
+    StringMap::const_iterator it = attributes.find(ATTR_FILTER);
+    if (it == attributes.end())
+        return NULL;
+    try
+    {
+        return VectorFilter::parse(it->second);
+    }
+    catch (ResultRecordingException& e)
+    {
+        throw ResultRecordingException(string(e.what()) + ", vector " + componentPath + " " + vectorName);
+    }
+}
+
+void FileOutputVectorManager::writeBlock(VectorBlock& block)
+{
+    double startTime = getTime();
+    VectorFileShard *shard = block.shard;
+    OutputFile *out = shard->out;
+    OutputFile *indexOut = shard->indexOut;
+    try
+    {
+        if (!out->is_open())
+            open(shard);
+
+        // write out vector declaration if not yet done
+        if (!block.header.empty() && !binary)
+            *out << block.header;
+
+        // write data
+        long blockOffset = out->tell();
+        if (compressionLevel > 0)
+            writeCompressedBlock(out, block);
+        else if (binary)
+            writeBinaryBlock(out, block);
+        else
+            writeTextBlock(out, block);
+        if (!out->good())
+            throw ResultRecordingException("Cannot write output vector file");
+
+        long blockSize = (long) out->tell() - blockOffset;
+
+        // write index
+        char buf[10 * NUMBER_BUFSIZE];
+        char *p = formatInt(buf, block.id);
+        *p++ = ' ';
+        p = formatInt(p, blockOffset);
+        *p++ = ' ';
+        p = formatInt(p, blockSize);
+        *p++ = ' ';
+        p = formatDouble(p, block.blockStartTime);
+        *p++ = ' ';
+        p = formatDouble(p, block.blockEndTime);
+        *p++ = ' ';
+        p = formatInt(p, block.n);
+        *p++ = ' ';
+        p = formatDouble(p, block.min);
+        *p++ = ' ';
+        p = formatDouble(p, block.max);
+        *p++ = ' ';
+        p = formatDouble(p, block.sum);
+        *p++ = ' ';
+        p = formatDouble(p, block.sqrSum);
+        *p++ = '\n';
+
+        // make sure that the offsets referred to by the index file exist in the vector file,
+        // so the index can be used to access the vector file while it is being written
+        if (!indexOut->hasRoomFor(block.header.size() + (p - buf)))
+        {
+            out->flush();
+            if (!out->good())
+                throw ResultRecordingException("Cannot write output vector file");
+        }
+        if (!block.header.empty())
+        {
+            *indexOut << block.header;
+            block.header.clear();
+        }
+        indexOut->write(buf, p - buf);
+
+        if (ring)
+            for (const VectorChunk *chunk = block.firstChunk; chunk; chunk = chunk->next)
+                ring->publish(block.id, chunk->times, chunk->values, chunk->n);
+    }
+    catch(exception& e)
+    {
+        throw ResultRecordingException(std::string("Error recording vector results: ") + e.what());
+    }
+
+    pthread_mutex_lock(&statisticsMutex);
+    statistics.samples += block.n;
+    statistics.blocks++;
+    updateSize(shard);
+    statistics.writeTime += getTime() - startTime;
+    pthread_mutex_unlock(&statisticsMutex);
+}
+
+void FileOutputVectorManager::writeTextBlock(OutputFile *out, const VectorBlock& block)
+{
+    // format the whole block into memory, and write it out at once
+    blockBuffer.resize(block.n * (3 * NUMBER_BUFSIZE));
+
+    char idBuf[NUMBER_BUFSIZE];
+    int idLength = formatInt(idBuf, block.id) - idBuf;
+
+    char *p = &blockBuffer[0];
+    for (const VectorChunk *chunk = block.firstChunk; chunk; chunk = chunk->next)
+    {
+        for (int i = 0; i < chunk->n; i++)
+        {
+            memcpy(p, idBuf, idLength);
+            p += idLength;
+            *p++ = ' ';
+            p = formatDouble(p, chunk->times[i]);
+            *p++ = ' ';
+            p = formatDouble(p, chunk->values[i]);
+            *p++ = '\n';
+        }
+    }
+    out->write(&blockBuffer[0], p - &blockBuffer[0]);
+}
+
+void FileOutputVectorManager::writeBinaryBlock(OutputFile *out, const VectorBlock& block)
+{
+    blockBuffer.resize(BINARY_BLOCK_HEADER_SIZE + block.n * BINARY_RECORD_SIZE);
+
+    char *p = &blockBuffer[0];
+    p = putUInt32(p, block.id);
+    p = putUInt32(p, block.n);
+    for (const VectorChunk *chunk = block.firstChunk; chunk; chunk = chunk->next)
+    {
+        for (int i = 0; i < chunk->n; i++)
+        {
+            p = putDouble(p, chunk->times[i]);
+            p = putDouble(p, chunk->values[i]);
+        }
+    }
+    out->write(&blockBuffer[0], blockBuffer.size());
+}
+
+void FileOutputVectorManager::writeCompressedBlock(OutputFile *out, const VectorBlock& block)
+{
+    // shuffle the bytes of the times and values (see class description)
+    int numDoubles = 2 * block.n;
+    shuffleBuffer.resize(numDoubles * 8);
+    unsigned char *dest = &shuffleBuffer[0];
+    for (const VectorChunk *chunk = block.firstChunk; chunk; chunk = chunk->next)
+    {
+        for (int i = 0; i < chunk->n; i++, dest++)
+        {
+            putShuffledDouble(dest, numDoubles, chunk->times[i]);
+            putShuffledDouble(dest + block.n, numDoubles, chunk->values[i]);
+        }
+    }
+
+    uLongf compressedLength = compressBound(shuffleBuffer.size());
+    blockBuffer.resize(BINARY_BLOCK_HEADER_SIZE + compressedLength);
+    char *p = &blockBuffer[0];
+    p = putUInt32(p, block.id);
+    p = putUInt32(p, block.n);
+    if (compress2((Bytef *)p, &compressedLength, &shuffleBuffer[0], shuffleBuffer.size(), compressionLevel) != Z_OK)
+        throw ResultRecordingException("Cannot compress vector data");
+
+    out->write(&blockBuffer[0], BINARY_BLOCK_HEADER_SIZE + compressedLength);
+}
+
 void FileOutputVectorManager::changed(OutputVector *vect)
 {
     if (vect->n > perVectorLimit)
     {
+        pthread_mutex_lock(&statisticsMutex);
+        statistics.perVectorLimitFlushes++;
+        pthread_mutex_unlock(&statisticsMutex);
         vect->writeBlock();
     }
+    else if (!concurrent)
+    {
+        if (bufferedBytes > memoryBudget)
+            writeSelectedVectors();
+    }
     else
     {
-        if (nbuffered > totalLimit)
+        // vectors of other threads must not be touched, so each thread hands
+        // over the block of the vector it is recording into; small blocks only
+        // once the budget is exceeded by a quarter
+        size_t buffered = __atomic_load_n(&bufferedBytes, __ATOMIC_RELAXED);
+        if (buffered > memoryBudget && (vect->n >= minBlockSize || buffered > memoryBudget / 4 * 5))
         {
-            vector<OutputVector*>::iterator iter;
-            for (iter = vectors.begin(); iter != vectors.end(); ++iter)
-                (*iter)->writeBlock();
+            pthread_mutex_lock(&statisticsMutex);
+            statistics.totalLimitFlushes++;
+            pthread_mutex_unlock(&statisticsMutex);
+            vect->writeBlock();
         }
     }
 }
 
+void FileOutputVectorManager::writeSelectedVectors()
+{
+    // get well below the budget, so that the next record() calls don't end up here again
+    size_t bytesToFree = bufferedBytes - memoryBudget / 4 * 3;
+
+    largeVectors.clear();
+    smallVectors.clear();
+    selectedVectors.clear();
+
+    collectDirtyVectors();
+    vector<OutputVector*>::iterator iter;
+    for (iter = flushVectors.begin(); iter != flushVectors.end(); ++iter)
+        ((*iter)->n >= minBlockSize ? largeVectors : smallVectors).push_back(*iter);
+
+    flushPolicy->selectVectors(largeVectors, bytesToFree, selectedVectors);
+
+    size_t freed = 0;
+    for (iter = selectedVectors.begin(); iter != selectedVectors.end(); ++iter)
+        freed += (*iter)->getBufferedBytes();
+    if (freed < bytesToFree)
+        flushPolicy->selectVectors(smallVectors, bytesToFree - freed, selectedVectors);
+
+    pthread_mutex_lock(&statisticsMutex);
+    statistics.totalLimitFlushes += selectedVectors.size();
+    pthread_mutex_unlock(&statisticsMutex);
+
+    for (iter = selectedVectors.begin(); iter != selectedVectors.end(); ++iter)
+        (*iter)->writeBlock();
+}
+
+void FileOutputVectorManager::addDirty(OutputVector *vector)
+{
+    if (concurrent)
+        pthread_mutex_lock(&vectorsMutex);
+    vector->dirtySlot = dirtyVectors.size();
+    dirtyVectors.push_back(vector);
+    if (concurrent)
+        pthread_mutex_unlock(&vectorsMutex);
+}
+
+void FileOutputVectorManager::removeDirty(OutputVector *vector)
+{
+    if (concurrent)
+        pthread_mutex_lock(&vectorsMutex);
+    if (vector->dirtySlot != -1)
+    {
+        OutputVector *last = dirtyVectors.back();
+        dirtyVectors[vector->dirtySlot] = last;
+        last->dirtySlot = vector->dirtySlot;
+        dirtyVectors.pop_back();
+        vector->dirtySlot = -1;
+    }
+    if (concurrent)
+        pthread_mutex_unlock(&vectorsMutex);
+}
+
+static bool lessId(OutputVector *a, OutputVector *b)
+{
+    return a->id < b->id;
+}
+
+void FileOutputVectorManager::collectDirtyVectors()
+{
+    // vectors are written in the order of their creation, to make the output
+    // independent of the order they received data in
+    pthread_mutex_lock(&vectorsMutex);
+    flushVectors = dirtyVectors;
+    pthread_mutex_unlock(&vectorsMutex);
+    sort(flushVectors.begin(), flushVectors.end(), lessId);
+}
@@ -36,28 +36,51 @@
 #include <string>
 #include "OutputFileManager.h"
 #include "IOutputVectorManager.h"
+#include "AsyncWriter.h"
+#include "VectorFlushPolicy.h"
+#include "VectorChunkPool.h"
+#include "VectorFilter.h"
+#include "SharedMemoryRing.h"
 
 class FileOutputVectorManager;
 
 /**
- * An output vector manager that writes OMNeT++ vector (".vec") files.
- * Recording event numbers ("ETV" vectors) is not supported, because it is
- * practically only useful for sequence charts.
- *
- * This class does not support filtering (of vectors or recorded data)
- * at all -- this functionality may be added via subclasses.
- *
- * @author Andras
+ * A vector file and its index, written by FileOutputVectorManager. Unless
+ * output is sharded, there is only one of them. The files are opened when
+ * the first block is written into them.
  */
-class OutputVector : public IOutputVector
+struct VectorFileShard
+{
+    std::string fileName;
+    std::string indexFileName;
+    std::string tempIndexFileName;  // the index is written here until close()
+    OutputFile *out;
+    OutputFile *indexOut;
+    long statisticsOffset;          // of the statistics attributes in the vector file, or -1
+    long indexStatisticsOffset;     // of the statistics attributes in the index, or -1
+    int numVectors;                 // vectors assigned to the shard
+    long size;                      // bytes written into the vector file so far
+    long indexSize;                 // bytes written into the index so far
+
+    VectorFileShard(const std::string& fileName);
+    ~VectorFileShard();
+};
+
+/**
+ * Data recorded into a vector since its last block was written out, together
+ * with its statistics. OutputVector collects data in this form; in
+ * asynchronous mode, full blocks are passed to the writer thread as well.
+ * The data is stored in a list of chunks taken from the manager's VectorChunkPool.
+ */
+struct VectorBlock
 {
-  public:
     int id;
-    std::string header;
+    VectorFileShard *shard;  // the files the vector is written into
+    std::string header;  // vector declaration; empty once it has been written
 
     int n;
-    std::vector<double> times;
-    std::vector<double> values;
+    VectorChunk *firstChunk;
+    VectorChunk *lastChunk;
 
     double blockStartTime;
     double blockEndTime;
@@ -65,12 +88,35 @@ class OutputVector : public IOutputVector
     double max;
     double sum;
     double sqrSum;
+};
+
+/**
+ * An output vector manager that writes OMNeT++ vector (".vec") files.
+ * Recording event numbers ("ETV" vectors) is not supported, because it is
+ * practically only useful for sequence charts.
+ *
+ * Recorded data may be reduced before it is buffered, by a chain of
+ * VectorFilters (see ATTR_FILTER and FileOutputVectorManager::createFilter());
+ * then record() returns true only if the filters passed on some data.
+ *
+ * @author Andras
+ */
+class OutputVector : public IOutputVector, public VectorBlock
+{
+  public:
     friend class FileOutputVectorManager;
     FileOutputVectorManager *fileOutputVector;
+    long lastRecorded;  // sequence number of the last record() call, for flush policies
+    VectorFilter *filter;  // NULL if unfiltered; ends with a VectorStoreFilter
+    int slot;              // index in the manager's "vectors"; -1 once closed
+    int dirtySlot;         // index in the manager's "dirtyVectors"; -1 if no data is buffered
+    bool stored;           // whether the filters stored anything in the current record() call
+
+    static const int BYTES_PER_SAMPLE = 2 * sizeof(double);
 
   public:
-     OutputVector(int id, const char *componentPath, const char *vectorName,
-                  StringMap& attributes);
+     OutputVector(int id, const std::string& componentPath, const std::string& vectorName,
+                  const StringMap& attributes);
     ~OutputVector();
 
     void close();
@@ -81,35 +127,169 @@ class OutputVector : public IOutputVector
 
     bool record(double time, double value);
 
+    size_t recordBatch(const double *times, const double *values, size_t n);
+
+    /**
+     * Memory used by the buffered data, as accounted against the memory budget:
+     * BYTES_PER_SAMPLE for each sample, regardless of how full the chunks are.
+     */
+    size_t getBufferedBytes() const {return n * BYTES_PER_SAMPLE;}
+
   protected:
-    void writeVectorHeader() throw();
+    friend class VectorStoreFilter;
+
+    void store(double time, double value);
+
+    void storeBatch(const double *times, const double *values, size_t n);
+
+    void addChunk();
 
     void writeBlock();
 };
 
+/**
+ * Writes the ".vec" file and its ".vci" index. By default the vector file
+ * is in the usual line-oriented text format. Optionally (see setBinaryFormat())
+ * a binary vector file can be written; in that case the ".vci" index is the
+ * only place where run attributes and vector declarations are stored, and
+ * the vector file contains nothing but the following:
+ *
+ *  - a BINARY_HEADER_SIZE byte file header: the magic BINARY_MAGIC (8 chars),
+ *    followed by the format version, the header size, the record size (uint32
+ *    each) and the column spec ("TV", zero-padded to 4 chars), and 8 reserved
+ *    zero bytes;
+ *  - data blocks, each consisting of the vector id and the number of records
+ *    (uint32 each), followed by the (time, value) records as two IEEE doubles.
+ *
+ * All numbers are little-endian regardless of the host byte order. The offset
+ * and size stored in the index for each block refer to the whole block
+ * including its header.
+ *
+ * Binary vector files may also be compressed (see setCompressionLevel()).
+ * Then the file version is 2, and the first 4 reserved bytes of the header
+ * hold the compression method (COMPRESSION_ZLIB). Each block is compressed
+ * separately, so readers can still access any block via the index: the block
+ * header is followed by a zlib stream of the records in column order (all
+ * times, then all values), byte-shuffled (byte 0 of all doubles, then byte 1,
+ * and so on, with byte 0 being the least significant).
+ *
+ * Output is buffered in large user-space buffers (see setFileBufferSize()),
+ * and it is written to the files when the buffers fill up and at flush();
+ * the index never refers to data that has not been written yet.
+ *
+ * The index is written into a temporary file (the index file name with
+ * ".tmp" appended), which is renamed to the ".vci" file at close(), after
+ * the size and modification time of the finished vector file have been
+ * recorded in its first line. Readers therefore either find a complete and
+ * up-to-date index, or none at all.
+ *
+ * Data is buffered in memory until a vector has more than the per-vector
+ * limit of samples, or all buffers together exceed the memory budget. In the
+ * latter case, the flush policy (see setFlushPolicy()) selects vectors to
+ * write out until the buffers shrink to 3/4 of the budget. Vectors with less
+ * than the minimum block size of samples are only written out if the others
+ * do not free enough memory, so that the index is not filled up with tiny
+ * blocks. Buffers consist of fixed-size chunks from a pool owned by the
+ * manager, but the budget is accounted by the buffered samples (the memory
+ * actually allocated is returned by getMemoryUsage()).
+ *
+ * Output may be sharded (see setShardSize() and setShardVectorCount()): then
+ * vectors are distributed over several vector files ("<name>-0.vec",
+ * "<name>-1.vec", etc., each with its own index), which can be read in
+ * parallel. Each vector is assigned to a shard when it is created, and all
+ * its data goes into that shard; new vectors go into a new shard once the
+ * vector file of the current one has reached the size limit, or has got
+ * the maximum number of vectors. The vector file given in the constructor
+ * is not written then; instead, a manifest (with the ".vmf" extension) is
+ * written at close(), which lists the shards of the run:
+ *
+ * <pre>
+ * version 1
+ * run <runID>
+ * shard <vector file name, relative to the directory of the manifest>
+ * ...
+ * </pre>
+ *
+ * Like the index, the manifest is written into a temporary file first,
+ * and it is only renamed after the shards are complete.
+ *
+ * For monitoring a run while it is in progress, the data of the blocks
+ * written out may also be published in a shared memory ring (see
+ * setSharedMemoryRing() and SharedMemoryRing). Readers identify vectors
+ * by their ids, as declared in the vector file.
+ *
+ * Creating and closing a vector takes constant time, and flushing only visits
+ * the vectors that have buffered data, so it is cheap to use a large number of
+ * short-lived vectors. Closing a vector only writes out its own data.
+ *
+ * In asynchronous mode (see setAsync()), record() only buffers data in memory,
+ * and full blocks are formatted and written out by a background thread.
+ * flush() and close() wait until everything submitted has been written.
+ *
+ * In concurrent mode (see setConcurrent()), vectors may be created and
+ * recorded from several threads at the same time. Each vector buffers its
+ * own data; full blocks are handed over to the writer thread without locking.
+ * A vector must only be recorded by one thread at a time. The total buffer
+ * limit is enforced by the recording threads themselves: while it is
+ * exceeded, a thread hands over the block of the vector it records into,
+ * if that has at least getMinBlockSize() samples (or any block, once the
+ * limit is exceeded by a quarter); the flush policy is not used. flush()
+ * and close() of the manager may only be called while no other thread is
+ * recording.
+ */
 class FileOutputVectorManager : public OutputFileManager, public IOutputVectorManager
 {
   public:
     static const int FILE_VERSION = 2;
+    static const char BINARY_MAGIC[];
+    static const int BINARY_VERSION = 1;
+    static const int BINARY_HEADER_SIZE = 32;
+    static const int BINARY_BLOCK_HEADER_SIZE = 8;
+    static const int BINARY_RECORD_SIZE = 16;
+    static const int BINARY_COMPRESSED_VERSION = 2;
+    static const int COMPRESSION_NONE = 0;
+    static const int COMPRESSION_ZLIB = 1;
+    static const int MANIFEST_VERSION = 1;
     friend class OutputVector;
+    friend class VectorBlockWriteTask;
 
   protected:
+    static const int FINGERPRINT_LINE_LENGTH = 66;  // room reserved for writeFingerprint()
+
     std::string runID;
     StringMap runAttributes;
     std::string fileName;
-    std::ofstream *out;
-    std::string indexFileName;
-    std::ofstream *indexOut;
+    std::string manifestFileName;
+    std::vector<VectorFileShard*> shards;  // the last one receives the new vectors
+    long shardSize;                 // 0 if unlimited
+    int shardVectorCount;           // 0 if unlimited
 
     ISimulationTimeProvider *simtimeProvider;
 
     int perVectorLimit;
-    int totalLimit;
+    size_t memoryBudget;
+    int minBlockSize;
+    VectorFlushPolicy *flushPolicy;
+    std::vector<OutputVector*> largeVectors, smallVectors, selectedVectors;  // for writeSelectedVectors()
+    std::vector<OutputVector*> flushVectors;  // for flush() and writeSelectedVectors()
 
     int lastId;
-    int nbuffered;
+    VectorChunkPool chunkPool;
+    size_t bufferedBytes;  // by the samples of the vectors, not counting blocks in the writer queue; atomic in concurrent mode
+    long recordCount;
+
+    bool binary;
+    int compressionLevel;           // 0 if blocks are not compressed
+    std::vector<char> blockBuffer;  // for assembling blocks
+    std::vector<unsigned char> shuffleBuffer;  // for compressed blocks
 
-    std::vector<OutputVector*>  vectors;
+    AsyncWriter *asyncWriter;       // non-NULL in asynchronous mode
+    SharedMemoryRing *ring;         // NULL if data is not published in shared memory
+    bool concurrent;
+    pthread_mutex_t vectorsMutex;   // protects "vectors", "dirtyVectors", "shards" and "lastId"
+
+    std::vector<OutputVector*> vectors;       // open vectors, in no particular order
+    std::vector<OutputVector*> dirtyVectors;  // vectors with buffered data, in no particular order
 
   public:
     FileOutputVectorManager();
@@ -128,23 +308,174 @@ class FileOutputVectorManager : public OutputFileManager, public IOutputVectorMa
 
     void setTotalBufferLimit(int count);
 
-    void open(const char *runID, StringMap runAttributes);
+    size_t getMemoryBudget();
+
+    /**
+     * Sets the memory (in bytes) the buffered data of all vectors may use,
+     * counting BYTES_PER_SAMPLE per sample. Equivalent to setTotalBufferLimit()
+     * with the corresponding sample count.
+     */
+    void setMemoryBudget(size_t bytes);
+
+    int getMinBlockSize();
+
+    /**
+     * When the memory budget is exceeded, vectors with less buffered samples
+     * than this are written out only as a last resort.
+     */
+    void setMinBlockSize(int count);
+
+    /**
+     * Returns the memory allocated for buffering vector data. This includes
+     * the blocks waiting for the writer thread, and memory which is currently
+     * unused but kept for later reuse.
+     */
+    size_t getMemoryUsage();
+
+    VectorFlushPolicy *getFlushPolicy();
+
+    /**
+     * Sets the policy for choosing vectors to write out when the memory
+     * budget is exceeded. The manager takes ownership of the policy.
+     */
+    void setFlushPolicy(VectorFlushPolicy *policy);
+
+    bool isBinaryFormat();
+
+    /**
+     * Selects the binary vector file format instead of the text one.
+     * It must be called before anything is written into the file.
+     */
+    void setBinaryFormat(bool binary);
+
+    int getCompressionLevel();
+
+    /**
+     * Turns on compression of the data blocks with the given zlib compression
+     * level (1..9), or turns it off with 0. Compression implies the binary
+     * format. It must be called before anything is written into the file.
+     */
+    void setCompressionLevel(int level);
+
+    bool isAsync();
+
+    /**
+     * Turns asynchronous writing on or off. In asynchronous mode, at most
+     * maxQueueLength blocks may wait for the writer thread; when the queue
+     * is full, recording blocks until the writer catches up.
+     */
+    void setAsync(bool async, int maxQueueLength = AsyncWriter::DEFAULT_QUEUE_LENGTH);
+
+    bool isConcurrent();
+
+    /**
+     * Turns concurrent mode on or off; turning it on implies asynchronous
+     * mode as well. It must be called while no vector is being recorded.
+     */
+    void setConcurrent(bool concurrent);
+
+    bool isSharded();
+
+    long getShardSize();
+
+    /**
+     * Sets the size (in bytes) of the vector file of a shard, after which
+     * new vectors go into a new shard; 0 means no limit. Since vectors stay
+     * in their shards, shards may grow beyond this size. It must be called
+     * before any vector is created.
+     */
+    void setShardSize(long bytes);
+
+    int getShardVectorCount();
+
+    /**
+     * Sets the number of vectors after which new vectors go into a new
+     * shard; 0 means no limit. It must be called before any vector is created.
+     */
+    void setShardVectorCount(int count);
+
+    SharedMemoryRing *getSharedMemoryRing();
 
-    void open();
+    /**
+     * Publishes the data of the blocks written from now on in a shared memory
+     * ring with the given name and capacity (in samples); NULL turns it off.
+     * The ring is closed at close(). It must be called while no vector is
+     * being recorded.
+     */
+    void setSharedMemoryRing(const char *name, int capacity = SharedMemoryRing::DEFAULT_CAPACITY);
+
+    void open(const char *runID, const StringMap& runAttributes);
 
     void close();
 
     void flush();
 
+    /**
+     * Like flush(), but also waits until the data has been stored on disk.
+     */
+    void sync();
+
     const char *getFileName();
 
+    /**
+     * Returns the name of the manifest written in sharded mode.
+     */
+    const char *getManifestFileName();
+
+    WriterStatistics getStatistics();
+
     IOutputVector *createVector(const char *componentPath, const char *vectorName,
                                 StringMap& attributes);
 
   protected:
-    void flushAndCheck();
+    void init();
+
+    void open(VectorFileShard *shard);
+
+    void closeShard(VectorFileShard *shard, const WriterStatistics& stats);
+
+    bool isOpen();
+
+    VectorFileShard *selectShard();
+
+    void writeManifest();
+
+    void writeBinaryFileHeader(OutputFile *out);
+
+    void writeBlock(VectorBlock& block);
+
+    void writeTextBlock(OutputFile *out, const VectorBlock& block);
+
+    void writeBinaryBlock(OutputFile *out, const VectorBlock& block);
+
+    void writeCompressedBlock(OutputFile *out, const VectorBlock& block);
+
+    void flushAndCheck(VectorFileShard *shard);
+
+    void writeFingerprint(VectorFileShard *shard);
+
+    void updateSize(VectorFileShard *shard);
+
+    const char *getStatisticsPrefix();
 
     void changed(OutputVector *vector);
+
+    void writeSelectedVectors();
+
+    void addDirty(OutputVector *vector);
+
+    void removeDirty(OutputVector *vector);
+
+    void collectDirtyVectors();
+
+    /**
+     * Creates the chain of data reduction filters for a new vector, or
+     * returns NULL if its data is to be recorded unfiltered. The default
+     * implementation builds the chain from the ATTR_FILTER attribute;
+     * subclasses may override it to configure filtering in other ways.
+     */
+    virtual VectorFilter *createFilter(const char *componentPath, const char *vectorName,
+                                       const StringMap& attributes);
 };
 
 #endif
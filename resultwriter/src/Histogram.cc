@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+#include <float.h>
+#include "Histogram.h"
+#include "OutputFileManager.h"
+#include "ResultRecordingException.h"
+
+using namespace std;
+
+// floor(a/2), also for negative numbers
+static inline long long halve(long long a)
+{
+    return a >= 0 ? a / 2 : -((1 - a) / 2);
+}
+
+// largest cell index we let cell indices grow to, before merging cells
+static const double MAX_CELL_INDEX = 1e15;
+
+Histogram::Histogram(int numCells, int numPrecollected)
+{
+    if (numCells < 2)
+        throw ResultRecordingException("Histogram must have at least 2 cells");
+    this->numCells = numCells;
+    this->numPrecollected = numPrecollected < 1 ? 1 : numPrecollected;
+    clear();
+}
+
+void Histogram::clear()
+{
+    stats.clear();
+    precollected.clear();
+    cellSize = 0;
+    firstCell = 0;
+    cells.clear();
+    underflow = 0;
+    overflow = 0;
+}
+
+void Histogram::collect(double value)
+{
+    stats.collect(value);
+    add(value, 1);
+}
+
+void Histogram::add(double value, double count)
+{
+    if (isNaN(value))
+        return;
+    if (value == INFINITY)
+        overflow += (long)count;
+    else if (value == -INFINITY)
+        underflow += (long)count;
+    else if (cellSize == 0)
+    {
+        precollected.push_back(value);
+        if ((int)precollected.size() >= numPrecollected)
+            setUpRange();
+    }
+    else
+    {
+        for (;;)
+        {
+            double index = floor(value / cellSize);
+            if (index >= firstCell && index < firstCell + numCells)
+            {
+                cells[(long long)index - firstCell] += count;
+                break;
+            }
+            if (fabs(index) < MAX_CELL_INDEX)
+                includeCell((long long)index);
+            else
+                mergeCells();
+        }
+    }
+}
+
+void Histogram::setUpRange()
+{
+    double minValue = precollected[0], maxValue = precollected[0];
+    for (int i = 1; i < (int)precollected.size(); i++)
+    {
+        if (precollected[i] < minValue)
+            minValue = precollected[i];
+        if (precollected[i] > maxValue)
+            maxValue = precollected[i];
+    }
+
+    // smallest power of two that lets the values fit into the cells
+    double range = maxValue - minValue;
+    if (range == 0)
+        range = minValue != 0 ? fabs(minValue) : 1;
+    int exponent;
+    frexp(range / (numCells - 1), &exponent);
+    cellSize = ldexp(1.0, exponent);
+    if (cellSize == 0)
+        cellSize = DBL_MIN;
+
+    while (fabs(minValue / cellSize) >= MAX_CELL_INDEX)
+        cellSize *= 2;
+    firstCell = (long long)floor(minValue / cellSize);
+    cells.assign(numCells, 0.0);
+
+    vector<double> values;
+    values.swap(precollected);
+    for (int i = 0; i < (int)values.size(); i++)
+        add(values[i], 1);
+}
+
+void Histogram::includeCell(long long index)
+{
+    // shift the cells if the used ones and the new one fit, otherwise make the cells larger
+    int lo, hi;
+    if (!getUsedCells(lo, hi))
+        moveCells(index);
+    else if (index < firstCell + lo && firstCell + hi - index < numCells)
+        moveCells(index);
+    else if (index > firstCell + hi && index - (firstCell + lo) < numCells)
+        moveCells(index - numCells + 1);
+    else
+        mergeCells();
+}
+
+void Histogram::moveCells(long long newFirstCell)
+{
+    vector<double> newCells(numCells, 0.0);
+    for (int i = 0; i < numCells; i++)
+    {
+        long long k = firstCell + i - newFirstCell;
+        if (cells[i] != 0)
+            newCells[k] = cells[i];  // the caller ensures it's in range
+    }
+    cells.swap(newCells);
+    firstCell = newFirstCell;
+}
+
+void Histogram::mergeCells()
+{
+    long long newFirstCell = halve(firstCell);
+    vector<double> newCells(numCells, 0.0);
+    for (int i = 0; i < numCells; i++)
+        newCells[halve(firstCell + i) - newFirstCell] += cells[i];
+    cells.swap(newCells);
+    firstCell = newFirstCell;
+    cellSize *= 2;
+}
+
+void Histogram::merge(const Histogram& other)
+{
+    stats.merge(other.stats);
+    underflow += other.underflow;
+    overflow += other.overflow;
+
+    if (other.cellSize == 0)
+    {
+        for (int i = 0; i < (int)other.precollected.size(); i++)
+            add(other.precollected[i], 1);
+        return;
+    }
+
+    if (cellSize == 0)
+    {
+        // take over the other's cells, and add our values to them
+        cellSize = other.cellSize;
+        firstCell = other.firstCell;
+        cells.assign(numCells, 0.0);
+        vector<double> values;
+        values.swap(precollected);
+        for (int i = 0; i < (int)values.size(); i++)
+            add(values[i], 1);
+    }
+
+    // cells nest into each other, so adding the midpoints of the other's cells is exact
+    while (cellSize < other.cellSize)
+        mergeCells();
+    for (int i = 0; i < (int)other.cells.size(); i++)
+        if (other.cells[i] != 0)
+            add((other.firstCell + i + 0.5) * other.cellSize, other.cells[i]);
+}
+
+bool Histogram::getUsedCells(int& lo, int& hi)
+{
+    lo = 0;
+    hi = (int)cells.size() - 1;
+    while (lo <= hi && cells[lo] == 0)
+        lo++;
+    while (hi >= lo && cells[hi] == 0)
+        hi--;
+    return lo <= hi;
+}
+
+int Histogram::getNumCells()
+{
+    if (cellSize == 0 && !precollected.empty())
+        setUpRange();
+
+    int lo, hi;
+    return getUsedCells(lo, hi) ? hi - lo + 1 : 0;
+}
+
+double Histogram::getCellBoundary(int k)
+{
+    int lo, hi;
+    if (getNumCells() == 0 || !getUsedCells(lo, hi) || k < 0 || k > hi - lo + 1)
+        throw ResultRecordingException("Histogram cell index out of range");
+    return (firstCell + lo + k) * cellSize;
+}
+
+double Histogram::getCellValue(int k)
+{
+    int lo, hi;
+    if (getNumCells() == 0 || !getUsedCells(lo, hi) || k < 0 || k > hi - lo)
+        throw ResultRecordingException("Histogram cell index out of range");
+    return cells[lo + k];
+}
+
+double Histogram::getCellPDF(int k)
+{
+    return getCellValue(k) / cellSize / getN();
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __HISTOGRAM_H
+#define __HISTOGRAM_H
+
+#include <vector>
+#include "IHistogramSummary.h"
+#include "StatisticalSummary.h"
+
+/**
+ * Streaming, auto-ranging implementation of IHistogramSummary.
+ *
+ * The first values are only stored; the histogram range is chosen when enough
+ * of them have been collected (or when the histogram is queried). Values that
+ * fall outside the range later extend the range instead of ending up in the
+ * underflow/overflow cells: cells are shifted, or adjacent cells are merged
+ * (doubling the cell size) when the number of cells would be exceeded. Only
+ * infinite values are counted as underflows and overflows, and NaNs are left
+ * out of the histogram.
+ *
+ * Cell sizes are powers of two, and cell boundaries are multiples of the
+ * cell size. Thus, the cells of any two histograms nest into each other, and
+ * histograms can be merged exactly, e.g. ones collected by different threads.
+ * Only the range of non-empty cells is reported.
+ *
+ * Collecting a value takes constant time, except for the rare occasions when
+ * the range is extended. Objects are not thread-safe.
+ *
+ * @author Andras
+ */
+class Histogram : public IHistogramSummary
+{
+  public:
+    static const int DEFAULT_NUM_CELLS = 200;
+    static const int DEFAULT_NUM_PRECOLLECTED = 100;
+
+  protected:
+    StatisticalSummary stats;
+    int numCells;
+    int numPrecollected;
+    std::vector<double> precollected;  // values collected before the range was set up
+    double cellSize;                   // a power of two, or 0 while the range is not yet set up
+    long long firstCell;               // lower boundary of the cells divided by cellSize
+    std::vector<double> cells;
+    long underflow;
+    long overflow;
+
+  public:
+    /**
+     * Creates a histogram with at most numCells cells, which sets up its range
+     * after numPrecollected values.
+     */
+    Histogram(int numCells = DEFAULT_NUM_CELLS, int numPrecollected = DEFAULT_NUM_PRECOLLECTED);
+
+    /**
+     * Removes all values.
+     */
+    void clear();
+
+    /**
+     * Adds a value.
+     */
+    void collect(double value);
+
+    /**
+     * Adds the values collected by the other histogram.
+     */
+    void merge(const Histogram& other);
+
+    double getMean() {return stats.getMean();}
+    double getVariance() {return stats.getVariance();}
+    double getStandardDeviation() {return stats.getStandardDeviation();}
+    double getMax() {return stats.getMax();}
+    double getMin() {return stats.getMin();}
+    long getN() {return stats.getN();}
+    double getSum() {return stats.getSum();}
+    double getSqrSum() {return stats.getSqrSum();}
+
+    int getNumCells();
+    double getCellBoundary(int k);
+    double getCellValue(int k);
+    double getCellPDF(int k);
+    long getUnderflowCell() {return underflow;}
+    long getOverflowCell() {return overflow;}
+
+  protected:
+    void add(double value, double count);
+    void setUpRange();
+    void includeCell(long long index);
+    void moveCells(long long newFirstCell);
+    void mergeCells();
+    bool getUsedCells(int& lo, int& hi);
+};
+
+#endif
@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include "OutputFile.h"
+#include "ResultRecordingException.h"
+
+using namespace std;
+
+OutputFileBuffer::OutputFileBuffer(size_t bufferSize)
+{
+    fd = -1;
+    this->bufferSize = bufferSize < 1 ? 1 : bufferSize;
+    buffer = new char[this->bufferSize];
+    preallocationSize = 0;
+    flushedSize = 0;
+    preallocatedSize = 0;
+    lastErrno = 0;
+    setp(buffer, buffer + this->bufferSize);
+}
+
+OutputFileBuffer::~OutputFileBuffer()
+{
+    close();
+    delete [] buffer;
+}
+
+void OutputFileBuffer::open(const char *fileName, bool append)
+{
+    if (fd != -1)
+        close();
+
+    this->fileName = fileName;
+    fd = ::open(fileName, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0666);
+    if (fd == -1)
+    {
+        lastErrno = errno;
+        throw ResultRecordingException(std::string("Cannot open file ") + fileName + ": " + strerror(lastErrno));
+    }
+
+    lastErrno = 0;
+    flushedSize = append ? lseek(fd, 0, SEEK_END) : 0;
+    preallocatedSize = flushedSize;
+    setp(buffer, buffer + bufferSize);
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    // only a hint, errors don't matter
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+bool OutputFileBuffer::close()
+{
+    if (fd == -1)
+        return true;
+
+    bool ok = writeBuffer();
+    if (::close(fd) != 0 && ok)
+    {
+        lastErrno = errno;
+        ok = false;
+    }
+    fd = -1;
+    return ok;
+}
+
+bool OutputFileBuffer::setBufferSize(size_t size)
+{
+    if (size < 1)
+        size = 1;
+    if (size == bufferSize)
+        return true;
+    if (!writeBuffer())
+        return false;
+
+    delete [] buffer;
+    buffer = new char[size];
+    bufferSize = size;
+    setp(buffer, buffer + bufferSize);
+    return true;
+}
+
+bool OutputFileBuffer::syncToDisk()
+{
+    if (!writeBuffer())
+        return false;
+#if defined(__linux__)
+    if (fdatasync(fd) != 0)
+#else
+    if (fsync(fd) != 0)
+#endif
+    {
+        lastErrno = errno;
+        return false;
+    }
+    return true;
+}
+
+bool OutputFileBuffer::writeAt(off_t offset, const char *data, size_t n)
+{
+    if (fd == -1)
+        return false;
+
+    // the region may still be in the buffer
+    if (offset + (off_t)n > flushedSize && !writeBuffer())
+        return false;
+
+    while (n > 0)
+    {
+        ssize_t k = pwrite(fd, data, n, offset);
+        if (k < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            lastErrno = errno;
+            return false;
+        }
+        data += k;
+        offset += k;
+        n -= k;
+    }
+    return true;
+}
+
+bool OutputFileBuffer::writeBuffer()
+{
+    size_t n = pptr() - pbase();
+    if (n == 0)
+        return true;
+    if (fd == -1)
+    {
+        lastErrno = EBADF;
+        return false;
+    }
+
+    bool ok = writeFully(pbase(), n);
+    setp(buffer, buffer + bufferSize);
+    return ok;
+}
+
+bool OutputFileBuffer::writeFully(const char *data, size_t n)
+{
+    return writeFully(data, n, NULL, 0);
+}
+
+bool OutputFileBuffer::writeFully(const char *data1, size_t n1, const char *data2, size_t n2)
+{
+    if (preallocationSize > 0)
+        preallocate(flushedSize + n1 + n2);
+
+    struct iovec iov[2];
+    iov[0].iov_base = const_cast<char *>(data1);
+    iov[0].iov_len = n1;
+    iov[1].iov_base = const_cast<char *>(data2);
+    iov[1].iov_len = n2;
+    struct iovec *v = n1 > 0 ? iov : iov + 1;
+    int count = (n1 > 0 ? 1 : 0) + (n2 > 0 ? 1 : 0);
+
+    while (count > 0)
+    {
+        ssize_t k = writev(fd, v, count);
+        if (k < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            lastErrno = errno;
+            return false;
+        }
+        flushedSize += k;
+
+        // skip what has been written
+        while (count > 0 && (size_t)k >= v->iov_len)
+        {
+            k -= v->iov_len;
+            v++;
+            count--;
+        }
+        if (count > 0)
+        {
+            v->iov_base = (char *)v->iov_base + k;
+            v->iov_len -= k;
+        }
+    }
+    return true;
+}
+
+void OutputFileBuffer::preallocate(off_t end)
+{
+    if (end <= preallocatedSize)
+        return;
+
+    // reserve space in large chunks; failures are not errors, just lost optimizations
+    off_t newSize = end + preallocationSize;
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, preallocatedSize, newSize - preallocatedSize) != 0)
+        preallocationSize = 0;  // not supported by the file system, don't try again
+#else
+    preallocationSize = 0;  // posix_fallocate() would change the file size
+#endif
+    preallocatedSize = newSize;
+}
+
+OutputFileBuffer::int_type OutputFileBuffer::overflow(int_type c)
+{
+    if (!writeBuffer())
+        return traits_type::eof();
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize OutputFileBuffer::xsputn(const char *s, std::streamsize n)
+{
+    size_t room = epptr() - pptr();
+    if ((size_t)n <= room)
+    {
+        memcpy(pptr(), s, n);
+        pbump(n);
+        return n;
+    }
+
+    if ((size_t)n < bufferSize)
+    {
+        // fill the buffer, write it out, and keep the rest
+        memcpy(pptr(), s, room);
+        pbump(room);
+        if (!writeBuffer())
+            return 0;
+        memcpy(pptr(), s + room, n - room);
+        pbump(n - room);
+        return n;
+    }
+
+    // too large for the buffer: write it out together with the buffered data, in one system call
+    if (fd == -1)
+        return 0;
+    size_t buffered = pptr() - pbase();
+    bool ok = writeFully(pbase(), buffered, s, n);
+    setp(buffer, buffer + bufferSize);
+    return ok ? n : 0;
+}
+
+int OutputFileBuffer::sync()
+{
+    return writeBuffer() ? 0 : -1;
+}
+
+OutputFileBuffer::pos_type OutputFileBuffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    // only querying the output position (tellp()) is supported
+    if (off != 0 || dir != std::ios_base::cur || !(which & std::ios_base::out) || fd == -1)
+        return pos_type(off_type(-1));
+    return pos_type(tell());
+}
+
+//----
+
+OutputFile::OutputFile(size_t bufferSize) : std::ostream(NULL), buf(bufferSize)
+{
+    rdbuf(&buf);
+}
+
+OutputFile::~OutputFile()
+{
+    buf.close();
+}
+
+void OutputFile::open(const char *fileName, bool append)
+{
+    buf.open(fileName, append);
+    clear();
+}
+
+void OutputFile::close()
+{
+    if (!buf.close())
+        setstate(std::ios_base::badbit);
+}
+
+void OutputFile::setBufferSize(size_t size)
+{
+    if (!buf.setBufferSize(size))
+        setstate(std::ios_base::badbit);
+}
+
+void OutputFile::sync()
+{
+    if (!buf.syncToDisk())
+        error("Cannot write file ");
+}
+
+void OutputFile::writeAt(off_t offset, const char *data, size_t n)
+{
+    if (!buf.writeAt(offset, data, n))
+        error("Cannot write file ");
+}
+
+void OutputFile::error(const char *what)
+{
+    setstate(std::ios_base::badbit);
+    int err = buf.getLastErrno();
+    throw ResultRecordingException(std::string(what) + buf.getFileName() + (err ? std::string(": ") + strerror(err) : std::string()));
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __OUTPUTFILE_H
+#define __OUTPUTFILE_H
+
+#include <sys/types.h>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+/**
+ * Stream buffer that writes a file through its raw file descriptor. Data is
+ * collected in a large user-space buffer and handed to the kernel only when
+ * the buffer is full or when it is flushed explicitly, so recording a value
+ * normally costs no system call at all. Writes that do not fit into the
+ * buffer are passed to the kernel together with the buffered data in a
+ * single writev() call.
+ *
+ * Optionally, disk space is reserved ahead of the written data in chunks of
+ * the given preallocation size (without changing the file size, where the
+ * platform allows it), which helps the file system to keep large result
+ * files contiguous.
+ *
+ * @author Andras
+ */
+class OutputFileBuffer : public std::streambuf
+{
+  protected:
+    std::string fileName;
+    int fd;
+    char *buffer;
+    size_t bufferSize;
+    off_t preallocationSize;
+    off_t flushedSize;       // file offset where the buffered data starts
+    off_t preallocatedSize;  // end of the space reserved so far
+    int lastErrno;
+
+  public:
+    OutputFileBuffer(size_t bufferSize);
+    virtual ~OutputFileBuffer();
+
+    const std::string& getFileName() const {return fileName;}
+    bool isOpen() const {return fd != -1;}
+    int getLastErrno() const {return lastErrno;}
+
+    /**
+     * Opens the file, either truncating it or appending to it. Throws
+     * ResultRecordingException on failure.
+     */
+    void open(const char *fileName, bool append);
+
+    /**
+     * Writes out buffered data and closes the file. Returns false on error.
+     */
+    bool close();
+
+    /**
+     * Changes the size of the buffer; buffered data is written out first.
+     */
+    bool setBufferSize(size_t size);
+    size_t getBufferSize() const {return bufferSize;}
+
+    void setPreallocationSize(off_t size) {preallocationSize = size;}
+    off_t getPreallocationSize() const {return preallocationSize;}
+
+    /**
+     * The logical size of the file, i.e. including data still in the buffer.
+     */
+    off_t tell() const {return flushedSize + (pptr() - pbase());}
+
+    /**
+     * Returns true if n more bytes can be added without writing out the buffer.
+     */
+    bool hasRoomFor(size_t n) const {return (size_t)(epptr() - pptr()) >= n;}
+
+    /**
+     * Writes out buffered data and waits until it reaches the disk.
+     */
+    bool syncToDisk();
+
+    /**
+     * Overwrites data at the given offset of the file (which must already
+     * have been written out) without moving the current position.
+     */
+    bool writeAt(off_t offset, const char *data, size_t n);
+
+  protected:
+    bool writeBuffer();
+    bool writeFully(const char *data, size_t n);
+    bool writeFully(const char *data1, size_t n1, const char *data2, size_t n2);
+    void preallocate(off_t end);
+
+    virtual int_type overflow(int_type c);
+    virtual std::streamsize xsputn(const char *s, std::streamsize n);
+    virtual int sync();
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which);
+};
+
+/**
+ * Output stream on top of an OutputFileBuffer, used by the output file
+ * managers instead of std::ofstream. Note that a flush (e.g. std::endl)
+ * results in a write() system call, so records should be terminated
+ * with '\n', and flushed explicitly only at the points where the data
+ * should become visible to readers of the file.
+ *
+ * Write errors set the stream's badbit, like with std::ofstream; open(),
+ * sync() and writeAt() throw ResultRecordingException instead.
+ *
+ * @author Andras
+ */
+class OutputFile : public std::ostream
+{
+  public:
+    static const size_t DEFAULT_BUFFER_SIZE = 1024*1024;
+
+  protected:
+    OutputFileBuffer buf;
+
+  public:
+    OutputFile(size_t bufferSize = DEFAULT_BUFFER_SIZE);
+    ~OutputFile();
+
+    void open(const char *fileName, bool append = false);
+    bool is_open() const {return buf.isOpen();}
+    void close();
+
+    void setBufferSize(size_t size);
+    size_t getBufferSize() const {return buf.getBufferSize();}
+    void setPreallocationSize(off_t size) {buf.setPreallocationSize(size);}
+    off_t getPreallocationSize() const {return buf.getPreallocationSize();}
+
+    /**
+     * Same as tellp(), but cheaper.
+     */
+    off_t tell() const {return buf.tell();}
+
+    bool hasRoomFor(size_t n) const {return buf.hasRoomFor(n);}
+
+    /**
+     * Durable flush point: writes out buffered data and waits until it
+     * has been stored on disk (fdatasync).
+     */
+    void sync();
+
+    /**
+     * Overwrites already written data, e.g. a placeholder in the file header.
+     * It does not work on files opened in append mode (data would be appended).
+     */
+    void writeAt(off_t offset, const char *data, size_t n);
+
+  protected:
+    void error(const char *what);
+};
+
+#endif
@@ -28,18 +28,26 @@
 
 #include <time.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <string>
+#include "doubleformat.h"
 #include "OutputFileManager.h"
 
 using namespace std;
 
 OutputFileManager::OutputFileManager()
 {
+    fileBufferSize = OutputFile::DEFAULT_BUFFER_SIZE;
+    preallocationSize = 0;
+    memset(&statistics, 0, sizeof(statistics));
+    pthread_mutex_init(&statisticsMutex, NULL);
+    statisticsAttributes = false;
 }
 
 OutputFileManager::~OutputFileManager()
 {
+    pthread_mutex_destroy(&statisticsMutex);
 }
 
 string OutputFileManager::generateRunID(const string&baseString)
@@ -50,33 +58,111 @@ string OutputFileManager::generateRunID(const string&baseString)
     return baseString + s;
 }
 
-void OutputFileManager::writeRunHeader(ofstream *out, const string&runID, const StringMap& runAttributes)
+size_t OutputFileManager::getFileBufferSize()
 {
-    *out << "run " << q(runID) << endl;
+    return fileBufferSize;
+}
+
+void OutputFileManager::setFileBufferSize(size_t size)
+{
+    this->fileBufferSize = size;
+}
+
+off_t OutputFileManager::getPreallocationSize()
+{
+    return preallocationSize;
+}
+
+void OutputFileManager::setPreallocationSize(off_t size)
+{
+    this->preallocationSize = size;
+}
+
+WriterStatistics OutputFileManager::getStatistics()
+{
+    pthread_mutex_lock(&statisticsMutex);
+    WriterStatistics result = statistics;
+    pthread_mutex_unlock(&statisticsMutex);
+    return result;
+}
+
+bool OutputFileManager::getStatisticsAttributes()
+{
+    return statisticsAttributes;
+}
+
+void OutputFileManager::setStatisticsAttributes(bool enabled)
+{
+    this->statisticsAttributes = enabled;
+}
+
+long OutputFileManager::writeRunHeader(ostream *out, const string&runID, const StringMap& runAttributes)
+{
+    *out << "run " << q(runID) << "\n";
     writeAttributes(out, &runAttributes);
-    *out << endl;
+    long offset = -1;
+    if (statisticsAttributes)
+    {
+        offset = out->tellp();
+        writeStatisticsAttributes(out, NULL);
+    }
+    *out << "\n";
+    return offset;
 }
 
-void OutputFileManager::writeAttributes(std::ofstream *out, const StringMap *attributes)  ///FIXME StringMap passing...
+double OutputFileManager::getTime()
 {
-    const StringMap&::iterator iter;
-    if (attributes)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void OutputFileManager::writeStatisticsAttributes(ostream *out, const WriterStatistics *stats)
+{
+    static const char *names[] = {
+        "samples", "blocks", "bytes", "perVectorLimitFlushes", "totalLimitFlushes",
+        "writeTime", "flushTime", "peakBufferedBytes", NULL
+    };
+
+    // placeholders are "n/a", so an unfinished file still parses
+    char values[8][NUMBER_BUFSIZE];
+    for (int i = 0; i < 8; i++)
+        strcpy(values[i], "n/a");
+    if (stats)
     {
-        for (iter = attributes->begin(); iter != attributes->end(); ++iter)
-        {
-            *out << "attr " << q(iter->first) << " " << q(iter->second) << endl;
-        }
+        formatInt(values[0], stats->samples);
+        formatInt(values[1], stats->blocks);
+        formatInt(values[2], stats->bytes);
+        formatInt(values[3], stats->perVectorLimitFlushes);
+        formatInt(values[4], stats->totalLimitFlushes);
+        formatDouble(values[5], stats->writeTime);
+        formatDouble(values[6], stats->flushTime);
+        formatInt(values[7], (long)stats->peakBufferedBytes);
     }
+
+    const char *prefix = getStatisticsPrefix();
+    for (int i = 0; names[i]; i++)
+    {
+        int padding = STATISTICS_VALUE_WIDTH - strlen(values[i]);
+        *out << "attr " << prefix << names[i] << " " << values[i] << string(padding > 0 ? padding : 0, ' ') << "\n";
+    }
+}
+
+void OutputFileManager::updateStatisticsAttributes(OutputFile *out, long offset, const WriterStatistics& stats)
+{
+    ostringstream text;
+    writeStatisticsAttributes(&text, &stats);
+    out->writeAt(offset, text.str().data(), text.str().size());
 }
 
-void OutputFileManager::writeAttributes(std::ostringstream *out, StringMap *attributes)
+void OutputFileManager::writeAttributes(std::ostream *out, const StringMap *attributes)
 {
     if (attributes)
     {
-        StringMap::iterator iter;
+        StringMap::const_iterator iter;
         for (iter = attributes->begin(); iter != attributes->end(); iter++)
         {
-            *out << "attr " << q(iter->first) << " " << q(iter->second) << endl;
+            *out << "attr " << q(iter->first) << " " << q(iter->second) << "\n";
         }
     }
 }
@@ -163,7 +249,7 @@ static bool opp_needsquotes(const char *txt)
 
 string OutputFileManager::q(const string& s)
 {
-    if (!&s || s.length() == 0)
+    if (s.length() == 0)
         return "\"\"";
 
     bool needsQuotes = opp_needsquotes(s.c_str());
@@ -172,3 +258,37 @@ string OutputFileManager::q(const string& s)
     else
         return s;
 }
+
+void OutputFileManager::writeQuoted(std::ostream *out, const char *s)
+{
+    if (opp_needsquotes(s))
+        *out << opp_quotestr(s);
+    else
+        out->write(s, strlen(s));
+}
+
+char *OutputFileManager::formatDouble(char *buf, double d)
+{
+    char *endp;
+    opp_formatdouble(buf, d, SHORTEST_PRECISION, endp);
+    return endp;
+}
+
+char *OutputFileManager::formatInt(char *buf, long i)
+{
+    char tmp[24];
+    char *t = tmp + sizeof(tmp);
+    unsigned long u = i < 0 ? 0UL - (unsigned long)i : (unsigned long)i;
+    do
+    {
+        *--t = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    char *p = buf;
+    if (i < 0)
+        *p++ = '-';
+    memcpy(p, t, tmp + sizeof(tmp) - t);
+    p += tmp + sizeof(tmp) - t;
+    *p = '\0';
+    return p;
+}
@@ -31,6 +31,8 @@
 #include <fstream>
 #include <map>
 #include <sstream>
+#include <pthread.h>
+#include "OutputFile.h"
 
 extern const double NaN;
 
@@ -41,6 +43,23 @@ inline bool isNaN(double d)
 
 typedef std::map<std::string, std::string> StringMap;
 
+/**
+ * Counters about the work of an output file manager, see
+ * OutputFileManager::getStatistics(). Counters marked "vectors only"
+ * are always zero for scalar files.
+ */
+struct WriterStatistics
+{
+    long samples;                // vector samples, or scalars and statistics recorded
+    long blocks;                 // vector blocks written (vectors only)
+    long bytes;                  // bytes written into the result files, index included
+    long perVectorLimitFlushes;  // blocks written because of the per-vector limit (vectors only)
+    long totalLimitFlushes;      // blocks written because of the memory budget (vectors only)
+    double writeTime;            // seconds spent formatting and writing blocks (vectors only)
+    double flushTime;            // seconds spent in flushing the files
+    size_t peakBufferedBytes;    // peak memory used for buffering data (vectors only)
+};
+
 /**
  * Common base class for FileOutputVectorManager and FileOutputScalarManager
  *
@@ -51,23 +70,116 @@ class OutputFileManager
   public:
     friend class OutputVector;
 
+  public:
+    /**
+     * Buffer size needed by formatDouble() and formatInt().
+     */
+    static const int NUMBER_BUFSIZE = 32;
+
+  protected:
+    static const int STATISTICS_VALUE_WIDTH = 24;  // room for values in writeStatisticsAttributes()
+
+    size_t fileBufferSize;
+    off_t preallocationSize;
+
+    WriterStatistics statistics;
+    pthread_mutex_t statisticsMutex;  // protects "statistics"
+    bool statisticsAttributes;
+
   public:
     OutputFileManager();
-    ~OutputFileManager();
-    static std::string generateRunID(const char *baseString);
+    virtual ~OutputFileManager();
+    static std::string generateRunID(const std::string& baseString);
+
+    size_t getFileBufferSize();
+
+    /**
+     * Sets the size of the user-space buffer of the output file(s). Data is
+     * written to the file when the buffer fills up, and at explicit flushes.
+     * Takes effect when the file is opened.
+     */
+    void setFileBufferSize(size_t size);
+
+    off_t getPreallocationSize();
+
+    /**
+     * When nonzero, disk space for the output file is reserved ahead of the
+     * data in chunks of this size. Takes effect when the file is opened.
+     */
+    void setPreallocationSize(off_t size);
+
+    /**
+     * Returns a snapshot of the counters. In asynchronous mode, data
+     * still waiting for the writer thread is not included.
+     */
+    virtual WriterStatistics getStatistics();
+
+    bool getStatisticsAttributes();
 
-    void writeRunHeader(std::ofstream *out, const char *runID, StringMap runAttributes);
+    /**
+     * When turned on, the counters (see getStatistics()) are stored in the
+     * result file(s) as run attributes at close(). Space for them is reserved
+     * in the run header, so it must be called before the file is opened.
+     */
+    void setStatisticsAttributes(bool enabled);
+
+    /**
+     * Writes the run header. If statistics attributes are turned on, it
+     * reserves space for them, and returns their offset for
+     * updateStatisticsAttributes(); otherwise it returns -1.
+     */
+    long writeRunHeader(std::ostream *out, const std::string& runID, const StringMap& runAttributes);
+
+    /**
+     * Writes the shortest decimal representation of d that reads back as
+     * exactly d (in %g-like notation, "nan", "inf" and "-inf" included) into
+     * buf, and returns a pointer to the terminating zero. It does not depend
+     * on the locale, and it is several times faster than iostreams.
+     */
+    static char *formatDouble(char *buf, double d);
+
+    /**
+     * Writes the decimal representation of i into buf, and returns a pointer
+     * to the terminating zero.
+     */
+    static char *formatInt(char *buf, long i);
 
   protected:
 
-    static void writeAttributes(std::ofstream *out, StringMap *attributes);
-    static void writeAttributes(std::ostringstream *out, StringMap *attributes);
+    static void writeAttributes(std::ostream *out, const StringMap *attributes);
 
     /**
      * Quotes the given string if needed.
      */
-    static std::string q(const char *s);
+    static std::string q(const std::string& s);
 
+    /**
+     * Writes the given string, quoted if needed. Unlike q(), it does not
+     * create a temporary string if no quoting is needed.
+     */
+    static void writeQuoted(std::ostream *out, const char *s);
+
+    /**
+     * Returns a monotonic time in seconds, for measuring durations.
+     */
+    static double getTime();
+
+    /**
+     * Returns the prefix of the names of the statistics attributes; it
+     * must differ among the subclasses, as they write into the same run.
+     */
+    virtual const char *getStatisticsPrefix() = 0;
+
+    /**
+     * Writes the statistics attributes, or with NULL, placeholders for them.
+     * The length of the output does not depend on the values.
+     */
+    void writeStatisticsAttributes(std::ostream *out, const WriterStatistics *stats);
+
+    /**
+     * Overwrites the placeholders written by writeRunHeader() with the values.
+     */
+    void updateStatisticsAttributes(OutputFile *out, long offset, const WriterStatistics& stats);
 };
 
 #endif
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include "QuantileSketch.h"
+#include "OutputFileManager.h"
+#include "ResultRecordingException.h"
+
+using namespace std;
+
+// the k1 scale function of the t-digest, and its inverse
+static inline double scale(double q, double compression)
+{
+    return compression / (2 * M_PI) * asin(2 * q - 1);
+}
+
+static inline double inverseScale(double k, double compression)
+{
+    double x = k * 2 * M_PI / compression;
+    if (x >= M_PI / 2)
+        return 1;
+    return (sin(x) + 1) / 2;
+}
+
+QuantileSketch::QuantileSketch(int compression)
+{
+    if (compression < 10)
+        throw ResultRecordingException("Quantile sketch compression must be at least 10");
+    this->compression = compression;
+    bufferSize = 5 * compression;
+    buffer.reserve(bufferSize);
+}
+
+void QuantileSketch::clear()
+{
+    stats.clear();
+    centroids.clear();
+    buffer.clear();
+}
+
+void QuantileSketch::collect(double value)
+{
+    stats.collect(value);
+    if (!isNaN(value) && value != INFINITY && value != -INFINITY)
+        add(value, 1);
+}
+
+void QuantileSketch::add(double mean, double weight)
+{
+    Centroid c;
+    c.mean = mean;
+    c.weight = weight;
+    buffer.push_back(c);
+    if (buffer.size() >= bufferSize)
+        compress();
+}
+
+void QuantileSketch::merge(const QuantileSketch& other)
+{
+    stats.merge(other.stats);
+    for (size_t i = 0; i < other.centroids.size(); i++)
+        add(other.centroids[i].mean, other.centroids[i].weight);
+    for (size_t i = 0; i < other.buffer.size(); i++)
+        add(other.buffer[i].mean, other.buffer[i].weight);
+}
+
+void QuantileSketch::compress()
+{
+    if (buffer.empty())
+        return;
+
+    buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+    sort(buffer.begin(), buffer.end());
+
+    double totalWeight = 0;
+    for (size_t i = 0; i < buffer.size(); i++)
+        totalWeight += buffer[i].weight;
+
+    // merge neighbours as long as the centroid stays within one unit of the scale function
+    centroids.clear();
+    Centroid current = buffer[0];
+    double weightSoFar = 0;
+    double limit = totalWeight * inverseScale(scale(0, compression) + 1, compression);
+    for (size_t i = 1; i < buffer.size(); i++)
+    {
+        const Centroid& next = buffer[i];
+        if (weightSoFar + current.weight + next.weight <= limit)
+        {
+            current.weight += next.weight;
+            current.mean += (next.mean - current.mean) * next.weight / current.weight;
+        }
+        else
+        {
+            centroids.push_back(current);
+            weightSoFar += current.weight;
+            limit = totalWeight * inverseScale(scale(weightSoFar / totalWeight, compression) + 1, compression);
+            current = next;
+        }
+    }
+    centroids.push_back(current);
+    buffer.clear();
+}
+
+double QuantileSketch::getQuantile(double p)
+{
+    if (!(p >= 0 && p <= 1))
+        throw ResultRecordingException("Quantile level must be between 0 and 1");
+
+    compress();
+    if (centroids.empty())
+        return NaN;
+
+    // the minimum and maximum may be infinite
+    double minValue = centroids.front().mean, maxValue = centroids.back().mean;
+    if (stats.getMin() > -INFINITY)
+        minValue = stats.getMin();
+    if (stats.getMax() < INFINITY)
+        maxValue = stats.getMax();
+    if (centroids.size() == 1)
+        return centroids[0].mean;
+
+    double totalWeight = 0;
+    for (size_t i = 0; i < centroids.size(); i++)
+        totalWeight += centroids[i].weight;
+    double index = p * totalWeight;
+
+    // interpolate between the centers of the centroids, and the min/max at the ends
+    const Centroid& first = centroids.front();
+    if (index < first.weight / 2)
+        return minValue + (first.mean - minValue) * index / (first.weight / 2);
+
+    double weightSoFar = first.weight / 2;
+    for (size_t i = 0; i + 1 < centroids.size(); i++)
+    {
+        double step = (centroids[i].weight + centroids[i+1].weight) / 2;
+        if (weightSoFar + step >= index)
+            return centroids[i].mean + (centroids[i+1].mean - centroids[i].mean) * (index - weightSoFar) / step;
+        weightSoFar += step;
+    }
+
+    const Centroid& last = centroids.back();
+    double t = (index - weightSoFar) / (last.weight / 2);
+    return last.mean + (maxValue - last.mean) * (t > 1 ? 1 : t);
+}
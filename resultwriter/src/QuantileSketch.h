@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __QUANTILESKETCH_H
+#define __QUANTILESKETCH_H
+
+#include <vector>
+#include "IQuantileSummary.h"
+#include "StatisticalSummary.h"
+
+/**
+ * Streaming quantile estimator, an implementation of the merging t-digest
+ * algorithm (Dunning and Ertl). Values are clustered into centroids that are
+ * small near the tails of the distribution and larger around the median,
+ * so extreme quantiles (like the 99th percentile) are estimated accurately.
+ * The number of centroids is bounded by the compression parameter; larger
+ * values give more accurate estimates at the cost of more memory.
+ *
+ * Values are buffered and merged into the centroids in batches, so collecting
+ * a value takes amortized constant time. Sketches can be merged, e.g. ones
+ * collected by different threads. Objects are not thread-safe.
+ *
+ * @author Andras
+ */
+class QuantileSketch : public IQuantileSummary
+{
+  public:
+    static const int DEFAULT_COMPRESSION = 100;
+
+  protected:
+    struct Centroid
+    {
+        double mean;
+        double weight;
+        bool operator<(const Centroid& other) const {return mean < other.mean;}
+    };
+
+    StatisticalSummary stats;
+    double compression;
+    std::vector<Centroid> centroids;  // sorted by mean
+    std::vector<Centroid> buffer;     // values and centroids not yet merged into centroids
+    size_t bufferSize;
+
+  public:
+    QuantileSketch(int compression = DEFAULT_COMPRESSION);
+
+    /**
+     * Removes all values.
+     */
+    void clear();
+
+    /**
+     * Adds a value. Infinite values are only counted in the moments
+     * (mean, min, max, etc.), not in the quantile estimates.
+     */
+    void collect(double value);
+
+    /**
+     * Adds the values collected by the other sketch.
+     */
+    void merge(const QuantileSketch& other);
+
+    double getMean() {return stats.getMean();}
+    double getVariance() {return stats.getVariance();}
+    double getStandardDeviation() {return stats.getStandardDeviation();}
+    double getMax() {return stats.getMax();}
+    double getMin() {return stats.getMin();}
+    long getN() {return stats.getN();}
+    double getSum() {return stats.getSum();}
+    double getSqrSum() {return stats.getSqrSum();}
+
+    double getQuantile(double p);
+
+  protected:
+    void add(double mean, double weight);
+    void compress();
+};
+
+#endif
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "SharedMemoryRing.h"
+#include "ResultRecordingException.h"
+
+const char SharedMemoryRing::MAGIC[] = "OMNETRNG";
+
+SharedMemoryRing::SharedMemoryRing(const char *name, int capacity)
+{
+    this->name = name;
+    header = NULL;
+    records = NULL;
+    head = 0;
+
+    uint64_t n = 1;
+    while (n < (uint64_t)capacity)
+        n <<= 1;
+    mask = n - 1;
+    size = sizeof(SharedMemoryRingHeader) + n * sizeof(SharedMemoryRingRecord);
+
+    // start with a fresh object, so that readers attached to an old one are not confused
+    shm_unlink(name);
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd == -1)
+        throw ResultRecordingException(std::string("Cannot create shared memory ring ") + name + ": " + strerror(errno));
+    void *p = MAP_FAILED;
+    if (ftruncate(fd, size) == 0)
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+    {
+        int error = errno;
+        ::close(fd);
+        shm_unlink(name);
+        throw ResultRecordingException(std::string("Cannot map shared memory ring ") + name + ": " + strerror(error));
+    }
+
+    // the object is zero-filled; the magic is written last, so readers do not accept a half-initialized header
+    header = (SharedMemoryRingHeader *)p;
+    records = (SharedMemoryRingRecord *)(header + 1);
+    header->version = VERSION;
+    header->headerSize = sizeof(SharedMemoryRingHeader);
+    header->recordSize = sizeof(SharedMemoryRingRecord);
+    header->capacity = (uint32_t)n;
+    header->writerPid = (uint32_t)getpid();
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(header->magic, MAGIC, sizeof(header->magic));
+}
+
+SharedMemoryRing::~SharedMemoryRing()
+{
+    close();
+}
+
+void SharedMemoryRing::publish(int vectorId, const double *times, const double *values, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        SharedMemoryRingRecord *record = records + (head & mask);
+        uint64_t time, value;
+        memcpy(&time, times + i, sizeof(time));
+        memcpy(&value, values + i, sizeof(value));
+
+        // the record must be marked busy before any of its fields changes
+        __atomic_store_n(&record->seq, BUSY, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        __atomic_store_n(&record->vectorId, (uint32_t)vectorId, __ATOMIC_RELAXED);
+        __atomic_store_n(&record->time, time, __ATOMIC_RELAXED);
+        __atomic_store_n(&record->value, value, __ATOMIC_RELAXED);
+        __atomic_store_n(&record->seq, head + 1, __ATOMIC_RELEASE);
+        head++;
+    }
+    __atomic_store_n(&header->head, head, __ATOMIC_RELEASE);
+}
+
+void SharedMemoryRing::close()
+{
+    if (!header)
+        return;
+    __atomic_store_n(&header->closed, 1, __ATOMIC_RELEASE);
+    munmap(header, size);
+    ::close(fd);
+    shm_unlink(name.c_str());
+    header = NULL;
+    records = NULL;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __SHAREDMEMORYRING_H
+#define __SHAREDMEMORYRING_H
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * Header of a SharedMemoryRing, at the start of the shared memory object.
+ */
+struct SharedMemoryRingHeader
+{
+    char magic[8];       // SharedMemoryRing::MAGIC
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t recordSize;
+    uint32_t capacity;   // number of records; a power of two
+    uint64_t head;       // number of records published so far
+    uint32_t closed;     // nonzero once the writer has finished
+    uint32_t writerPid;  // process id of the writer
+    uint32_t reserved[6];
+};
+
+/**
+ * A recorded sample in a SharedMemoryRing. Time and value are IEEE doubles,
+ * stored as their bit patterns.
+ */
+struct SharedMemoryRingRecord
+{
+    uint64_t seq;        // sequence number + 1; 0 if never written, BUSY while being written
+    uint32_t vectorId;
+    uint32_t reserved;
+    uint64_t time;
+    uint64_t value;
+};
+
+/**
+ * Publishes recorded vector data in a POSIX shared memory object, so that
+ * other processes can monitor a run while it is in progress without
+ * reading the vector file. The object consists of a SharedMemoryRingHeader
+ * followed by a ring of SharedMemoryRingRecords; all numbers are in host
+ * byte order.
+ *
+ * There is one writer and any number of readers, and none of them ever
+ * waits for another one. The writer stores the k-th sample (counting from
+ * 0) into record k % capacity, overwriting older data whether or not it
+ * has been read, and then sets "head" to k+1. While a record is being
+ * written, its "seq" field is BUSY; afterwards it is k+1. Readers keep
+ * their own position: they read the records below "head", and take a
+ * record only if its "seq" is the expected one both before and after
+ * reading its fields. Otherwise the writer has lapped them, and the
+ * samples in question are lost for that reader.
+ *
+ * "closed" is set after the last sample has been published; if the writer
+ * process dies without closing the ring, readers can notice that from
+ * "writerPid". The object is removed from the system at close() (readers
+ * that are attached keep their mapping), and any old object of the same
+ * name is replaced when the ring is created.
+ *
+ * @author Andras
+ */
+class SharedMemoryRing
+{
+  public:
+    static const char MAGIC[];
+    static const int VERSION = 1;
+    static const int DEFAULT_CAPACITY = 1 << 20;
+    static const uint64_t BUSY = ~(uint64_t)0;
+
+  protected:
+    std::string name;
+    int fd;
+    size_t size;
+    SharedMemoryRingHeader *header;
+    SharedMemoryRingRecord *records;
+    uint64_t head;      // local copy of header->head
+    uint64_t mask;      // capacity - 1
+
+  public:
+    /**
+     * Creates the shared memory object with the given name (which should
+     * start with "/", see shm_open()), with room for at least the given
+     * number of samples.
+     */
+    SharedMemoryRing(const char *name, int capacity = DEFAULT_CAPACITY);
+    ~SharedMemoryRing();
+
+    const char *getName() const {return name.c_str();}
+
+    int getCapacity() const {return (int)(mask + 1);}
+
+    /**
+     * Publishes samples of the given vector. It must not be called from
+     * several threads at the same time.
+     */
+    void publish(int vectorId, const double *times, const double *values, int n);
+
+    /**
+     * Marks the ring as finished, and removes the shared memory object.
+     */
+    void close();
+};
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+#include "StatisticalSummary.h"
+#include "OutputFileManager.h"
+#include "ResultRecordingException.h"
+
+StatisticalSummary::StatisticalSummary()
+{
+    clear();
+}
+
+void StatisticalSummary::clear()
+{
+    n = 0;
+    weighted = false;
+    minValue = NaN;
+    maxValue = NaN;
+    sum = 0;
+    sqrSum = 0;
+    sumWeights = 0;
+    sumWeightedValues = 0;
+    sumSqrWeights = 0;
+    sumWeightedSqrValues = 0;
+    mean = 0;
+    m2 = 0;
+}
+
+void StatisticalSummary::collect(double value)
+{
+    update(value, 1);
+}
+
+void StatisticalSummary::collect(double value, double weight)
+{
+    if (!(weight >= 0))
+        throw ResultRecordingException("Weight must not be negative");
+    weighted = true;
+    update(value, weight);
+}
+
+void StatisticalSummary::update(double value, double weight)
+{
+    if (n == 0 || value < minValue)
+        minValue = value;
+    if (n == 0 || value > maxValue)
+        maxValue = value;
+    n++;
+    sum += value;
+    sqrSum += value * value;
+
+    sumWeights += weight;
+    sumWeightedValues += weight * value;
+    sumSqrWeights += weight * weight;
+    sumWeightedSqrValues += weight * value * value;
+
+    if (sumWeights > 0)
+    {
+        double delta = value - mean;
+        double r = delta * weight / sumWeights;
+        mean += r;
+        m2 += (sumWeights - weight) * delta * r;
+    }
+}
+
+void StatisticalSummary::merge(const StatisticalSummary& other)
+{
+    if (other.n == 0)
+        return;
+    if (n == 0)
+    {
+        *this = other;
+        return;
+    }
+
+    // combine the means and squared deviations (Chan et al.)
+    double totalWeights = sumWeights + other.sumWeights;
+    if (totalWeights > 0)
+    {
+        double delta = other.mean - mean;
+        m2 += other.m2 + delta * delta * sumWeights * other.sumWeights / totalWeights;
+        mean += delta * other.sumWeights / totalWeights;
+    }
+
+    if (other.minValue < minValue)
+        minValue = other.minValue;
+    if (other.maxValue > maxValue)
+        maxValue = other.maxValue;
+    n += other.n;
+    weighted = weighted || other.weighted;
+    sum += other.sum;
+    sqrSum += other.sqrSum;
+    sumWeights = totalWeights;
+    sumWeightedValues += other.sumWeightedValues;
+    sumSqrWeights += other.sumSqrWeights;
+    sumWeightedSqrValues += other.sumWeightedSqrValues;
+}
+
+double StatisticalSummary::getMean()
+{
+    return n == 0 ? NaN : mean;
+}
+
+double StatisticalSummary::getVariance()
+{
+    if (n == 0)
+        return NaN;
+    if (n == 1)
+        return 0;
+
+    // unbiased estimate; with unit weights, the denominator is n-1
+    double denominator = sumWeights - sumSqrWeights / sumWeights;
+    return denominator > 0 ? m2 / denominator : 0;
+}
+
+double StatisticalSummary::getStandardDeviation()
+{
+    return sqrt(getVariance());
+}
+
+double StatisticalSummary::getMax()
+{
+    return maxValue;
+}
+
+double StatisticalSummary::getMin()
+{
+    return minValue;
+}
+
+long StatisticalSummary::getN()
+{
+    return n;
+}
+
+double StatisticalSummary::getSum()
+{
+    return n == 0 ? NaN : sum;
+}
+
+double StatisticalSummary::getSqrSum()
+{
+    return n == 0 ? NaN : sqrSum;
+}
+
+bool StatisticalSummary::isWeighted()
+{
+    return weighted;
+}
+
+double StatisticalSummary::getWeights()
+{
+    return n == 0 ? NaN : sumWeights;
+}
+
+double StatisticalSummary::getWeightedSum()
+{
+    return n == 0 ? NaN : sumWeightedValues;
+}
+
+double StatisticalSummary::getSqrSumWeights()
+{
+    return n == 0 ? NaN : sumSqrWeights;
+}
+
+double StatisticalSummary::getWeightedSqrSum()
+{
+    return n == 0 ? NaN : sumWeightedSqrValues;
+}
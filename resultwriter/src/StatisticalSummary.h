@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __STATISTICALSUMMARY_H
+#define __STATISTICALSUMMARY_H
+
+#include "IStatisticalSummary2.h"
+
+/**
+ * Streaming implementation of IStatisticalSummary2. Every value is processed
+ * in constant time and memory. The mean and variance are maintained with
+ * Welford's algorithm (West's algorithm for weighted values), which is
+ * numerically stable unlike computing them from the sum and the sum of squares.
+ *
+ * Summaries can be merged, so values may be collected into separate objects,
+ * e.g. one per thread, and combined afterwards. Objects are not thread-safe.
+ *
+ * @author Andras
+ */
+class StatisticalSummary : public IStatisticalSummary2
+{
+  protected:
+    long n;
+    bool weighted;
+    double minValue;
+    double maxValue;
+    double sum;
+    double sqrSum;
+    double sumWeights;
+    double sumWeightedValues;
+    double sumSqrWeights;
+    double sumWeightedSqrValues;
+    double mean;  // (weighted) mean
+    double m2;    // (weighted) sum of squared deviations from the mean
+
+  public:
+    StatisticalSummary();
+
+    /**
+     * Removes all values.
+     */
+    void clear();
+
+    /**
+     * Adds a value.
+     */
+    void collect(double value);
+
+    /**
+     * Adds a weighted value, and turns this into weighted statistics.
+     * The weight must not be negative.
+     */
+    void collect(double value, double weight);
+
+    /**
+     * Adds the values collected by the other summary.
+     */
+    void merge(const StatisticalSummary& other);
+
+    double getMean();
+    double getVariance();
+    double getStandardDeviation();
+    double getMax();
+    double getMin();
+    long getN();
+    double getSum();
+    double getSqrSum();
+
+    bool isWeighted();
+    double getWeights();
+    double getWeightedSum();
+    double getSqrSumWeights();
+    double getWeightedSqrSum();
+
+  protected:
+    void update(double value, double weight);
+};
+
+#endif
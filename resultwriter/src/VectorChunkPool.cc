@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include "VectorChunkPool.h"
+#include "ResultRecordingException.h"
+
+using namespace std;
+
+VectorChunkPool::VectorChunkPool()
+{
+    if (pthread_key_create(&cacheKey, destroyCache) != 0)
+        throw ResultRecordingException("Cannot create the thread-specific key of the vector chunk pool");
+    pthread_mutex_init(&mutex, NULL);
+    freeList = NULL;
+    numChunks = 0;
+    numFreeChunks = 0;
+    peakUsedChunks = 0;
+}
+
+VectorChunkPool::~VectorChunkPool()
+{
+    // threads still alive no longer call destroyCache() for us
+    pthread_key_delete(cacheKey);
+    for (vector<Cache *>::iterator it = caches.begin(); it != caches.end(); ++it)
+        delete *it;
+    for (vector<VectorChunk *>::iterator it = slabs.begin(); it != slabs.end(); ++it)
+        delete [] *it;
+    pthread_mutex_destroy(&mutex);
+}
+
+VectorChunkPool::Cache *VectorChunkPool::getCache()
+{
+    Cache *cache = (Cache *)pthread_getspecific(cacheKey);
+    if (!cache)
+    {
+        cache = new Cache();
+        cache->pool = this;
+        cache->chunks = NULL;
+        cache->count = 0;
+        pthread_mutex_lock(&mutex);
+        try
+        {
+            caches.push_back(cache);
+        }
+        catch (...)
+        {
+            pthread_mutex_unlock(&mutex);
+            delete cache;
+            throw;
+        }
+        pthread_mutex_unlock(&mutex);
+        if (pthread_setspecific(cacheKey, cache) != 0)
+            throw ResultRecordingException("Cannot set up the chunk cache of the thread");  // deleted with the pool
+    }
+    return cache;
+}
+
+void VectorChunkPool::destroyCache(void *arg)
+{
+    // called at the exit of a thread that has used the pool
+    Cache *cache = (Cache *)arg;
+    VectorChunkPool *pool = cache->pool;
+    pool->giveBack(cache, cache->count);
+    pthread_mutex_lock(&pool->mutex);
+    pool->caches.erase(find(pool->caches.begin(), pool->caches.end(), cache));
+    pthread_mutex_unlock(&pool->mutex);
+    delete cache;
+}
+
+void VectorChunkPool::refill(Cache *cache)
+{
+    pthread_mutex_lock(&mutex);
+    while (numFreeChunks < (size_t)CACHE_BATCH)
+    {
+        VectorChunk *slab;
+        try
+        {
+            slabs.reserve(slabs.size() + 1);
+            slab = new VectorChunk[CHUNKS_PER_SLAB];
+        }
+        catch (...)
+        {
+            pthread_mutex_unlock(&mutex);
+            throw;
+        }
+        slabs.push_back(slab);
+        for (int i = 0; i < CHUNKS_PER_SLAB; i++)
+        {
+            slab[i].next = freeList;
+            freeList = &slab[i];
+        }
+        numChunks += CHUNKS_PER_SLAB;
+        numFreeChunks += CHUNKS_PER_SLAB;
+    }
+
+    for (int i = 0; i < CACHE_BATCH; i++)
+    {
+        VectorChunk *chunk = freeList;
+        freeList = chunk->next;
+        chunk->next = cache->chunks;
+        cache->chunks = chunk;
+    }
+    cache->count += CACHE_BATCH;
+    numFreeChunks -= CACHE_BATCH;
+    if (numChunks - numFreeChunks > peakUsedChunks)
+        peakUsedChunks = numChunks - numFreeChunks;
+    pthread_mutex_unlock(&mutex);
+}
+
+void VectorChunkPool::giveBack(Cache *cache, size_t count)
+{
+    if (count == 0)
+        return;
+
+    // the first "count" chunks of the cache go to the free list
+    VectorChunk *first = cache->chunks;
+    VectorChunk *last = first;
+    for (size_t i = 1; i < count; i++)
+        last = last->next;
+    cache->chunks = last->next;
+    cache->count -= count;
+
+    pthread_mutex_lock(&mutex);
+    last->next = freeList;
+    freeList = first;
+    numFreeChunks += count;
+    pthread_mutex_unlock(&mutex);
+}
+
+VectorChunk *VectorChunkPool::acquire()
+{
+    Cache *cache = getCache();
+    if (!cache->chunks)
+        refill(cache);
+
+    VectorChunk *chunk = cache->chunks;
+    cache->chunks = chunk->next;
+    cache->count--;
+    chunk->next = NULL;
+    chunk->n = 0;
+    return chunk;
+}
+
+void VectorChunkPool::release(VectorChunk *chunks)
+{
+    if (!chunks)
+        return;
+
+    size_t count = 1;
+    VectorChunk *last = chunks;
+    while (last->next)
+    {
+        last = last->next;
+        count++;
+    }
+
+    Cache *cache = getCache();
+    last->next = cache->chunks;
+    cache->chunks = chunks;
+    cache->count += count;
+
+    // a thread that only releases (like the writer thread) must not hoard chunks
+    if (cache->count > 2 * CACHE_BATCH)
+        giveBack(cache, cache->count - CACHE_BATCH);
+}
+
+size_t VectorChunkPool::getAllocatedBytes()
+{
+    pthread_mutex_lock(&mutex);
+    size_t result = numChunks * sizeof(VectorChunk);
+    pthread_mutex_unlock(&mutex);
+    return result;
+}
+
+size_t VectorChunkPool::getUsedBytes()
+{
+    pthread_mutex_lock(&mutex);
+    size_t result = (numChunks - numFreeChunks) * sizeof(VectorChunk);
+    pthread_mutex_unlock(&mutex);
+    return result;
+}
+
+size_t VectorChunkPool::getPeakUsedBytes()
+{
+    pthread_mutex_lock(&mutex);
+    size_t result = peakUsedChunks * sizeof(VectorChunk);
+    pthread_mutex_unlock(&mutex);
+    return result;
+}
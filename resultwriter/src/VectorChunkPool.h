@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __VECTORCHUNKPOOL_H
+#define __VECTORCHUNKPOOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <vector>
+
+/**
+ * Fixed-size piece of the buffered data of an output vector. The data of a
+ * vector (and of a block waiting to be written out) is a linked list of chunks.
+ */
+struct VectorChunk
+{
+    static const int CAPACITY = 64;
+
+    VectorChunk *next;
+    int n;
+    double times[CAPACITY];
+    double values[CAPACITY];
+};
+
+/**
+ * Hands out VectorChunks to the vectors of a FileOutputVectorManager.
+ * Chunks are carved out of large slabs, and returned chunks are kept on a
+ * free list for reuse, so that once the pool has grown to the peak memory
+ * need of the simulation, recording data involves no heap allocation at all.
+ * Slabs are only freed when the pool is destroyed.
+ *
+ * The pool is thread-safe: vectors may take chunks from several threads,
+ * and the writer thread returns them after writing the data out. Each thread
+ * takes and returns chunks through a small cache of its own, and only goes
+ * to the shared free list (under a mutex) for a batch of CACHE_BATCH chunks
+ * at a time. Chunks in the caches count as used.
+ *
+ * @author Andras
+ */
+class VectorChunkPool
+{
+  public:
+    static const int CHUNKS_PER_SLAB = 64;
+    static const int CACHE_BATCH = 32;
+
+  protected:
+    // chunks held by one thread
+    struct Cache
+    {
+        VectorChunkPool *pool;
+        VectorChunk *chunks;
+        size_t count;
+    };
+
+    pthread_mutex_t mutex;  // protects everything below, but not the contents of the caches
+    pthread_key_t cacheKey;
+    std::vector<Cache *> caches;
+    VectorChunk *freeList;
+    std::vector<VectorChunk *> slabs;
+    size_t numChunks;
+    size_t numFreeChunks;
+    size_t peakUsedChunks;
+
+  public:
+    VectorChunkPool();
+    ~VectorChunkPool();
+
+    /**
+     * Returns an empty chunk.
+     */
+    VectorChunk *acquire();
+
+    /**
+     * Returns the given list of chunks to the pool.
+     */
+    void release(VectorChunk *chunks);
+
+    /**
+     * Memory allocated by the pool.
+     */
+    size_t getAllocatedBytes();
+
+    /**
+     * Memory in chunks that are currently in use.
+     */
+    size_t getUsedBytes();
+
+    /**
+     * The maximum of getUsedBytes() so far.
+     */
+    size_t getPeakUsedBytes();
+
+  protected:
+    Cache *getCache();
+
+    void refill(Cache *cache);
+
+    void giveBack(Cache *cache, size_t count);
+
+    static void destroyCache(void *cache);
+};
+
+#endif
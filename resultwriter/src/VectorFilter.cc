@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+#include <vector>
+#include "numberparser.h"
+#include "VectorFilter.h"
+#include "OutputFileManager.h"
+#include "ResultRecordingException.h"
+
+using namespace std;
+
+VectorFilter::~VectorFilter()
+{
+    delete next;
+}
+
+void VectorFilter::append(VectorFilter *filter)
+{
+    VectorFilter *last = this;
+    while (last->next)
+        last = last->next;
+    last->next = filter;
+}
+
+void VectorFilter::finish()
+{
+    if (next)
+        next->finish();
+}
+
+static VectorFilter *createFilter(const string& name, const vector<double>& args, const string& spec)
+{
+    size_t numArgs = args.size();
+    if (name == "decimate" && numArgs == 1 && args[0] >= 1)
+        return new DecimationFilter((long)args[0]);
+    if (name == "average" && numArgs == 1 && args[0] > 0)
+        return new TimeAverageFilter(args[0]);
+    if (name == "envelope" && numArgs == 1 && args[0] > 0)
+        return new EnvelopeFilter(args[0]);
+    if (name == "deadband" && numArgs == 1 && args[0] >= 0)
+        return new DeadbandFilter(args[0]);
+    if (name == "changes" && numArgs == 0)
+        return new DeadbandFilter(0);
+    if (name == "timewindow" && numArgs == 1)
+        return new TimeWindowFilter(args[0], INFINITY);
+    if (name == "timewindow" && numArgs == 2 && args[0] <= args[1])
+        return new TimeWindowFilter(args[0], args[1]);
+    throw ResultRecordingException("Invalid filter `" + name + "' in vector filter spec \"" + spec + "\"");
+}
+
+VectorFilter *VectorFilter::parse(const string& spec)
+{
+    VectorFilter *chain = NULL;
+    try
+    {
+        const char *s = spec.c_str();
+        while (true)
+        {
+            while (isspace(*s))
+                s++;
+            if (!*s)
+                break;
+
+            // filter name
+            const char *nameStart = s;
+            while (isalpha(*s))
+                s++;
+            if (s == nameStart)
+                throw ResultRecordingException("Syntax error in vector filter spec \"" + spec + "\"");
+            string name(nameStart, s);
+
+            // optional argument list
+            vector<double> args;
+            while (isspace(*s))
+                s++;
+            if (*s == '(')
+            {
+                s++;
+                while (true)
+                {
+                    // not strtod(), which would take a decimal comma for the separator
+                    char *end;
+                    args.push_back(opp_strtod_c(s, &end));
+                    if (end == s || isNaN(args.back()))
+                        throw ResultRecordingException("Syntax error in vector filter spec \"" + spec + "\"");
+                    s = end;
+                    while (isspace(*s))
+                        s++;
+                    if (*s == ')')
+                        break;
+                    if (*s++ != ',')
+                        throw ResultRecordingException("Syntax error in vector filter spec \"" + spec + "\"");
+                }
+                s++;
+            }
+
+            VectorFilter *filter = createFilter(name, args, spec);
+            if (chain)
+                chain->append(filter);
+            else
+                chain = filter;
+        }
+    }
+    catch (...)
+    {
+        delete chain;
+        throw;
+    }
+    return chain;
+}
+
+//----
+
+DecimationFilter::DecimationFilter(long n)
+{
+    this->n = n;
+    count = 0;
+}
+
+void DecimationFilter::process(double time, double value)
+{
+    if (count++ == 0)
+        emit(time, value);
+    if (count == n)
+        count = 0;
+}
+
+//----
+
+TimeAverageFilter::TimeAverageFilter(double interval)
+{
+    this->interval = interval;
+    currentInterval = 0;
+    count = 0;
+    sum = 0;
+    lastTime = 0;
+}
+
+void TimeAverageFilter::process(double time, double value)
+{
+    double timeInterval = floor(time / interval);
+    if (count > 0 && timeInterval != currentInterval)
+    {
+        emit(lastTime, sum / count);
+        count = 0;
+        sum = 0;
+    }
+    currentInterval = timeInterval;
+    count++;
+    sum += value;
+    lastTime = time;
+}
+
+void TimeAverageFilter::finish()
+{
+    if (count > 0)
+        emit(lastTime, sum / count);
+    count = 0;
+    VectorFilter::finish();
+}
+
+//----
+
+EnvelopeFilter::EnvelopeFilter(double interval)
+{
+    this->interval = interval;
+    currentInterval = 0;
+    empty = true;
+    minTime = minValue = maxTime = maxValue = 0;
+}
+
+void EnvelopeFilter::process(double time, double value)
+{
+    if (isNaN(value))
+        return;
+
+    double timeInterval = floor(time / interval);
+    if (!empty && timeInterval != currentInterval)
+    {
+        emitEnvelope();
+        empty = true;
+    }
+    currentInterval = timeInterval;
+    if (empty || value < minValue)
+    {
+        minTime = time;
+        minValue = value;
+    }
+    if (empty || value > maxValue)
+    {
+        maxTime = time;
+        maxValue = value;
+    }
+    empty = false;
+}
+
+void EnvelopeFilter::emitEnvelope()
+{
+    // in time order; the minimum wins if they were recorded at the same time
+    if (minValue == maxValue)
+        emit(minTime, minValue);
+    else if (minTime <= maxTime)
+    {
+        emit(minTime, minValue);
+        emit(maxTime, maxValue);
+    }
+    else
+    {
+        emit(maxTime, maxValue);
+        emit(minTime, minValue);
+    }
+}
+
+void EnvelopeFilter::finish()
+{
+    if (!empty)
+        emitEnvelope();
+    empty = true;
+    VectorFilter::finish();
+}
+
+//----
+
+DeadbandFilter::DeadbandFilter(double delta)
+{
+    this->delta = delta;
+    first = true;
+    lastValue = 0;
+}
+
+void DeadbandFilter::process(double time, double value)
+{
+    // a change between NaN and a number always passes
+    bool pass;
+    if (first)
+        pass = true;
+    else if (isNaN(value) || isNaN(lastValue))
+        pass = isNaN(value) != isNaN(lastValue);
+    else
+        pass = fabs(value - lastValue) > delta;
+
+    if (pass)
+    {
+        first = false;
+        lastValue = value;
+        emit(time, value);
+    }
+}
+
+//----
+
+TimeWindowFilter::TimeWindowFilter(double start, double end)
+{
+    this->start = start;
+    this->end = end;
+}
+
+void TimeWindowFilter::process(double time, double value)
+{
+    if (time >= start && time <= end)
+        emit(time, value);
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __VECTORFILTER_H
+#define __VECTORFILTER_H
+
+#include <string>
+
+/**
+ * Data reduction filter for output vectors. Filters form a chain: each one
+ * processes the values it receives, and passes on (emits) values to the next
+ * one. The chain is run by OutputVector::record() before the data is buffered,
+ * so data that is filtered out costs no memory and no I/O.
+ *
+ * Filters may hold back data (e.g. to compute an average over an interval);
+ * finish() is called when the vector is closed, to emit what is left.
+ *
+ * @author Andras
+ */
+class VectorFilter
+{
+  private:
+    VectorFilter *next;
+
+  public:
+    VectorFilter() : next(NULL) {}
+
+    /**
+     * Deletes the rest of the chain as well.
+     */
+    virtual ~VectorFilter();
+
+    /**
+     * Appends a filter to the end of the chain; takes ownership.
+     */
+    void append(VectorFilter *filter);
+
+    /**
+     * Processes a value. Timestamps are non-decreasing.
+     */
+    virtual void process(double time, double value) = 0;
+
+    /**
+     * Emits held back data, and finishes the rest of the chain.
+     */
+    virtual void finish();
+
+    /**
+     * Creates a chain of filters from its textual description (see ATTR_FILTER).
+     * Returns NULL for an empty description; throws ResultRecordingException
+     * on syntax errors.
+     */
+    static VectorFilter *parse(const std::string& spec);
+
+  protected:
+    void emit(double time, double value) {if (next) next->process(time, value);}
+};
+
+/**
+ * Keeps every nth value, starting with the first one.
+ */
+class DecimationFilter : public VectorFilter
+{
+  protected:
+    long n;
+    long count;
+
+  public:
+    DecimationFilter(long n);
+    void process(double time, double value);
+};
+
+/**
+ * Emits the mean of the values in each interval, with the timestamp of the
+ * last value in the interval.
+ */
+class TimeAverageFilter : public VectorFilter
+{
+  protected:
+    double interval;
+    double currentInterval;
+    long count;
+    double sum;
+    double lastTime;
+
+  public:
+    TimeAverageFilter(double interval);
+    void process(double time, double value);
+    void finish();
+};
+
+/**
+ * Emits the minimum and the maximum of the values in each interval, with
+ * their own timestamps (only once if they are the same value).
+ */
+class EnvelopeFilter : public VectorFilter
+{
+  protected:
+    double interval;
+    double currentInterval;
+    bool empty;
+    double minTime, minValue;
+    double maxTime, maxValue;
+
+  public:
+    EnvelopeFilter(double interval);
+    void process(double time, double value);
+    void finish();
+
+  protected:
+    void emitEnvelope();
+};
+
+/**
+ * Keeps only the values that differ from the last kept value by more than
+ * delta. With delta=0, it keeps the values that differ from the previous one.
+ */
+class DeadbandFilter : public VectorFilter
+{
+  protected:
+    double delta;
+    bool first;
+    double lastValue;
+
+  public:
+    DeadbandFilter(double delta);
+    void process(double time, double value);
+};
+
+/**
+ * Keeps only the values recorded in the [start, end] interval.
+ */
+class TimeWindowFilter : public VectorFilter
+{
+  protected:
+    double start;
+    double end;
+
+  public:
+    TimeWindowFilter(double start, double end);
+    void process(double time, double value);
+};
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include "VectorFlushPolicy.h"
+#include "FileOutputVectorManager.h"
+
+using namespace std;
+
+static void selectInOrder(const vector<OutputVector*>& candidates, size_t bytesToFree, vector<OutputVector*>& result)
+{
+    size_t freed = 0;
+    for (vector<OutputVector*>::const_iterator it = candidates.begin(); it != candidates.end() && freed < bytesToFree; ++it)
+    {
+        result.push_back(*it);
+        freed += (*it)->getBufferedBytes();
+    }
+}
+
+static bool largerBuffer(const OutputVector *a, const OutputVector *b)
+{
+    return a->n > b->n;
+}
+
+static bool lessRecentlyRecorded(const OutputVector *a, const OutputVector *b)
+{
+    return a->lastRecorded < b->lastRecorded;
+}
+
+void LargestFirstFlushPolicy::selectVectors(vector<OutputVector*>& candidates, size_t bytesToFree,
+                                            vector<OutputVector*>& result)
+{
+    sort(candidates.begin(), candidates.end(), largerBuffer);
+    selectInOrder(candidates, bytesToFree, result);
+}
+
+void LeastRecentlyUsedFlushPolicy::selectVectors(vector<OutputVector*>& candidates, size_t bytesToFree,
+                                                 vector<OutputVector*>& result)
+{
+    sort(candidates.begin(), candidates.end(), lessRecentlyRecorded);
+    selectInOrder(candidates, bytesToFree, result);
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __VECTORFLUSHPOLICY_H
+#define __VECTORFLUSHPOLICY_H
+
+#include <stddef.h>
+#include <vector>
+
+class OutputVector;
+
+/**
+ * Decides which vectors a FileOutputVectorManager writes out when the data
+ * buffered in memory exceeds its memory budget. Only the selected vectors
+ * are written out, which keeps the latency of the record() call that hits
+ * the budget low.
+ *
+ * @author Andras
+ */
+class VectorFlushPolicy
+{
+  public:
+    virtual ~VectorFlushPolicy() {}
+
+    /**
+     * Appends vectors to result so that writing them out frees at least
+     * bytesToFree bytes, if possible. The candidates all have buffered data;
+     * the policy may reorder them.
+     */
+    virtual void selectVectors(std::vector<OutputVector*>& candidates, size_t bytesToFree,
+                               std::vector<OutputVector*>& result) = 0;
+};
+
+/**
+ * Writes out the vectors with the most buffered data first. This frees the
+ * budget with the fewest (and largest) blocks. This is the default policy.
+ *
+ * @author Andras
+ */
+class LargestFirstFlushPolicy : public VectorFlushPolicy
+{
+  public:
+    void selectVectors(std::vector<OutputVector*>& candidates, size_t bytesToFree,
+                       std::vector<OutputVector*>& result);
+};
+
+/**
+ * Writes out the vectors that have not been recorded for the longest time
+ * first, keeping the buffers of actively recorded vectors in memory.
+ *
+ * @author Andras
+ */
+class LeastRecentlyUsedFlushPolicy : public VectorFlushPolicy
+{
+  public:
+    void selectVectors(std::vector<OutputVector*>& candidates, size_t bytesToFree,
+                       std::vector<OutputVector*>& result);
+};
+
+#endif
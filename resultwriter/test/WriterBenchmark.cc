@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Throughput and latency benchmark for FileOutputVectorManager and
+ * FileOutputScalarManager. Run it without arguments for the defaults, or
+ * with -h for the list of options.
+ *
+ * Samples are recorded in simulation time order into the given number of
+ * vectors; with -z, vector i receives samples at a rate proportional to
+ * 1/(i+1), otherwise all vectors are recorded with the same rate. The latency
+ * of every record() (or recordBatch()) call is measured, and collected into
+ * a histogram with 1/16 relative precision.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include "FileOutputScalarManager.h"
+#include "FileOutputVectorManager.h"
+
+using namespace std;
+
+struct Options
+{
+    int numVectors;
+    long numSamples;
+    double sampleRate;
+    bool skewed;
+    int numAttributes;
+    int perVectorLimit;
+    int totalLimit;
+    int batchSize;
+    bool binary;
+    int compressionLevel;
+    bool async;
+    long numScalars;
+    string fileName;
+    bool keepFiles;
+};
+
+static void usage()
+{
+    printf("Usage: WriterBenchmark [options]\n"
+           "  -v <n>     number of vectors (default 1000)\n"
+           "  -n <n>     total number of samples (default 10000000)\n"
+           "  -r <rate>  samples per simulated second per vector (default 1000)\n"
+           "  -z         skewed sample rates: vector i gets 1/(i+1) of the rate\n"
+           "  -a <n>     number of attributes per vector and scalar (default 2)\n"
+           "  -l <n>     per-vector buffer limit, in samples (default: manager default)\n"
+           "  -t <n>     total buffer limit, in samples (default: manager default)\n"
+           "  -B <n>     record samples in batches of n with recordBatch() (default 1: record())\n"
+           "  -b         binary vector file\n"
+           "  -c <level> compressed binary vector file\n"
+           "  -A         asynchronous writing\n"
+           "  -s <n>     number of scalars (default 100000)\n"
+           "  -o <name>  output file name without extension (default \"benchmark\")\n"
+           "  -k         keep the output files\n");
+}
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static inline long long nanoTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long long fileSize(const string& fileName)
+{
+    struct stat s;
+    return stat(fileName.c_str(), &s) == 0 ? (long long)s.st_size : 0;
+}
+
+/**
+ * Latency histogram: values below 16ns are counted exactly, larger ones
+ * in 16 sub-buckets per power of two.
+ */
+class LatencyHistogram
+{
+  protected:
+    static const int SUB_BUCKETS = 16;
+    vector<long> counts;
+    long total;
+    long long max;
+
+  public:
+    LatencyHistogram() : counts(64 * SUB_BUCKETS), total(0), max(0) {}
+
+    void collect(long long ns)
+    {
+        if (ns < 0)
+            ns = 0;
+        int index;
+        if (ns < SUB_BUCKETS)
+            index = (int)ns;
+        else
+        {
+            int exp = 63 - __builtin_clzll(ns);  // ns >= 2^exp
+            index = (exp - 3) * SUB_BUCKETS + (int)((ns >> (exp - 4)) - SUB_BUCKETS);
+        }
+        counts[index]++;
+        total++;
+        if (ns > max)
+            max = ns;
+    }
+
+    long long getMax() const {return max;}
+
+    /**
+     * Returns the upper bound of the bucket containing the given quantile.
+     */
+    long long getQuantile(double p) const
+    {
+        long rank = (long)(p * total);
+        long cumulated = 0;
+        for (size_t index = 0; index < counts.size(); index++)
+        {
+            cumulated += counts[index];
+            if (cumulated > rank)
+            {
+                if (index < SUB_BUCKETS)
+                    return index;
+                int exp = index / SUB_BUCKETS + 3;
+                long long upper = ((long long)(index % SUB_BUCKETS + SUB_BUCKETS + 1) << (exp - 4)) - 1;
+                return upper < max ? upper : max;
+            }
+        }
+        return max;
+    }
+};
+
+static StringMap makeAttributes(int count, int seed)
+{
+    StringMap attributes;
+    for (int i = 0; i < count; i++)
+    {
+        char name[32], value[32];
+        sprintf(name, "attr%d", i);
+        sprintf(value, "value %d", seed + i);
+        attributes[name] = value;
+    }
+    return attributes;
+}
+
+static void benchmarkVectors(const Options& opt)
+{
+    string vecFileName = opt.fileName + ".vec";
+    string vciFileName = opt.fileName + ".vci";
+
+    FileOutputVectorManager manager(vecFileName.c_str());
+    if (opt.perVectorLimit > 0)
+        manager.setPerVectorBufferLimit(opt.perVectorLimit);
+    if (opt.totalLimit > 0)
+        manager.setTotalBufferLimit(opt.totalLimit);
+    manager.setBinaryFormat(opt.binary);
+    if (opt.compressionLevel > 0)
+        manager.setCompressionLevel(opt.compressionLevel);
+    manager.setAsync(opt.async);
+    manager.open("benchmark-run", makeAttributes(opt.numAttributes, 0));
+
+    // per-vector weights (sample rate relative to the nominal one), and the
+    // cumulative distribution for choosing the vector of the next sample
+    vector<double> weights(opt.numVectors), cumulative(opt.numVectors);
+    double totalWeight = 0;
+    for (int i = 0; i < opt.numVectors; i++)
+    {
+        weights[i] = opt.skewed ? 1.0 / (i + 1) : 1.0;
+        totalWeight += weights[i];
+        cumulative[i] = totalWeight;
+    }
+    double timeStep = 1.0 / (opt.sampleRate * totalWeight);
+
+    vector<IOutputVector *> vectors;
+    for (int i = 0; i < opt.numVectors; i++)
+    {
+        char componentPath[64];
+        sprintf(componentPath, "net.host[%d].app", i);
+        StringMap attributes = makeAttributes(opt.numAttributes, i);
+        vectors.push_back(manager.createVector(componentPath, "throughput", attributes));
+    }
+
+    int batchSize = opt.batchSize > 1 ? opt.batchSize : 1;
+    vector<double> times(batchSize), values(batchSize);
+    LatencyHistogram latencies;
+    double simtime = 0;
+    unsigned int seed = 1;
+
+    double startTime = now();
+    long recorded = 0;
+    while (recorded < opt.numSamples)
+    {
+        // pick a vector
+        seed = seed * 1103515245 + 12345;
+        double r = (seed >> 8) / 16777216.0 * totalWeight;
+        int index = lower_bound(cumulative.begin(), cumulative.end(), r) - cumulative.begin();
+        if (index >= opt.numVectors)
+            index = opt.numVectors - 1;
+        IOutputVector *vector = vectors[index];
+
+        if (batchSize == 1)
+        {
+            simtime += timeStep;
+            double value = (double)(seed & 0xffff) * 0.01;
+            long long t0 = nanoTime();
+            vector->record(simtime, value);
+            latencies.collect(nanoTime() - t0);
+            recorded++;
+        }
+        else
+        {
+            int n = batchSize;
+            if (n > opt.numSamples - recorded)
+                n = opt.numSamples - recorded;
+            for (int i = 0; i < n; i++)
+            {
+                simtime += timeStep;
+                times[i] = simtime;
+                values[i] = (double)((seed + i) & 0xffff) * 0.01;
+            }
+            long long t0 = nanoTime();
+            vector->recordBatch(&times[0], &values[0], n);
+            latencies.collect(nanoTime() - t0);
+            recorded += n;
+        }
+    }
+    double recordingTime = now() - startTime;
+    size_t memoryUsage = manager.getMemoryUsage();
+    manager.close();
+    double totalTime = now() - startTime;
+
+    long long bytes = fileSize(vecFileName) + fileSize(vciFileName);
+    printf("vectors:    %d vectors, %ld samples, %d attributes, %s%s%s\n",
+           opt.numVectors, recorded, opt.numAttributes,
+           opt.compressionLevel > 0 ? "compressed" : opt.binary ? "binary" : "text",
+           opt.async ? ", async" : "", opt.skewed ? ", skewed rates" : "");
+    printf("  buffer limits: %d per vector, %d total\n", manager.getPerVectorBufferLimit(), manager.getTotalBufferLimit());
+    printf("  time:       %.3f s recording, %.3f s total (with close)\n", recordingTime, totalTime);
+    printf("  throughput: %.0f samples/s, %.1f MB/s (%lld bytes)\n", recorded / totalTime, bytes / totalTime / 1e6, bytes);
+    printf("  latency of %s: p50 %lld ns, p99 %lld ns, max %lld ns\n", batchSize == 1 ? "record()" : "recordBatch()",
+           latencies.getQuantile(0.5), latencies.getQuantile(0.99), latencies.getMax());
+    printf("  buffer memory at end of recording: %.1f MB\n", memoryUsage / 1e6);
+
+    if (!opt.keepFiles)
+    {
+        unlink(vecFileName.c_str());
+        unlink(vciFileName.c_str());
+    }
+}
+
+static void benchmarkScalars(const Options& opt)
+{
+    string scaFileName = opt.fileName + ".sca";
+
+    FileOutputScalarManager manager(scaFileName.c_str());
+    manager.open("benchmark-run", makeAttributes(opt.numAttributes, 0));
+    StringMap attributes = makeAttributes(opt.numAttributes, 0);
+
+    double startTime = now();
+    for (long i = 0; i < opt.numScalars; i++)
+    {
+        char componentPath[64], name[32];
+        sprintf(componentPath, "net.host[%ld].app", i / 100);
+        sprintf(name, "scalar%ld", i % 100);
+        manager.recordScalar(componentPath, name, i * 0.01, attributes);
+    }
+    manager.close();
+    double totalTime = now() - startTime;
+
+    long long bytes = fileSize(scaFileName);
+    printf("scalars:    %ld scalars, %d attributes\n", opt.numScalars, opt.numAttributes);
+    printf("  throughput: %.0f scalars/s, %.1f MB/s (%lld bytes)\n", opt.numScalars / totalTime, bytes / totalTime / 1e6, bytes);
+
+    if (!opt.keepFiles)
+        unlink(scaFileName.c_str());
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    opt.numVectors = 1000;
+    opt.numSamples = 10000000;
+    opt.sampleRate = 1000;
+    opt.skewed = false;
+    opt.numAttributes = 2;
+    opt.perVectorLimit = 0;
+    opt.totalLimit = 0;
+    opt.batchSize = 1;
+    opt.binary = false;
+    opt.compressionLevel = 0;
+    opt.async = false;
+    opt.numScalars = 100000;
+    opt.fileName = "benchmark";
+    opt.keepFiles = false;
+
+    int c;
+    while ((c = getopt(argc, argv, "v:n:r:za:l:t:B:bc:As:o:kh")) != -1)
+    {
+        switch (c)
+        {
+            case 'v': opt.numVectors = atoi(optarg); break;
+            case 'n': opt.numSamples = atol(optarg); break;
+            case 'r': opt.sampleRate = atof(optarg); break;
+            case 'z': opt.skewed = true; break;
+            case 'a': opt.numAttributes = atoi(optarg); break;
+            case 'l': opt.perVectorLimit = atoi(optarg); break;
+            case 't': opt.totalLimit = atoi(optarg); break;
+            case 'B': opt.batchSize = atoi(optarg); break;
+            case 'b': opt.binary = true; break;
+            case 'c': opt.compressionLevel = atoi(optarg); break;
+            case 'A': opt.async = true; break;
+            case 's': opt.numScalars = atol(optarg); break;
+            case 'o': opt.fileName = optarg; break;
+            case 'k': opt.keepFiles = true; break;
+            default: usage(); return c == 'h' ? 0 : 1;
+        }
+    }
+    if (opt.numVectors < 1 || opt.sampleRate <= 0)
+    {
+        usage();
+        return 1;
+    }
+
+    try
+    {
+        if (opt.numSamples > 0)
+            benchmarkVectors(opt);
+        if (opt.numScalars > 0)
+            benchmarkScalars(opt);
+    }
+    catch (exception& e)
+    {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("peak memory (max RSS): %.1f MB\n", usage.ru_maxrss / 1024.0);
+    return 0;
+}
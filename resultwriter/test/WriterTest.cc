@@ -0,0 +1,1621 @@
+/*
+ * Copyright (c) 2010, Andras Varga and Opensim Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Opensim Ltd. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Andras Varga or Opensim Ltd. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Behavioural tests for the result writers. Each test writes files into
+ * the current directory, checks them (or the writer's statistics), and
+ * removes them. Run it without arguments; the exit code is the number of
+ * failed checks.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <zlib.h>
+#include "FileOutputVectorManager.h"
+#include "FileOutputScalarManager.h"
+#include "StatisticalSummary.h"
+#include "Histogram.h"
+#include "QuantileSketch.h"
+#include "ResultRecordingException.h"
+
+using namespace std;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) \
+        { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static void removeFiles(const string& baseName)
+{
+    unlink((baseName + ".vec").c_str());
+    unlink((baseName + ".vci").c_str());
+    unlink((baseName + ".sca").c_str());
+}
+
+static string readFile(const string& fileName)
+{
+    string contents;
+    FILE *f = fopen(fileName.c_str(), "rb");
+    if (!f)
+        return contents;
+    char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        contents.append(buffer, n);
+    fclose(f);
+    return contents;
+}
+
+struct Sample
+{
+    double time;
+    double value;
+};
+
+typedef map<string, vector<Sample> > VectorData;  // by "componentPath vectorName"
+
+/*
+ * Reads the vectors of a text vector file. Only the declarations and the
+ * data lines are parsed, which is enough for files written by the tests.
+ */
+static VectorData readTextVectors(const string& fileName)
+{
+    VectorData vectors;
+    map<int, string> names;
+    string contents = readFile(fileName);
+    const char *line = contents.c_str();
+    while (*line)
+    {
+        const char *end = strchr(line, '\n');
+        if (!end)
+            end = line + strlen(line);
+        if (strncmp(line, "vector ", 7) == 0)
+        {
+            char *p;
+            int id = strtol(line + 7, &p, 10);
+            string declaration(p + 1, end - p - 1);
+            names[id] = declaration.substr(0, declaration.rfind(' '));  // drop the column spec
+        }
+        else if (*line >= '0' && *line <= '9')
+        {
+            char *p;
+            int id = strtol(line, &p, 10);
+            Sample sample;
+            sample.time = strtod(p, &p);
+            sample.value = strtod(p, &p);
+            vectors[names[id]].push_back(sample);
+        }
+        line = *end ? end + 1 : end;
+    }
+    return vectors;
+}
+
+static uint64_t getUInt64(const unsigned char *p)
+{
+    uint64_t x = 0;
+    for (int i = 7; i >= 0; i--)
+        x = (x << 8) | p[i];
+    return x;
+}
+
+static double toDouble(uint64_t bits)
+{
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+/*
+ * Reads the vectors of a binary or compressed vector file, locating the
+ * blocks through the index file.
+ */
+static VectorData readBinaryVectors(const string& baseName)
+{
+    VectorData vectors;
+    string data = readFile(baseName + ".vec");
+    string index = readFile(baseName + ".vci");
+    if (data.size() < (size_t)FileOutputVectorManager::BINARY_HEADER_SIZE)
+        return vectors;
+    const unsigned char *file = (const unsigned char *)data.data();
+    bool compressed = file[8] == FileOutputVectorManager::BINARY_COMPRESSED_VERSION;
+
+    map<int, string> names;
+    const char *line = index.c_str();
+    while (*line)
+    {
+        const char *end = strchr(line, '\n');
+        if (!end)
+            end = line + strlen(line);
+        if (strncmp(line, "vector ", 7) == 0)
+        {
+            char *p;
+            int id = strtol(line + 7, &p, 10);
+            string declaration(p + 1, end - p - 1);
+            names[id] = declaration.substr(0, declaration.rfind(' '));
+        }
+        else if (*line >= '0' && *line <= '9')
+        {
+            // block: id offset size startTime endTime count ...
+            char *p;
+            int id = strtol(line, &p, 10);
+            long offset = strtol(p, &p, 10);
+            long size = strtol(p, &p, 10);
+            strtod(p, &p);
+            strtod(p, &p);
+            long count = strtol(p, &p, 10);
+            const unsigned char *block = file + offset;
+            CHECK(offset + size <= (long)data.size());
+            CHECK((long)(block[0] | block[1] << 8 | block[2] << 16 | block[3] << 24) == id);
+            CHECK((long)(block[4] | block[5] << 8 | block[6] << 16 | block[7] << 24) == count);
+            vector<unsigned char> records(count * FileOutputVectorManager::BINARY_RECORD_SIZE);
+            block += FileOutputVectorManager::BINARY_BLOCK_HEADER_SIZE;
+            size -= FileOutputVectorManager::BINARY_BLOCK_HEADER_SIZE;
+            if (compressed)
+            {
+                // all times, then all values, byte-shuffled
+                vector<unsigned char> shuffled(records.size());
+                uLongf length = shuffled.size();
+                CHECK(uncompress(&shuffled[0], &length, block, size) == Z_OK);
+                CHECK(length == shuffled.size());
+                int numDoubles = 2 * count;
+                for (int i = 0; i < numDoubles; i++)
+                {
+                    int dest = i < count ? 16 * i : 16 * (i - count) + 8;
+                    for (int k = 0; k < 8; k++)
+                        records[dest + k] = shuffled[k * numDoubles + i];
+                }
+            }
+            else
+            {
+                CHECK(size == (long)records.size());
+                memcpy(&records[0], block, records.size());
+            }
+            vector<Sample>& samples = vectors[names[id]];
+            for (long i = 0; i < count; i++)
+            {
+                Sample sample;
+                sample.time = toDouble(getUInt64(&records[16 * i]));
+                sample.value = toDouble(getUInt64(&records[16 * i + 8]));
+                samples.push_back(sample);
+            }
+        }
+        line = *end ? end + 1 : end;
+    }
+    return vectors;
+}
+
+static bool equals(const VectorData& a, const VectorData& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (VectorData::const_iterator i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j)
+    {
+        if (i->first != j->first || i->second.size() != j->second.size())
+            return false;
+        for (size_t k = 0; k < i->second.size(); k++)
+        {
+            // nan compares bitwise
+            if (memcmp(&i->second[k], &j->second[k], sizeof(Sample)) != 0)
+                return false;
+        }
+    }
+    return true;
+}
+
+static void writeResults(const string& baseName, bool async)
+{
+    FileOutputVectorManager vectorManager((baseName + ".vec").c_str());
+    FileOutputScalarManager scalarManager((baseName + ".sca").c_str());
+    vectorManager.setAsync(async, 4);
+    vectorManager.setPerVectorBufferLimit(100);
+    scalarManager.setAsync(async, 4);
+    StringMap runAttributes;
+    runAttributes["network"] = "Net";
+    vectorManager.open("async-run", runAttributes);
+    scalarManager.open("async-run", runAttributes);
+    vector<IOutputVector *> vectors;
+    for (int i = 0; i < 10; i++)
+    {
+        char componentPath[64];
+        sprintf(componentPath, "net.host[%d]", i);
+        StringMap attributes;
+        vectors.push_back(vectorManager.createVector(componentPath, "delay", attributes));
+    }
+    for (int i = 0; i < 20000; i++)
+    {
+        vectors[i * 7 % 10]->record(i * 0.001, i % 97 * 0.5);
+        if (i % 100 == 0)
+        {
+            char componentPath[64];
+            sprintf(componentPath, "net.host[%d]", i / 100);
+            scalarManager.recordScalar(componentPath, "count", i, StringMap());
+        }
+    }
+    vectorManager.close();
+    scalarManager.close();
+}
+
+/*
+ * The asynchronous writer thread produces the same files as writing on
+ * the recording thread.
+ */
+static void testAsyncWriter()
+{
+    writeResults("sync", false);
+    writeResults("async", true);
+    string syncVectors = readFile("sync.vec");
+    CHECK(!syncVectors.empty());
+    CHECK(readFile("async.vec") == syncVectors);
+    string syncScalars = readFile("sync.sca");
+    CHECK(!syncScalars.empty());
+    CHECK(readFile("async.sca") == syncScalars);
+    removeFiles("sync");
+    removeFiles("async");
+}
+
+/*
+ * Once the writer thread has failed, recording reports the error, and the
+ * vectors do not keep counting the samples of blocks that were dropped.
+ * Default-constructed managers can be destroyed.
+ */
+static void testAsyncFailure()
+{
+    {
+        FileOutputVectorManager vectorManager;
+        FileOutputScalarManager scalarManager;
+    }
+
+    // writes to /dev/full fail with ENOSPC
+    if (access("/dev/full", W_OK) != 0)
+        return;
+    unlink("full.vec");
+    CHECK(symlink("/dev/full", "full.vec") == 0);
+    {
+        FileOutputVectorManager manager("full.vec");
+        manager.setAsync(true);
+        manager.setPerVectorBufferLimit(100);
+        manager.open("full-run", StringMap());
+        StringMap attributes;
+        // getBufferedBytes() is only public in the implementation class
+        OutputVector *output = static_cast<OutputVector *>(manager.createVector("net.host", "delay", attributes));
+        bool thrown = false;
+        for (int i = 0; i < 10000000 && !thrown; i++)
+        {
+            try
+            {
+                output->record(i, i);
+            }
+            catch (ResultRecordingException&)
+            {
+                thrown = true;
+            }
+        }
+        CHECK(thrown);
+        CHECK(output->getBufferedBytes() == 0);
+
+        thrown = false;
+        try
+        {
+            manager.close();
+        }
+        catch (ResultRecordingException&)
+        {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+    unlink("full.vec");
+    unlink("full.vci");
+    unlink("full.vci.tmp");
+}
+
+/*
+ * OutputFile writes exactly what it is given, whether the data fits into
+ * its buffer or not, and reports the logical position including buffered
+ * data.
+ */
+static void testOutputFile()
+{
+    string expected;
+    {
+        OutputFile out(64);
+        out.setPreallocationSize(4096);
+        out.open("outputfile.txt");
+        for (int i = 0; i < 1000; i++)
+        {
+            // short records, and every 100th one larger than the buffer
+            string record(i % 100 == 99 ? 200 : i % 13 + 1, (char)('a' + i % 26));
+            record += '\n';
+            out << record;
+            expected += record;
+            if (out.tell() != (off_t)expected.size() || out.tellp() != (streampos)expected.size())
+            {
+                CHECK(out.tell() == (off_t)expected.size());
+                CHECK(out.tellp() == (streampos)expected.size());
+                break;
+            }
+        }
+        out.writeAt(0, "XY", 2);
+        expected.replace(0, 2, "XY");
+        out.close();
+        CHECK(out.good());
+    }
+    CHECK(readFile("outputfile.txt") == expected);  // also: preallocation does not change the size
+
+    {
+        OutputFile out(64);
+        out.open("outputfile.txt", true);
+        out << "appended\n";
+        out.close();
+    }
+    CHECK(readFile("outputfile.txt") == expected + "appended\n");
+    unlink("outputfile.txt");
+
+    OutputFile out;
+    bool thrown = false;
+    try
+    {
+        out.open("no-such-directory/outputfile.txt");
+    }
+    catch (ResultRecordingException&)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(!out.is_open());
+}
+
+static double randomDouble()
+{
+    // random bit patterns cover all magnitudes; skip nan and inf
+    while (true)
+    {
+        uint64_t bits = 0;
+        for (int i = 0; i < 4; i++)
+            bits = (bits << 16) ^ (rand() & 0xffff);
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        if (d - d == 0)
+            return d;
+    }
+}
+
+/*
+ * Numbers are written in the shortest form that reads back exactly, and
+ * vector data survives a text file unchanged.
+ */
+static void testNumberFormat()
+{
+    char buffer[OutputFileManager::NUMBER_BUFSIZE];
+    struct { double value; const char *text; } cases[] = {
+        {0, "0"}, {-0.0, "-0"}, {1, "1"}, {0.1, "0.1"}, {-2.5, "-2.5"},
+        {100, "100"}, {1e14, "100000000000000"}, {1e15, "1e+15"}, {1.5e300, "1.5e+300"},
+        {0.0001, "0.0001"}, {0.00001, "1e-05"}, {1.0 / 3, "0.3333333333333333"},
+        {5e-324, "5e-324"}, {1.7976931348623157e308, "1.7976931348623157e+308"},
+        {NAN, "nan"}, {INFINITY, "inf"}, {-INFINITY, "-inf"}
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        char *end = OutputFileManager::formatDouble(buffer, cases[i].value);
+        CHECK(strcmp(buffer, cases[i].text) == 0);
+        CHECK(end == buffer + strlen(buffer));
+    }
+
+    srand(1);
+    for (int i = 0; i < 100000; i++)
+    {
+        double d = randomDouble();
+        OutputFileManager::formatDouble(buffer, d);
+        if (strtod(buffer, NULL) != d)
+        {
+            CHECK(strtod(buffer, NULL) == d);
+            break;
+        }
+
+        // one significant digit less is never enough
+        string mantissa;
+        for (const char *p = buffer; *p && *p != 'e'; p++)
+            if (*p >= '0' && *p <= '9' && (!mantissa.empty() || *p != '0'))
+                mantissa += *p;
+        int digits = mantissa.find_last_not_of('0') + 1;
+        char shorter[40];
+        sprintf(shorter, "%.*e", digits - 2, d);
+        if (digits > 1 && strtod(shorter, NULL) == d)
+        {
+            CHECK(strtod(shorter, NULL) != d);
+            break;
+        }
+    }
+
+    {
+        FileOutputVectorManager manager("numbers.vec");
+        manager.open("numbers-run", StringMap());
+        StringMap attributes;
+        IOutputVector *output = manager.createVector("net.host", "value", attributes);
+        for (int i = 0; i < 10000; i++)
+            output->record(i * 0.1, randomDouble());
+        manager.close();
+    }
+    VectorData vectors = readTextVectors("numbers.vec");
+    const vector<Sample>& samples = vectors["net.host value"];
+    CHECK(samples.size() == 10000);
+    srand(1);
+    for (size_t i = 0; i < samples.size(); i++)
+        if (samples[i].time != i * 0.1 || samples[i].value != randomDouble())
+        {
+            CHECK(samples[i].time == i * 0.1);
+            break;
+        }
+    removeFiles("numbers");
+}
+
+static void writeVectors(const string& baseName, bool binary, int compressionLevel)
+{
+    FileOutputVectorManager manager((baseName + ".vec").c_str());
+    manager.setBinaryFormat(binary);
+    manager.setCompressionLevel(compressionLevel);
+    manager.setPerVectorBufferLimit(1000);
+    manager.open("format-run", StringMap());
+    vector<IOutputVector *> vectors;
+    for (int i = 0; i < 5; i++)
+    {
+        char componentPath[64];
+        sprintf(componentPath, "net.host[%d]", i);
+        StringMap attributes;
+        vectors.push_back(manager.createVector(componentPath, "delay", attributes));
+    }
+    srand(2);
+    for (int i = 0; i < 12345; i++)
+    {
+        double value = i % 10 == 0 ? randomDouble() : i % 100 == 1 ? NAN : i % 50 * 0.25;
+        vectors[i % 5]->record(i * 0.01, value);
+    }
+    manager.close();
+}
+
+/*
+ * Binary and compressed vector files hold exactly the data of the text
+ * format, and the blocks can be located through the index.
+ */
+static void testBinaryFormats()
+{
+    writeVectors("text", false, 0);
+    writeVectors("binary", true, 0);
+    writeVectors("compressed", true, 6);
+    VectorData text = readTextVectors("text.vec");
+    CHECK(text.size() == 5);
+    CHECK(text["net.host[4] delay"].size() == 12345 / 5);
+    CHECK(equals(readBinaryVectors("binary"), text));
+    CHECK(equals(readBinaryVectors("compressed"), text));
+    CHECK(readFile("compressed.vec").size() < readFile("binary.vec").size() / 2);
+    removeFiles("text");
+    removeFiles("binary");
+    removeFiles("compressed");
+}
+
+class CountingFlushPolicy : public LargestFirstFlushPolicy
+{
+  public:
+    int calls;
+    bool valid;
+
+    CountingFlushPolicy() : calls(0), valid(true) {}
+
+    void selectVectors(vector<OutputVector*>& candidates, size_t bytesToFree, vector<OutputVector*>& result)
+    {
+        calls++;
+        valid = valid && bytesToFree > 0;
+        for (size_t i = 0; i < candidates.size(); i++)
+            valid = valid && candidates[i]->getBufferedBytes() > 0;
+        LargestFirstFlushPolicy::selectVectors(candidates, bytesToFree, result);
+    }
+};
+
+// id of the vector of the first block in the index
+static int getFirstBlockVectorId(const string& indexFileName)
+{
+    string index = readFile(indexFileName);
+    const char *line = index.c_str();
+    while (*line && !(*line >= '0' && *line <= '9'))
+    {
+        line = strchr(line, '\n');
+        line = line ? line + 1 : "";
+    }
+    return atoi(line);
+}
+
+/*
+ * Ten vectors are recorded first, then a single one until the memory budget
+ * is exceeded; returns the vector whose block is written out first.
+ */
+static int getFirstFlushedVector(VectorFlushPolicy *policy)
+{
+    {
+        FileOutputVectorManager manager("policy.vec");
+        manager.setPerVectorBufferLimit(100000);
+        manager.setTotalBufferLimit(4000);
+        manager.setMinBlockSize(1);
+        manager.setFlushPolicy(policy);
+        manager.open("policy-run", StringMap());
+        vector<IOutputVector *> vectors;
+        for (int i = 0; i <= 10; i++)
+        {
+            char componentPath[64];
+            sprintf(componentPath, "net.host[%d]", i);
+            StringMap attributes;
+            vectors.push_back(manager.createVector(componentPath, "delay", attributes));
+        }
+        for (int i = 0; i < 2000; i++)
+            vectors[i % 10]->record(i, i);
+        for (int i = 0; i < 2500; i++)
+            vectors[10]->record(i, i);
+        manager.close();
+    }
+    int id = getFirstBlockVectorId("policy.vci");
+    removeFiles("policy");
+    return id;
+}
+
+/*
+ * When the memory budget is exceeded, the flush policy decides which
+ * vectors are written out.
+ */
+static void testFlushPolicy()
+{
+    CountingFlushPolicy *counting = new CountingFlushPolicy();
+    {
+        FileOutputVectorManager manager("policy.vec");
+        manager.setTotalBufferLimit(1000);
+        manager.setFlushPolicy(counting);
+        manager.open("policy-run", StringMap());
+        vector<IOutputVector *> vectors;
+        for (int i = 0; i < 20; i++)
+        {
+            char componentPath[64];
+            sprintf(componentPath, "net.host[%d]", i);
+            StringMap attributes;
+            vectors.push_back(manager.createVector(componentPath, "delay", attributes));
+        }
+        for (int i = 0; i < 10000; i++)
+            vectors[i % 20]->record(i, i);
+        CHECK(counting->calls > 0);
+        CHECK(counting->valid);
+        manager.close();
+        CHECK(manager.getStatistics().totalLimitFlushes > 0);
+    }
+    removeFiles("policy");
+
+    // the largest buffer is the last vector's, the least recently used one the first vector's
+    CHECK(getFirstFlushedVector(new LargestFirstFlushPolicy()) == 11);
+    CHECK(getFirstFlushedVector(new LeastRecentlyUsedFlushPolicy()) == 1);
+}
+
+struct ChunkRelease
+{
+    VectorChunkPool *pool;
+    VectorChunk *chunks;
+};
+
+static void *releaseChunks(void *arg)
+{
+    ChunkRelease *release = (ChunkRelease *)arg;
+    release->pool->release(release->chunks);
+    return NULL;
+}
+
+/*
+ * Released chunks are reused, also when another thread (like the writer
+ * thread) releases them, so the pool stops growing once it has reached the
+ * peak need of the recording.
+ */
+static void testChunkPool()
+{
+    const int numChunks = 1000;
+    {
+        VectorChunkPool pool;
+        vector<VectorChunk *> chunks;
+        VectorChunk *list = NULL;
+        bool empty = true;
+        for (int i = 0; i < numChunks; i++)
+        {
+            VectorChunk *chunk = pool.acquire();
+            empty = empty && chunk->n == 0 && chunk->next == NULL;
+            chunk->n = 1;
+            chunk->next = list;
+            list = chunk;
+            chunks.push_back(chunk);
+        }
+        CHECK(empty);
+        sort(chunks.begin(), chunks.end());
+        CHECK(unique(chunks.begin(), chunks.end()) == chunks.end());
+        size_t allocated = pool.getAllocatedBytes();
+        CHECK(allocated >= numChunks * sizeof(VectorChunk));
+        CHECK(pool.getUsedBytes() >= numChunks * sizeof(VectorChunk));
+        CHECK(pool.getPeakUsedBytes() >= numChunks * sizeof(VectorChunk));
+
+        // the releasing thread gives the chunks back to the pool when it exits
+        ChunkRelease release = {&pool, list};
+        pthread_t thread;
+        pthread_create(&thread, NULL, releaseChunks, &release);
+        pthread_join(thread, NULL);
+        CHECK(pool.getUsedBytes() <= VectorChunkPool::CACHE_BATCH * sizeof(VectorChunk));
+
+        for (int round = 0; round < 3; round++)
+        {
+            list = NULL;
+            for (int i = 0; i < numChunks; i++)
+            {
+                VectorChunk *chunk = pool.acquire();
+                chunk->next = list;
+                list = chunk;
+            }
+            pool.release(list);
+        }
+        CHECK(pool.getAllocatedBytes() == allocated);
+    }
+
+    // the memory of a manager does not grow once blocks are being written out
+    {
+        FileOutputVectorManager manager("pool.vec");
+        manager.setPerVectorBufferLimit(1000);
+        manager.open("pool-run", StringMap());
+        vector<IOutputVector *> vectors;
+        for (int i = 0; i < 10; i++)
+        {
+            char componentPath[64];
+            sprintf(componentPath, "net.host[%d]", i);
+            StringMap attributes;
+            vectors.push_back(manager.createVector(componentPath, "delay", attributes));
+        }
+        for (int i = 0; i < 20000; i++)
+            vectors[i % 10]->record(i * 0.001, i);
+        size_t memoryUsage = manager.getMemoryUsage();
+        for (int i = 20000; i < 200000; i++)
+            vectors[i % 10]->record(i * 0.001, i);
+        CHECK(manager.getMemoryUsage() == memoryUsage);
+        manager.close();
+        CHECK(manager.getStatistics().samples == 200000);
+    }
+    removeFiles("pool");
+}
+
+static bool isClose(double a, double b, double relativeError)
+{
+    return fabs(a - b) <= relativeError * fabs(b);
+}
+
+/*
+ * The statistics objects are accurate, and merging objects that collected
+ * parts of the data gives the same result as collecting all of it.
+ */
+static void testStatistics()
+{
+    const int n = 100000;
+    vector<double> values;
+    srand(3);
+    for (int i = 0; i < n; i++)
+        values.push_back(1e9 + rand() % 1000 * 0.125);  // large offset, small spread
+
+    StatisticalSummary parts[2], all;
+    Histogram histogramParts[2];
+    QuantileSketch sketchParts[2];
+    for (int i = 0; i < n; i++)
+    {
+        parts[i % 2].collect(values[i]);
+        histogramParts[i % 2].collect(values[i]);
+        sketchParts[i % 2].collect(values[i]);
+        all.collect(values[i]);
+    }
+    parts[0].merge(parts[1]);
+    histogramParts[0].merge(histogramParts[1]);
+    sketchParts[0].merge(sketchParts[1]);
+
+    // two-pass reference values
+    double sum = 0;
+    for (int i = 0; i < n; i++)
+        sum += values[i];
+    double mean = sum / n;
+    double m2 = 0;
+    for (int i = 0; i < n; i++)
+        m2 += (values[i] - mean) * (values[i] - mean);
+    double variance = m2 / (n - 1);
+
+    CHECK(all.getN() == n);
+    CHECK(isClose(all.getMean(), mean, 1e-12));
+    CHECK(isClose(all.getVariance(), variance, 1e-9));
+    CHECK(parts[0].getN() == n);
+    CHECK(isClose(parts[0].getMean(), mean, 1e-12));
+    CHECK(isClose(parts[0].getVariance(), variance, 1e-9));
+    CHECK(parts[0].getMin() == all.getMin() && parts[0].getMax() == all.getMax());
+
+    // weighted: weight 2 is the same as collecting the value twice
+    StatisticalSummary weighted, repeated;
+    for (int i = 0; i < 1000; i++)
+    {
+        weighted.collect(values[i], i % 2 ? 2 : 1);
+        repeated.collect(values[i]);
+        if (i % 2)
+            repeated.collect(values[i]);
+    }
+    CHECK(weighted.isWeighted());
+    CHECK(isClose(weighted.getWeights(), 1500, 1e-15));
+    CHECK(isClose(weighted.getMean(), repeated.getMean(), 1e-15));
+
+    // every value is in the cell that covers it
+    Histogram& histogram = histogramParts[0];
+    CHECK(histogram.getN() == n);
+    int numCells = histogram.getNumCells();
+    CHECK(numCells > 1 && numCells <= Histogram::DEFAULT_NUM_CELLS);
+    vector<double> counts(numCells, 0);
+    for (int i = 0; i < n; i++)
+    {
+        int k = 0;
+        while (k < numCells - 1 && values[i] >= histogram.getCellBoundary(k + 1))
+            k++;
+        counts[k]++;
+    }
+    CHECK(histogram.getCellBoundary(0) <= all.getMin());
+    CHECK(histogram.getCellBoundary(numCells) > all.getMax());
+    for (int k = 0; k < numCells; k++)
+        if (histogram.getCellValue(k) != counts[k])
+        {
+            CHECK(histogram.getCellValue(k) == counts[k]);
+            break;
+        }
+    CHECK(histogram.getUnderflowCell() == 0 && histogram.getOverflowCell() == 0);
+
+    // quantiles within a small fraction of the spread
+    sort(values.begin(), values.end());
+    double ps[] = {0.01, 0.25, 0.5, 0.9, 0.99};
+    double spread = values[n - 1] - values[0];
+    for (size_t i = 0; i < sizeof(ps) / sizeof(ps[0]); i++)
+    {
+        double exact = values[(int)(ps[i] * (n - 1))];
+        CHECK(fabs(sketchParts[0].getQuantile(ps[i]) - exact) < 0.01 * spread);
+    }
+    CHECK(sketchParts[0].getN() == n);
+}
+
+// input of the filter tests: time i/4, value i/3 mod 7 (so each value is repeated)
+static double filterInputValue(int i)
+{
+    return i / 3 % 7;
+}
+
+/*
+ * Record-time filters reduce the data as their specs say, and invalid
+ * specs are rejected.
+ */
+static void testFilters()
+{
+    const int n = 1000;
+    const char *specs[] = {"decimate(10)", "timewindow(10, 20)", "changes", "average(10)",
+                           "envelope(10)", "timewindow(10,20) decimate(2)"};
+    const int numSpecs = sizeof(specs) / sizeof(specs[0]);
+    int passed = 0;
+    {
+        FileOutputVectorManager manager("filter.vec");
+        manager.open("filter-run", StringMap());
+        vector<IOutputVector *> vectors;
+        for (int k = 0; k < numSpecs; k++)
+        {
+            char name[16];
+            sprintf(name, "v%d", k);
+            StringMap attributes;
+            attributes[ATTR_FILTER] = specs[k];
+            vectors.push_back(manager.createVector("net.host", name, attributes));
+        }
+        for (int i = 0; i < n; i++)
+            for (int k = 0; k < numSpecs; k++)
+            {
+                bool stored = vectors[k]->record(i / 4.0, filterInputValue(i));
+                if (k == 0 && stored)
+                    passed++;
+            }
+
+        const char *invalidSpecs[] = {"decimate(0)", "decimate(x)", "decimate(1", "nosuchfilter", "timewindow(2,1)"};
+        for (size_t k = 0; k < sizeof(invalidSpecs) / sizeof(invalidSpecs[0]); k++)
+        {
+            StringMap attributes;
+            attributes[ATTR_FILTER] = invalidSpecs[k];
+            bool thrown = false;
+            try
+            {
+                manager.createVector("net.host", "invalid", attributes);
+            }
+            catch (ResultRecordingException& e)
+            {
+                thrown = strstr(e.what(), "net.host invalid") != NULL;
+            }
+            CHECK(thrown);
+        }
+        manager.close();
+    }
+    CHECK(passed == n / 10);
+
+    // reference results
+    vector<Sample> expected[numSpecs];
+    double sum = 0, minValue = 0, maxValue = 0, minTime = 0, maxTime = 0;
+    int count = 0;
+    for (int i = 0; i < n; i++)
+    {
+        Sample sample = {i / 4.0, filterInputValue(i)};
+        if (i % 10 == 0)
+            expected[0].push_back(sample);
+        if (sample.time >= 10 && sample.time <= 20)
+            expected[1].push_back(sample);
+        if (i == 0 || sample.value != filterInputValue(i - 1))
+            expected[2].push_back(sample);
+        if (count == 0 || sample.value < minValue)
+        {
+            minValue = sample.value;
+            minTime = sample.time;
+        }
+        if (count == 0 || sample.value > maxValue)
+        {
+            maxValue = sample.value;
+            maxTime = sample.time;
+        }
+        sum += sample.value;
+        count++;
+        if (i % 40 == 39)  // last sample of a 10s interval
+        {
+            Sample average = {sample.time, sum / count};
+            expected[3].push_back(average);
+            Sample low = {minTime, minValue}, high = {maxTime, maxValue};
+            expected[4].push_back(minTime <= maxTime ? low : high);
+            expected[4].push_back(minTime <= maxTime ? high : low);
+            sum = 0;
+            count = 0;
+        }
+    }
+    for (size_t i = 0; i < expected[1].size(); i += 2)
+        expected[5].push_back(expected[1][i]);
+
+    VectorData vectors = readTextVectors("filter.vec");
+    for (int k = 0; k < numSpecs; k++)
+    {
+        char name[32];
+        sprintf(name, "net.host v%d", k);
+        VectorData actual, reference;
+        actual[name] = vectors[name];
+        reference[name] = expected[k];
+        if (!equals(actual, reference))
+        {
+            fprintf(stderr, "filter \"%s\": ", specs[k]);
+            CHECK(equals(actual, reference));
+        }
+    }
+    removeFiles("filter");
+}
+
+static bool fileExists(const string& fileName)
+{
+    return access(fileName.c_str(), F_OK) == 0;
+}
+
+/*
+ * The index only appears when the vector file is complete, and its first
+ * line records the size and modification time of the vector file.
+ */
+static void testIndexFingerprint()
+{
+    {
+        FileOutputVectorManager manager("fingerprint.vec");
+        manager.open("fingerprint-run", StringMap());
+        StringMap attributes;
+        IOutputVector *output = manager.createVector("net.host", "delay", attributes);
+        for (int i = 0; i < 5000; i++)
+            output->record(i, i);
+        manager.flush();
+        CHECK(fileExists("fingerprint.vec"));
+        CHECK(fileExists("fingerprint.vci.tmp"));
+        CHECK(!fileExists("fingerprint.vci"));
+        manager.close();
+    }
+    CHECK(!fileExists("fingerprint.vci.tmp"));
+
+    struct stat s;
+    CHECK(stat("fingerprint.vec", &s) == 0);
+    long size = -1, mtime = -1;
+    string index = readFile("fingerprint.vci");
+    CHECK(sscanf(index.c_str(), "file %ld %ld", &size, &mtime) == 2);
+    CHECK(size == (long)s.st_size);
+    CHECK(mtime == (long)s.st_mtime);
+    CHECK(index.find("\nversion 2\n") != string::npos);
+    removeFiles("fingerprint");
+}
+
+enum ScalarMode {SINGLE, BATCH, BUFFERED};
+
+static void writeScalars(const string& baseName, ScalarMode mode)
+{
+    FileOutputScalarManager manager((baseName + ".sca").c_str());
+    manager.setBuffered(mode == BUFFERED);
+    manager.open("scalar-run", StringMap());
+    const int count = 1000;
+    vector<string> componentPaths(count);
+    vector<const char *> componentPathPtrs(count), names(count);
+    vector<double> values(count);
+    vector<StringMap> attributes(count);
+    for (int i = 0; i < count; i++)
+    {
+        char componentPath[64];
+        sprintf(componentPath, "net.host[%d]", i / 10);
+        componentPaths[i] = componentPath;
+        componentPathPtrs[i] = componentPaths[i].c_str();
+        names[i] = i % 2 ? "sent" : "received count";  // needs quoting
+        values[i] = i * 1.5;
+        if (i % 100 == 0)
+            attributes[i]["unit"] = "s";
+    }
+    if (mode == BATCH)
+        manager.recordScalars(&componentPathPtrs[0], &names[0], &values[0], count, &attributes[0]);
+    else
+        for (int i = 0; i < count; i++)
+            manager.recordScalar(componentPathPtrs[i], names[i], values[i], attributes[i]);
+
+    Histogram histogram;
+    for (int i = 0; i < 1000; i++)
+        histogram.collect(i % 37);
+    manager.recordStatistic("net", "histogram", &histogram, StringMap());
+
+    // buffered results only reach the file at flush()
+    if (mode == BUFFERED)
+        CHECK(readFile(baseName + ".sca").find("scalar ") == string::npos);
+    manager.close();
+}
+
+/*
+ * Scalars recorded in a batch, or in buffered mode, give the same file as
+ * recording them one by one.
+ */
+static void testScalarModes()
+{
+    writeScalars("single", SINGLE);
+    writeScalars("batch", BATCH);
+    writeScalars("buffered", BUFFERED);
+    string single = readFile("single.sca");
+    CHECK(single.find("scalar net.host[99] sent 1498.5\n") != string::npos);
+    CHECK(single.find("scalar net.host[0] \"received count\" 0\nattr unit s\n") != string::npos);
+    CHECK(single.find("statistic net histogram\n") != string::npos);
+    CHECK(readFile("batch.sca") == single);
+    CHECK(readFile("buffered.sca") == single);
+    removeFiles("single");
+    removeFiles("batch");
+    removeFiles("buffered");
+}
+
+static void writeBatches(const string& baseName, bool batch)
+{
+    FileOutputVectorManager manager((baseName + ".vec").c_str());
+    manager.setPerVectorBufferLimit(250);
+    manager.setTotalBufferLimit(2000);
+    manager.open("batch-run", StringMap());
+    vector<IOutputVector *> vectors;
+    for (int i = 0; i < 8; i++)
+    {
+        char componentPath[64];
+        sprintf(componentPath, "net.host[%d]", i);
+        StringMap attributes;
+        if (i == 7)
+            attributes[ATTR_FILTER] = "decimate(3)";
+        vectors.push_back(manager.createVector(componentPath, "delay", attributes));
+    }
+    srand(4);
+    double times[300], values[300];
+    double now = 0;
+    for (int r = 0; r < 2000; r++)
+    {
+        IOutputVector *output = vectors[rand() % vectors.size()];
+        int n = 1 + rand() % 300;
+        for (int i = 0; i < n; i++)
+        {
+            times[i] = now;
+            values[i] = rand() % 1000;
+            if (rand() % 4)
+                now += 0.5;  // some timestamps repeat
+        }
+        if (batch)
+            output->recordBatch(times, values, n);
+        else
+            for (int i = 0; i < n; i++)
+                output->record(times[i], values[i]);
+    }
+    manager.close();
+}
+
+static string skipFirstLine(const string& s)
+{
+    size_t pos = s.find('\n');
+    return pos == string::npos ? "" : s.substr(pos + 1);
+}
+
+/*
+ * Recording a batch is the same as recording its values one by one, and
+ * the timestamp order is checked for batches too.
+ */
+static void testBatchRecording()
+{
+    writeBatches("single", false);
+    writeBatches("batch", true);
+    string single = readFile("single.vec");
+    CHECK(!single.empty());
+    CHECK(readFile("batch.vec") == single);
+    // the index too, apart from the fingerprint (which has the modification time)
+    CHECK(skipFirstLine(readFile("batch.vci")) == skipFirstLine(readFile("single.vci")));
+    removeFiles("single");
+    removeFiles("batch");
+
+    FileOutputVectorManager manager("batch.vec");
+    manager.open("batch-run", StringMap());
+    StringMap attributes;
+    IOutputVector *output = manager.createVector("net.host", "delay", attributes);
+    double times[] = {1, 2, 1.5}, values[] = {1, 2, 3};
+    CHECK(output->recordBatch(times, values, 2) == 2);
+    bool thrown = false;
+    try
+    {
+        output->recordBatch(times + 1, values + 1, 2);  // 2, then 1.5
+    }
+    catch (ResultRecordingException&)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(output->recordBatch(times, values, 0) == 0);
+    manager.close();
+    removeFiles("batch");
+}
+
+/*
+ * Short-lived vectors, created and closed among long-lived ones: closing a
+ * vector writes out its own data only, and no data is lost.
+ */
+static void testVectorChurn()
+{
+    const int numLongLived = 50;
+    const int numShortLived = 5000;
+    bool ownBlockOnly = true;
+    {
+        FileOutputVectorManager manager("churn.vec");
+        manager.open("churn-run", StringMap());
+        vector<IOutputVector *> longLived;
+        for (int i = 0; i < numLongLived; i++)
+        {
+            char componentPath[64];
+            sprintf(componentPath, "net.host[%d]", i);
+            StringMap attributes;
+            longLived.push_back(manager.createVector(componentPath, "delay", attributes));
+        }
+        OutputVector *closed = NULL;
+        for (int i = 0; i < numShortLived; i++)
+        {
+            char componentPath[64];
+            sprintf(componentPath, "net.flow[%d]", i);
+            StringMap attributes;
+            // close() is only public in the implementation class
+            OutputVector *output = static_cast<OutputVector *>(manager.createVector(componentPath, "delay", attributes));
+            for (int k = 0; k < 3; k++)
+            {
+                output->record(i, k);
+                longLived[(i + k) % numLongLived]->record(i, k);
+            }
+            long blocks = manager.getStatistics().blocks;
+            output->close();
+            ownBlockOnly = ownBlockOnly && manager.getStatistics().blocks == blocks + 1;
+            closed = output;
+        }
+
+        bool thrown = false;
+        try
+        {
+            closed->record(numShortLived, 0);
+        }
+        catch (ResultRecordingException&)
+        {
+            thrown = true;
+        }
+        CHECK(thrown);
+        manager.close();
+    }
+    CHECK(ownBlockOnly);
+
+    VectorData vectors = readTextVectors("churn.vec");
+    CHECK(vectors.size() == (size_t)(numLongLived + numShortLived));
+    CHECK(vectors["net.flow[0] delay"].size() == 3);
+    CHECK(vectors["net.flow[4999] delay"].size() == 3);
+    size_t total = 0;
+    for (VectorData::iterator it = vectors.begin(); it != vectors.end(); ++it)
+        total += it->second.size();
+    CHECK(total == (size_t)(6 * numShortLived));
+    removeFiles("churn");
+}
+
+static long getAttribute(const string& contents, const string& name)
+{
+    size_t pos = contents.find("\nattr " + name + " ");
+    return pos == string::npos ? -1 : atol(contents.c_str() + pos + name.size() + 7);
+}
+
+/*
+ * The writer statistics agree with what has been written, and they are
+ * stored in the run header when statistics attributes are turned on.
+ */
+static void testWriterStatistics()
+{
+    const int numVectors = 10;
+    const int numSamples = 1234;
+    WriterStatistics stats;
+    size_t memoryUsage;
+    {
+        FileOutputVectorManager manager("stats.vec");
+        manager.setStatisticsAttributes(true);
+        manager.setPerVectorBufferLimit(100);
+        manager.open("stats-run", StringMap());
+        vector<IOutputVector *> vectors;
+        for (int i = 0; i < numVectors; i++)
+        {
+            char componentPath[64];
+            sprintf(componentPath, "net.host[%d]", i);
+            StringMap attributes;
+            vectors.push_back(manager.createVector(componentPath, "delay", attributes));
+        }
+        for (int k = 0; k < numSamples; k++)
+            for (int i = 0; i < numVectors; i++)
+                vectors[i]->record(k, k);
+        manager.close();
+        stats = manager.getStatistics();
+        memoryUsage = manager.getMemoryUsage();
+    }
+    string data = readFile("stats.vec");
+    string index = readFile("stats.vci");
+    int blockLines = 0;
+    size_t pos = 0;
+    while (pos < index.size())
+    {
+        if (index[pos] >= '0' && index[pos] <= '9')
+            blockLines++;
+        pos = index.find('\n', pos);
+        pos = pos == string::npos ? index.size() : pos + 1;
+    }
+
+    CHECK(stats.samples == numVectors * numSamples);
+    CHECK(stats.blocks == blockLines);
+    CHECK(stats.bytes == (long)(data.size() + index.size()));
+    CHECK(stats.perVectorLimitFlushes == numVectors * (numSamples / 101));  // blocks of limit+1 samples
+    CHECK(stats.totalLimitFlushes == 0);
+    // at some point all vectors had 100 samples buffered; the peak counts whole chunks
+    CHECK(stats.peakBufferedBytes >= (size_t)(numVectors * 100 * OutputVector::BYTES_PER_SAMPLE));
+    CHECK(stats.peakBufferedBytes <= memoryUsage);
+    CHECK(getAttribute(data, "vectorwriter.samples") == stats.samples);
+    CHECK(getAttribute(data, "vectorwriter.blocks") == stats.blocks);
+    CHECK(getAttribute(index, "vectorwriter.samples") == stats.samples);
+    CHECK(data.find("n/a") == string::npos);
+    removeFiles("stats");
+
+    {
+        FileOutputScalarManager manager("stats.sca");
+        manager.setStatisticsAttributes(true);
+        manager.open("stats-run", StringMap());
+        for (int i = 0; i < 5; i++)
+            manager.recordScalar("net", "count", i, StringMap());
+        StatisticalSummary summary;
+        summary.collect(1);
+        manager.recordStatistic("net", "delay", &summary, StringMap());
+        manager.close();
+        stats = manager.getStatistics();
+    }
+    string scalars = readFile("stats.sca");
+    CHECK(stats.samples == 6);
+    CHECK(stats.bytes == (long)scalars.size());
+    CHECK(getAttribute(scalars, "scalarwriter.samples") == 6);
+    removeFiles("stats");
+}
+
+/*
+ * Many vectors with a few samples each: the memory budget is accounted by
+ * samples, so a handful of buffered samples per vector must not cause a
+ * flush at every record() call.
+ */
+static void testSparseVectors()
+{
+    const int numVectors = 2000;
+    const int numSamples = 200000;
+    {
+        FileOutputVectorManager manager("sparse.vec");
+        manager.setTotalBufferLimit(100000);
+        manager.open("sparse-run", StringMap());
+        vector<IOutputVector *> vectors;
+        for (int i = 0; i < numVectors; i++)
+        {
+            char componentPath[64];
+            sprintf(componentPath, "net.host[%d]", i);
+            StringMap attributes;
+            vectors.push_back(manager.createVector(componentPath, "delay", attributes));
+        }
+        for (int i = 0; i < numSamples; i++)
+            vectors[i % numVectors]->record(i * 0.001, i);
+        manager.close();
+        WriterStatistics stats = manager.getStatistics();
+
+        CHECK(stats.samples == numSamples);
+        CHECK(stats.totalLimitFlushes > 0);
+        CHECK(stats.blocks < numSamples / 20);
+    }
+    removeFiles("sparse");
+}
+
+struct RecordingThread
+{
+    FileOutputVectorManager *manager;
+    int index;
+    int numVectors;
+    int numSamples;
+};
+
+static void *recordVectors(void *arg)
+{
+    RecordingThread *thread = (RecordingThread *)arg;
+    vector<IOutputVector *> vectors;
+    for (int i = 0; i < thread->numVectors; i++)
+    {
+        char componentPath[64];
+        sprintf(componentPath, "net.host[%d].app[%d]", thread->index, i);
+        StringMap attributes;
+        vectors.push_back(thread->manager->createVector(componentPath, "delay", attributes));
+    }
+    for (int i = 0; i < thread->numSamples; i++)
+        vectors[i % thread->numVectors]->record(i * 0.001, i);
+    return NULL;
+}
+
+/*
+ * Several threads recording in concurrent mode: the total buffer limit is
+ * enforced, and no data is lost.
+ */
+static void testConcurrentBudget()
+{
+    const int numThreads = 4;
+    const int numVectors = 100;
+    const int numSamples = 50000;
+    {
+        FileOutputVectorManager manager("concurrent.vec");
+        manager.setConcurrent(true);
+        manager.setPerVectorBufferLimit(100000);
+        manager.setTotalBufferLimit(10000);
+        manager.open("concurrent-run", StringMap());
+        vector<RecordingThread> threads(numThreads);
+        vector<pthread_t> threadIds(numThreads);
+        for (int t = 0; t < numThreads; t++)
+        {
+            threads[t].manager = &manager;
+            threads[t].index = t;
+            threads[t].numVectors = numVectors;
+            threads[t].numSamples = numSamples;
+            pthread_create(&threadIds[t], NULL, recordVectors, &threads[t]);
+        }
+        for (int t = 0; t < numThreads; t++)
+            pthread_join(threadIds[t], NULL);
+        manager.close();
+        WriterStatistics stats = manager.getStatistics();
+
+        CHECK(stats.samples == numThreads * numSamples);
+        CHECK(stats.perVectorLimitFlushes == 0);
+        CHECK(stats.totalLimitFlushes > 0);
+    }
+
+    // every vector has all of its samples, in order
+    VectorData vectors = readTextVectors("concurrent.vec");
+    CHECK(vectors.size() == (size_t)(numThreads * numVectors));
+    for (VectorData::iterator it = vectors.begin(); it != vectors.end(); ++it)
+    {
+        const vector<Sample>& samples = it->second;
+        CHECK(samples.size() == (size_t)(numSamples / numVectors));
+        int first = samples.empty() ? 0 : (int)samples[0].value;
+        for (size_t i = 0; i < samples.size(); i++)
+            if (samples[i].value != first + (double)i * numVectors)
+            {
+                CHECK(samples[i].value == first + (double)i * numVectors);
+                break;
+            }
+    }
+    removeFiles("concurrent");
+}
+
+/*
+ * Reads the vectors of all shards listed in a manifest, and checks that no
+ * vector is split between shards.
+ */
+static VectorData readShardedVectors(const string& baseName, vector<string>& shardFileNames)
+{
+    VectorData vectors;
+    string manifest = readFile(baseName + ".vmf");
+    size_t pos = 0;
+    while ((pos = manifest.find("\nshard ", pos)) != string::npos)
+    {
+        pos += 7;
+        string shardFileName = manifest.substr(pos, manifest.find('\n', pos) - pos);
+        shardFileNames.push_back(shardFileName);
+        VectorData shard = readTextVectors(shardFileName);
+        for (VectorData::iterator it = shard.begin(); it != shard.end(); ++it)
+        {
+            CHECK(vectors.find(it->first) == vectors.end());
+            vectors[it->first] = it->second;
+        }
+    }
+    return vectors;
+}
+
+static void removeShards(const string& baseName, const vector<string>& shardFileNames)
+{
+    for (size_t i = 0; i < shardFileNames.size(); i++)
+        removeFiles(shardFileNames[i].substr(0, shardFileNames[i].length() - 4));
+    unlink((baseName + ".vmf").c_str());
+}
+
+/*
+ * Sharded output: vectors are distributed over the shards by count or by
+ * size, the manifest lists every shard, and all data can be read back.
+ */
+static void testSharding()
+{
+    const int numVectors = 10;
+    const int numSamples = 1000;
+
+    // by vector count
+    {
+        FileOutputVectorManager manager("sharded.vec");
+        manager.setShardVectorCount(3);
+        manager.open("sharded-run", StringMap());
+        vector<IOutputVector *> vectors;
+        for (int i = 0; i < numVectors; i++)
+        {
+            char componentPath[64];
+            sprintf(componentPath, "net.host[%d]", i);
+            StringMap attributes;
+            vectors.push_back(manager.createVector(componentPath, "delay", attributes));
+        }
+        bool thrown = false;
+        try
+        {
+            manager.setShardVectorCount(5);
+        }
+        catch (ResultRecordingException&)
+        {
+            thrown = true;
+        }
+        CHECK(thrown);
+        for (int i = 0; i < numVectors * numSamples; i++)
+            vectors[i % numVectors]->record(i * 0.001, i);
+        manager.close();
+    }
+    CHECK(!fileExists("sharded.vec"));
+    CHECK(readFile("sharded.vmf").find("run sharded-run\n") != string::npos);
+    vector<string> shardFileNames;
+    VectorData vectors = readShardedVectors("sharded", shardFileNames);
+    CHECK(shardFileNames.size() == 4 && shardFileNames[3] == "sharded-3.vec");
+    CHECK(readTextVectors("sharded-1.vec").size() == 3);
+    CHECK(fileExists("sharded-0.vci"));
+    CHECK(vectors.size() == (size_t)numVectors);
+    for (VectorData::iterator it = vectors.begin(); it != vectors.end(); ++it)
+        CHECK(it->second.size() == (size_t)numSamples);
+    removeShards("sharded", shardFileNames);
+
+    // by size: each vector fills its shard before the next one is created
+    {
+        FileOutputVectorManager manager("sharded.vec");
+        manager.setShardSize(10000);
+        manager.open("sharded-run", StringMap());
+        for (int i = 0; i < numVectors; i++)
+        {
+            char componentPath[64];
+            sprintf(componentPath, "net.host[%d]", i);
+            StringMap attributes;
+            IOutputVector *output = manager.createVector(componentPath, "delay", attributes);
+            for (int j = 0; j < numSamples; j++)
+                output->record(j * 0.001, j);
+            manager.flush();
+        }
+        manager.close();
+    }
+    shardFileNames.clear();
+    vectors = readShardedVectors("sharded", shardFileNames);
+    CHECK(shardFileNames.size() == (size_t)numVectors);
+    CHECK(vectors.size() == (size_t)numVectors);
+    for (VectorData::iterator it = vectors.begin(); it != vectors.end(); ++it)
+        CHECK(it->second.size() == (size_t)numSamples);
+    removeShards("sharded", shardFileNames);
+}
+
+// maps a shared memory ring for reading, as a monitoring process would
+static SharedMemoryRingHeader *attachRing(const char *name, size_t& size)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1)
+        return NULL;
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0)
+        p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return NULL;
+    size = st.st_size;
+    return (SharedMemoryRingHeader *)p;
+}
+
+/*
+ * Samples published in a shared memory ring can be read by another
+ * mapping; old records are overwritten once the writer laps them, and the
+ * object is gone after close() while attached readers keep their view.
+ */
+static void testSharedMemoryRing()
+{
+    const char *name = "/WriterTest-ring";
+    size_t size;
+    {
+        SharedMemoryRing ring(name, 5);
+        CHECK(ring.getCapacity() == 8);
+        SharedMemoryRingHeader *header = attachRing(name, size);
+        CHECK(header != NULL);
+        if (!header)
+            return;
+        SharedMemoryRingRecord *records = (SharedMemoryRingRecord *)((char *)header + header->headerSize);
+        CHECK(memcmp(header->magic, SharedMemoryRing::MAGIC, sizeof(header->magic)) == 0);
+        CHECK(header->version == SharedMemoryRing::VERSION);
+        CHECK(header->recordSize == sizeof(SharedMemoryRingRecord));
+        CHECK(header->capacity == 8);
+        CHECK(header->writerPid == (uint32_t)getpid());
+        CHECK(header->head == 0);
+
+        double times[15], values[15];
+        for (int i = 0; i < 15; i++)
+        {
+            times[i] = i * 0.5;
+            values[i] = i * i;
+        }
+        ring.publish(3, times, values, 5);
+        CHECK(header->head == 5);
+        CHECK(records[4].seq == 5 && records[4].vectorId == 3);
+        CHECK(toDouble(records[4].time) == 2.0 && toDouble(records[4].value) == 16.0);
+        CHECK(records[5].seq == 0);
+
+        // sample k goes into record k % 8
+        ring.publish(7, times + 5, values + 5, 10);
+        CHECK(header->head == 15);
+        for (int k = 7; k < 15; k++)
+        {
+            const SharedMemoryRingRecord& record = records[k % 8];
+            CHECK(record.seq == (uint64_t)k + 1);
+            CHECK(record.vectorId == 7);
+            CHECK(toDouble(record.time) == times[k] && toDouble(record.value) == values[k]);
+        }
+
+        CHECK(!header->closed);
+        ring.close();
+        CHECK(header->closed);
+        CHECK(attachRing(name, size) == NULL);
+        munmap(header, size);
+    }
+
+    // the manager publishes every sample it writes, with the ids of the vector file
+    {
+        FileOutputVectorManager manager("ring.vec");
+        manager.setSharedMemoryRing(name, 1024);
+        manager.open("ring-run", StringMap());
+        SharedMemoryRingHeader *header = attachRing(name, size);
+        CHECK(header != NULL);
+        if (!header)
+            return;
+        SharedMemoryRingRecord *records = (SharedMemoryRingRecord *)((char *)header + header->headerSize);
+        StringMap attributes;
+        IOutputVector *first = manager.createVector("net.host[0]", "delay", attributes);
+        IOutputVector *second = manager.createVector("net.host[1]", "delay", attributes);
+        for (int i = 0; i < 300; i++)
+            (i % 3 == 0 ? first : second)->record(i * 0.001, i);
+        manager.close();
+
+        CHECK(header->closed);
+        CHECK(header->head == 300);
+        map<uint32_t, vector<Sample> > published;
+        for (int k = 0; k < 300 && k < (int)header->head; k++)
+        {
+            CHECK(records[k].seq == (uint64_t)k + 1);
+            Sample sample;
+            sample.time = toDouble(records[k].time);
+            sample.value = toDouble(records[k].value);
+            published[records[k].vectorId].push_back(sample);
+        }
+        munmap(header, size);
+
+        // name the published vectors by their declarations in the vector file
+        string contents = readFile("ring.vec");
+        VectorData publishedVectors;
+        for (map<uint32_t, vector<Sample> >::iterator it = published.begin(); it != published.end(); ++it)
+        {
+            char prefix[32];
+            sprintf(prefix, "\nvector %u ", (unsigned int)it->first);
+            size_t pos = contents.find(prefix);
+            CHECK(pos != string::npos);
+            if (pos == string::npos)
+                continue;
+            pos += strlen(prefix);
+            string declaration = contents.substr(pos, contents.find('\n', pos) - pos);
+            publishedVectors[declaration.substr(0, declaration.rfind(' '))] = it->second;
+        }
+        CHECK(publishedVectors.size() == 2);
+        CHECK(equals(publishedVectors, readTextVectors("ring.vec")));
+    }
+    removeFiles("ring");
+}
+
+int main()
+{
+    testAsyncWriter();
+    testAsyncFailure();
+    testOutputFile();
+    testNumberFormat();
+    testBinaryFormats();
+    testFlushPolicy();
+    testChunkPool();
+    testStatistics();
+    testFilters();
+    testIndexFingerprint();
+    testScalarModes();
+    testBatchRecording();
+    testVectorChurn();
+    testWriterStatistics();
+    testSparseVectors();
+    testConcurrentBudget();
+    testSharding();
+    testSharedMemoryRing();
+
+    if (failures > 0)
+        fprintf(stderr, "%d check(s) failed\n", failures);
+    else
+        printf("all tests passed\n");
+    return failures;
+}